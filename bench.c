@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include <limits.h>
+#include <time.h>
+#include "helper.c"
+
+// define the number of times each workload is run under each shell and mode, of which the median is reported
+#define BENCH_TRIALS 3
+
+// define structure for a workload of the benchmark: a script of count copies of line, which is counted as count commands
+// the line is built by the setup of the suite, since some of them are too long to write out
+typedef struct benchWorkload {
+	const char *name;
+	char *line;
+	size_t count;
+} benchWorkload;
+
+// define enumeration for how a shell is given the script: as its argument, or on its stdin from a pipe
+typedef enum benchMode {
+	BENCH_BATCH,
+	BENCH_PIPED
+} benchMode;
+
+// prototypes of all functions
+bool writeFile(const char *path, const char *text, size_t length);
+bool writeScript(const char *path, const benchWorkload *w);
+bool setupFiles();
+char* longLine(size_t numOfWords);
+char* findShell(const char *name);
+double elapsedSeconds(const struct timespec *start);
+double runShell(const char *shell, benchMode mode, const char *scriptPath, size_t *stderrLines);
+size_t countLines(const char *path);
+int compareDoubles(const void *a, const void *b);
+
+// function that writes length bytes of text to a new file at path
+// returns false if an error occurs
+bool writeFile(const char *path, const char *text, size_t length) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		perror("open");
+		return false;
+	}
+	size_t written = 0;
+	while (written < length) {
+		ssize_t n = write(fd, text + written, length - written);
+		if (n == -1) {
+			perror("write");
+			close(fd);
+			return false;
+		}
+		written += (size_t) n;
+	}
+	return close(fd) == 0;
+}
+
+// function that writes the script of a workload to path, which is its line count times
+// returns false if an error occurs
+bool writeScript(const char *path, const benchWorkload *w) {
+	char *script = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	size_t lineLength = strlen(w->line);
+	for (size_t i = 0; i < w->count; i++) {
+		if (!strAppend(&script, &length, &capacity, w->line, lineLength) || !strAppend(&script, &length, &capacity, "\n", 1)) {
+			perror("malloc");
+			script = Free(script);
+			return false;
+		}
+	}
+	bool ok = writeFile(path, script, length);
+	script = Free(script);
+	return ok;
+}
+
+// function that creates the files that the workloads use in the working directory:
+// "wide" with 2000 files, "deep" with 4 levels of 4 directories and 8 files in each directory of the last level, and "in.txt"
+// returns false if an error occurs
+bool setupFiles() {
+	char path[PATH_MAX];
+	if (mkdir("wide", 0755) == -1 || mkdir("deep", 0755) == -1) {
+		perror("mkdir");
+		return false;
+	}
+	for (int i = 0; i < 2000; i++) {
+		snprintf(path, sizeof(path), "wide/file%d.txt", i);
+		if (!writeFile(path, "", 0)) {
+			return false;
+		}
+	}
+	for (int i = 0; i < 4 * 4 * 4; i++) {
+		snprintf(path, sizeof(path), "deep/a%d", i / 16);
+		mkdir(path, 0755);
+		snprintf(path, sizeof(path), "deep/a%d/b%d", i / 16, i / 4 % 4);
+		mkdir(path, 0755);
+		snprintf(path, sizeof(path), "deep/a%d/b%d/c%d", i / 16, i / 4 % 4, i % 4);
+		if (mkdir(path, 0755) == -1) {
+			perror("mkdir");
+			return false;
+		}
+		for (int j = 0; j < 8; j++) {
+			snprintf(path, sizeof(path), "deep/a%d/b%d/c%d/file%d.txt", i / 16, i / 4 % 4, i % 4, j);
+			if (!writeFile(path, "", 0)) {
+				return false;
+			}
+		}
+	}
+	const char *text = "the quick brown fox jumps over the lazy dog\n";
+	return writeFile("in.txt", text, strlen(text));
+}
+
+// function that returns an "echo" line of numOfWords words that is redirected to /dev/null, so it measures tokenizing a long line
+// returns NULL if an error occurs
+char* longLine(size_t numOfWords) {
+	char *line = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char word[32];
+	bool ok = strAppend(&line, &length, &capacity, "echo", 4);
+	for (size_t i = 0; ok && i < numOfWords; i++) {
+		int n = snprintf(word, sizeof(word), " word%zu", i);
+		ok = strAppend(&line, &length, &capacity, word, (size_t) n);
+	}
+	ok = ok && strAppend(&line, &length, &capacity, " > /dev/null", 12);
+	if (!ok) {
+		perror("malloc");
+		line = Free(line);
+	}
+	return line;
+}
+
+// function that returns the path of a shell: name itself if it has a "/", and otherwise the first directory of $PATH that has it
+// returns NULL if the shell is not found or can not be run
+char* findShell(const char *name) {
+	if (strchr(name, '/') != NULL) {
+		return access(name, X_OK) == 0 ? realpath(name, NULL) : NULL;
+	}
+	const char *dirs = getenv("PATH");
+	char path[PATH_MAX];
+	while (dirs != NULL && *dirs != '\0') {
+		size_t length = strcspn(dirs, ":");
+		snprintf(path, sizeof(path), "%.*s/%s", (int) length, dirs, name);
+		if (access(path, X_OK) == 0) {
+			return strdup(path);
+		}
+		dirs += dirs[length] == ':' ? length + 1 : length;
+	}
+	return NULL;
+}
+
+// function that returns the seconds since start
+double elapsedSeconds(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// function that runs a script under a shell with stdout sent to /dev/null and stderr to "stderr.txt", and returns how many seconds it took
+// in BENCH_PIPED mode, a child of the benchmark copies the script into a pipe that is the stdin of the shell, like "cat script | shell"
+// the number of lines that the shell wrote to stderr is stored in stderrLines. returns -1 if the shell can not be run
+double runShell(const char *shell, benchMode mode, const char *scriptPath, size_t *stderrLines) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int pipeFd[2] = {-1, -1};
+	if (mode == BENCH_PIPED && pipe(pipeFd) == -1) {
+		perror("pipe");
+		return -1;
+	}
+
+	// the feeder copies the script into the pipe
+	pid_t feeder = -1;
+	if (mode == BENCH_PIPED) {
+		feeder = fork();
+		if (feeder == 0) {
+			close(pipeFd[0]);
+			int fd = open(scriptPath, O_RDONLY);
+			char buffer[65536];
+			ssize_t n;
+			while (fd != -1 && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+				if (write(pipeFd[1], buffer, (size_t) n) != n) {
+					break;
+				}
+			}
+			_exit(EXIT_SUCCESS);
+		}
+	}
+
+	// a close-on-exec pipe tells if the shell could not be run, since a shell that ran can exit with 127 too
+	int execPipe[2];
+	if (pipe2(execPipe, O_CLOEXEC) == -1) {
+		perror("pipe2");
+		return -1;
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(execPipe[0]);
+		int null = open("/dev/null", O_RDWR);
+		int err = open("stderr.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (null == -1 || err == -1 || dup2(null, STDOUT_FILENO) == -1 || dup2(err, STDERR_FILENO) == -1 ||
+			dup2(mode == BENCH_PIPED ? pipeFd[0] : null, STDIN_FILENO) == -1) {
+			_exit(127);
+		}
+		if (mode == BENCH_PIPED) {
+			close(pipeFd[0]);
+			close(pipeFd[1]);
+		}
+		char *args[] = {(char *) shell, mode == BENCH_BATCH ? (char *) scriptPath : NULL, NULL};
+		execv(shell, args);
+		write(execPipe[1], "x", 1);
+		_exit(127);
+	}
+	close(execPipe[1]);
+	char c;
+	bool execFailed = pid != -1 && read(execPipe[0], &c, 1) == 1;
+	close(execPipe[0]);
+	if (mode == BENCH_PIPED) {
+		close(pipeFd[0]);
+		close(pipeFd[1]);
+	}
+	int status = 0;
+	bool ok = pid != -1 && waitpid(pid, &status, 0) == pid && !execFailed;
+	if (feeder > 0) {
+		waitpid(feeder, NULL, 0);
+	}
+	double seconds = elapsedSeconds(&start);
+	*stderrLines = countLines("stderr.txt");
+	return ok ? seconds : -1;
+}
+
+// function that returns the number of lines of the file at path, or 0 if it can not be read
+size_t countLines(const char *path) {
+	int fd = open(path, O_RDONLY);
+	size_t lines = 0;
+	char buffer[65536];
+	ssize_t n;
+	while (fd != -1 && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+		for (ssize_t i = 0; i < n; i++) {
+			lines += buffer[i] == '\n';
+		}
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	return lines;
+}
+
+// function that compares 2 doubles for qsort()
+int compareDoubles(const void *a, const void *b) {
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+// usage: ./bench [file.csv] [scale]
+// runs each workload under ./myshRelease, /bin/sh and dash, in batch and piped mode, and prints the commands per second of the median of BENCH_TRIALS runs
+// ./myshRelease is mysh built with -O2 and without the sanitizer by "make myshRelease", so it is compared to the other shells as a release build
+// a workload whose every command wrote an error has no commands per second, which is printed as NA and left empty in the file
+// the results are also written to file.csv (bench.csv by default) to be compared over time
+// scale is a percentage of the number of commands of each workload (100 by default), so a quick run can use fewer
+// the workloads run in a temporary directory that is removed at the end
+int main(int argc, char **argv) {
+	setbuf(stdout, NULL);
+	const char *csvPath = argc > 1 ? argv[1] : "bench.csv";
+	long scale = argc > 2 ? strtol(argv[2], NULL, 10) : 100;
+	if (scale <= 0) {
+		fprintf(stderr, "usage: %s [file.csv] [scale]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	FILE *csv = fopen(csvPath, "w");
+	if (csv == NULL) {
+		perror("fopen");
+		exit(EXIT_FAILURE);
+	}
+	fprintf(csv, "shell,mode,workload,commands,seconds,commands_per_second,stderr_lines\n");
+
+	// find the shells before leaving the working directory, where ./myshRelease is
+	const char *shellNames[] = {"./myshRelease", "/bin/sh", "dash"};
+	size_t numOfShells = sizeof(shellNames) / sizeof(shellNames[0]);
+	char *shells[sizeof(shellNames) / sizeof(shellNames[0])];
+	for (size_t i = 0; i < numOfShells; i++) {
+		shells[i] = findShell(shellNames[i]);
+		if (shells[i] == NULL) {
+			printf("bench: %s not found, skipped\n", shellNames[i]);
+		}
+	}
+
+	char dir[] = "/tmp/myshBench.XXXXXX";
+	if (mkdtemp(dir) == NULL || chdir(dir) == -1 || !setupFiles()) {
+		perror("mkdtemp");
+		exit(EXIT_FAILURE);
+	}
+
+	// the workloads, where mysh only supports a single pipe, so its stderr shows that the N-stage pipeline is a syntax error
+	benchWorkload workloads[] = {
+		{"trivial", strdup("cd ."), 100000},
+		{"longLine", longLine(4000), 200},
+		{"wideWildcard", strdup("echo wide/*.txt > /dev/null"), 200},
+		{"deepWildcard", strdup("echo deep/*/*/*/*.txt > /dev/null"), 200},
+		{"pipe2", strdup("echo hello | cat > /dev/null"), 500},
+		{"pipeN", strdup("echo hello | cat | cat | cat | cat > /dev/null"), 500},
+		{"redirect", strdup("cat < in.txt > out.txt"), 1000},
+		{"notFound", strdup("benchNoSuchCommand"), 10000}
+	};
+	size_t numOfWorkloads = sizeof(workloads) / sizeof(workloads[0]);
+	const char *modeNames[] = {"batch", "piped"};
+
+	for (size_t w = 0; w < numOfWorkloads; w++) {
+		if (workloads[w].line == NULL) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		workloads[w].count = workloads[w].count * (size_t) scale / 100;
+		if (workloads[w].count == 0) {
+			workloads[w].count = 1;
+		}
+		if (!writeScript("script.sh", &workloads[w])) {
+			exit(EXIT_FAILURE);
+		}
+		for (size_t s = 0; s < numOfShells; s++) {
+			for (int mode = BENCH_BATCH; shells[s] != NULL && mode <= BENCH_PIPED; mode++) {
+				double trials[BENCH_TRIALS];
+				size_t stderrLines = 0;
+				for (int t = 0; t < BENCH_TRIALS; t++) {
+					trials[t] = runShell(shells[s], (benchMode) mode, "script.sh", &stderrLines);
+				}
+				qsort(trials, BENCH_TRIALS, sizeof(double), compareDoubles);
+				double seconds = trials[BENCH_TRIALS / 2];
+				if (trials[0] < 0) {
+					printf("bench: %s could not be run\n", shellNames[s]);
+					continue;
+				}
+
+				// a shell that failed every command did not run the workload, so it gets no rate
+				char rate[32] = "";
+				char printedRate[32] = "NA";
+				if (stderrLines < workloads[w].count) {
+					snprintf(rate, sizeof(rate), "%.1f", workloads[w].count / seconds);
+					snprintf(printedRate, sizeof(printedRate), "%.0f", workloads[w].count / seconds);
+				}
+				printf("bench: %-13s %-6s %-13s %7zu commands %9.3fs %12s commands/s %7zu stderr lines\n", shellNames[s], modeNames[mode],
+					workloads[w].name, workloads[w].count, seconds, printedRate, stderrLines);
+				fprintf(csv, "%s,%s,%s,%zu,%.6f,%s,%zu\n", shellNames[s], modeNames[mode], workloads[w].name, workloads[w].count, seconds, rate, stderrLines);
+			}
+		}
+		workloads[w].line = Free(workloads[w].line);
+	}
+
+	// remove the temporary directory and the copies of the paths of the shells
+	char command[64];
+	snprintf(command, sizeof(command), "rm -rf %s", dir);
+	if (chdir("/") == -1 || system(command) != 0) {
+		fprintf(stderr, "bench: could not remove %s\n", dir);
+	}
+	for (size_t i = 0; i < numOfShells; i++) {
+		shells[i] = Free(shells[i]);
+	}
+	if (fclose(csv) != 0) {
+		perror("fclose");
+		exit(EXIT_FAILURE);
+	}
+	printf("bench: results written to %s\n", csvPath);
+	return 0;
+}
@@ -11,6 +11,10 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <glob.h>
+#ifdef MYSH_ALLOC_STATS
+#include <stdint.h>
+#include <malloc.h>
+#endif
 
 // prototypes of all functions
 void* Free(void *ptr);
@@ -21,8 +25,151 @@ void printStrTokens(char **tokens, size_t numOfTokens, const char *delimiter);
 char* strCombineTokens(char **tokens, size_t numOfTokens, const char *delimiter);
 char* strReplace(const char *str, const char *oldSubStr, const char *newSubStr, ssize_t numOfOccurrences);
 void* freeArrayOfStrings(char **array, size_t numOfStrings);
+#if !defined(_POSIX_C_SOURCE) || _POSIX_C_SOURCE < 200809L
 char* strdup(const char *str);
+#endif
 char** strDupArrayOfStrings(char **array, size_t numOfStrings);
+void sortArrayOfStrings(char **array, size_t numOfStrings);
+void radixSortStrings(char **array, size_t numOfStrings, size_t depth, char **temp, unsigned char *cache);
+void sortStringsFromDepth(char **array, size_t numOfStrings, size_t depth);
+size_t strHash(const char *str, size_t length);
+bool strAppend(char **buffer, size_t *length, size_t *capacity, const char *str, size_t strLength);
+bool strAppendJson(char **buffer, size_t *length, size_t *capacity, const char *str);
+
+// define the phases of a command that allocations are counted in when the allocation accounting is compiled in
+// the phase is set per thread by allocPhaseSet(), and allocations outside of a command are counted as ALLOC_OTHER
+typedef enum allocPhase {
+	ALLOC_OTHER,
+	ALLOC_TOKENIZE,
+	ALLOC_TILDE,
+	ALLOC_EXPAND,
+	ALLOC_WILDCARD,
+	ALLOC_RESOLVE,
+	ALLOC_ARGS,
+	ALLOC_EXEC,
+	NUM_OF_ALLOC_PHASES
+} allocPhase;
+
+// when MYSH_ALLOC_STATS is defined, every malloc(), calloc(), realloc(), strdup(), strndup() and free() after this point goes through a wrapper
+// that counts the calls and the bytes asked for in each phase, and the live bytes held and their peak from malloc_usable_size()
+// so memory that a library allocated, like getcwd(NULL, 0), can still be freed here
+// otherwise the macros below do nothing, and the calls are the ones of the C library
+#ifdef MYSH_ALLOC_STATS
+typedef struct allocCounters {
+	uint64_t calls[NUM_OF_ALLOC_PHASES];
+	uint64_t bytes[NUM_OF_ALLOC_PHASES];
+	uint64_t frees;
+	int64_t live;
+	int64_t peak;
+} allocCounters;
+
+allocCounters allocStats;
+__thread allocPhase allocCurrentPhase = ALLOC_OTHER;
+const char *allocPhaseNames[NUM_OF_ALLOC_PHASES] = {"other", "tokenize", "tilde", "expand", "wildcard", "resolve", "args", "exec"};
+
+void allocCount(size_t bytes, void *ptr, size_t oldUsable);
+void* allocMalloc(size_t size);
+void* allocCalloc(size_t count, size_t size);
+void* allocRealloc(void *ptr, size_t size);
+char* allocStrdup(const char *str);
+char* allocStrndup(const char *str, size_t n);
+void allocFree(void *ptr);
+void allocReport(int fd);
+
+// function that counts an allocation of bytes in the phase of the thread, which returned ptr in place of memory of oldUsable bytes
+void allocCount(size_t bytes, void *ptr, size_t oldUsable) {
+	__atomic_fetch_add(&allocStats.calls[allocCurrentPhase], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&allocStats.bytes[allocCurrentPhase], bytes, __ATOMIC_RELAXED);
+	int64_t delta = (int64_t) malloc_usable_size(ptr) - (int64_t) oldUsable;
+	int64_t live = __atomic_add_fetch(&allocStats.live, delta, __ATOMIC_RELAXED);
+	int64_t peak = __atomic_load_n(&allocStats.peak, __ATOMIC_RELAXED);
+	while (live > peak && !__atomic_compare_exchange_n(&allocStats.peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+// function that allocates like malloc() and counts it
+void* allocMalloc(size_t size) {
+	void *ptr = malloc(size);
+	if (ptr != NULL) {
+		allocCount(size, ptr, 0);
+	}
+	return ptr;
+}
+
+// function that allocates like calloc() and counts it
+void* allocCalloc(size_t count, size_t size) {
+	void *ptr = calloc(count, size);
+	if (ptr != NULL) {
+		allocCount(count * size, ptr, 0);
+	}
+	return ptr;
+}
+
+// function that reallocates like realloc() and counts it, so the live bytes change by the difference
+void* allocRealloc(void *ptr, size_t size) {
+	size_t oldUsable = malloc_usable_size(ptr);
+	void *newPtr = realloc(ptr, size);
+	if (newPtr != NULL) {
+		allocCount(size, newPtr, oldUsable);
+	}
+	return newPtr;
+}
+
+// function that duplicates a string like strdup() and counts it
+char* allocStrdup(const char *str) {
+	size_t length = strlen(str);
+	char *newStr = allocMalloc(length + 1);
+	if (newStr != NULL) {
+		memcpy(newStr, str, length + 1);
+	}
+	return newStr;
+}
+
+// function that duplicates at most n characters of a string like strndup() and counts it
+char* allocStrndup(const char *str, size_t n) {
+	size_t length = strnlen(str, n);
+	char *newStr = allocMalloc(length + 1);
+	if (newStr != NULL) {
+		memcpy(newStr, str, length);
+		newStr[length] = '\0';
+	}
+	return newStr;
+}
+
+// function that frees like free() and counts it
+void allocFree(void *ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	__atomic_fetch_add(&allocStats.frees, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&allocStats.live, (int64_t) malloc_usable_size(ptr), __ATOMIC_RELAXED);
+	free(ptr);
+}
+
+// function that writes the allocations of each phase, the frees, and the live and peak bytes to fd, one "alloc:" line each
+void allocReport(int fd) {
+	char line[128];
+	for (size_t i = 0; i < NUM_OF_ALLOC_PHASES; i++) {
+		int n = snprintf(line, sizeof(line), "alloc: %s calls %llu bytes %llu\n", allocPhaseNames[i],
+			(unsigned long long) __atomic_load_n(&allocStats.calls[i], __ATOMIC_RELAXED), (unsigned long long) __atomic_load_n(&allocStats.bytes[i], __ATOMIC_RELAXED));
+		write(fd, line, (size_t) n);
+	}
+	int n = snprintf(line, sizeof(line), "alloc: frees %llu live %lld peak %lld\n", (unsigned long long) __atomic_load_n(&allocStats.frees, __ATOMIC_RELAXED),
+		(long long) __atomic_load_n(&allocStats.live, __ATOMIC_RELAXED), (long long) __atomic_load_n(&allocStats.peak, __ATOMIC_RELAXED));
+	write(fd, line, (size_t) n);
+}
+
+#define malloc(size) allocMalloc(size)
+#define calloc(count, size) allocCalloc(count, size)
+#define realloc(ptr, size) allocRealloc(ptr, size)
+#define strdup(str) allocStrdup(str)
+#define strndup(str, n) allocStrndup(str, n)
+#define free(ptr) allocFree(ptr)
+#define allocPhaseSet(phase) (allocCurrentPhase = (phase))
+#else
+#define allocPhaseSet(phase) ((void) 0)
+#define allocReport(fd) ((void) 0)
+#endif
 
 // define free function that changes the pointer to NULL after freeing
 void* Free(void *ptr) {
@@ -416,6 +563,8 @@ void* freeArrayOfStrings(char **array, size_t numOfStrings) {
 }
 
 // function that duplicates a string
+// when the including file requests the POSIX 2008 interfaces, string.h already provides strdup(), and the allocation accounting replaces it
+#if (!defined(_POSIX_C_SOURCE) || _POSIX_C_SOURCE < 200809L) && !defined(MYSH_ALLOC_STATS)
 char* strdup(const char *str) {
 	// if str is NULL, then return NULL
 	if (str == NULL) {
@@ -436,6 +585,7 @@ char* strdup(const char *str) {
 	// return newStr
 	return newStr;
 }
+#endif
 
 // function that duplicates an array of strings
 char** strDupArrayOfStrings(char **array, size_t numOfStrings) {
@@ -460,3 +610,230 @@ char** strDupArrayOfStrings(char **array, size_t numOfStrings) {
 	// return newArray
 	return newArray;
 }
+
+// function that sorts an array of strings in place, in the same order as strcmp()
+// large groups are split with an MSD radix sort that caches the current character of every string in a byte array,
+// so each string is dereferenced once per level, and small groups are sorted with multikey quicksort
+// the characters of a prefix shared by many strings (like a directory path) are only looked at once per string
+void sortArrayOfStrings(char **array, size_t numOfStrings) {
+	// if array is NULL or there is nothing to sort, then return
+	if (array == NULL || numOfStrings < 2) {
+		return;
+	}
+
+	// allocate the scratch space of the radix sort
+	// if the allocation fails, then sort with multikey quicksort only
+	char **temp = malloc(sizeof(char *) * numOfStrings);
+	unsigned char *cache = malloc(sizeof(unsigned char) * numOfStrings);
+	if (temp == NULL || cache == NULL) {
+		temp = Free(temp);
+		cache = Free(cache);
+		sortStringsFromDepth(array, numOfStrings, 0);
+		return;
+	}
+
+	// sort the strings starting at the first character
+	radixSortStrings(array, numOfStrings, 0, temp, cache);
+
+	// free the scratch space
+	temp = Free(temp);
+	cache = Free(cache);
+}
+
+// function that sorts strings sharing the same first depth characters by distributing them into 256 buckets
+// the largest bucket is sorted by the loop instead of a recursive call, so the recursion depth stays logarithmic
+void radixSortStrings(char **array, size_t numOfStrings, size_t depth, char **temp, unsigned char *cache) {
+	while (true) {
+		// groups that are too small to amortize the 256 buckets are sorted with multikey quicksort
+		if (numOfStrings < 64) {
+			sortStringsFromDepth(array, numOfStrings, depth);
+			return;
+		}
+
+		// cache the character at depth of every string and count the size of each bucket
+		size_t counts[256] = {0};
+		for (size_t i = 0; i < numOfStrings; i++) {
+			cache[i] = (unsigned char) array[i][depth];
+			counts[cache[i]]++;
+		}
+
+		// if every string has the same character at depth, then there is nothing to move
+		// bucket 0 holds identical strings that already ended, so they are sorted
+		// otherwise skip the whole prefix shared by every string in one pass instead of one character at a time
+		if (counts[cache[0]] == numOfStrings) {
+			if (cache[0] == '\0') {
+				return;
+			}
+			size_t prefixEnd = strlen(array[0]);
+			for (size_t i = 1; i < numOfStrings && prefixEnd > depth + 1; i++) {
+				size_t k = depth + 1;
+				while (k < prefixEnd && array[i][k] == array[0][k]) {
+					k++;
+				}
+				prefixEnd = k;
+			}
+			depth = prefixEnd > depth + 1 ? prefixEnd : depth + 1;
+			continue;
+		}
+
+		// calculate where each bucket starts and move the strings into their buckets
+		size_t starts[256];
+		size_t start = 0;
+		for (size_t i = 0; i < 256; i++) {
+			starts[i] = start;
+			start += counts[i];
+		}
+		for (size_t i = 0; i < numOfStrings; i++) {
+			temp[starts[cache[i]]++] = array[i];
+		}
+		memcpy(array, temp, sizeof(char *) * numOfStrings);
+
+		// find the largest bucket other than bucket 0
+		size_t largest = 1;
+		for (size_t i = 2; i < 256; i++) {
+			if (counts[i] > counts[largest]) {
+				largest = i;
+			}
+		}
+
+		// sort every other bucket by the next character
+		start = counts[0];
+		size_t largestStart = 0;
+		for (size_t i = 1; i < 256; i++) {
+			if (i == largest) {
+				largestStart = start;
+			} else if (counts[i] > 1) {
+				radixSortStrings(array + start, counts[i], depth + 1, temp, cache);
+			}
+			start += counts[i];
+		}
+
+		// then continue with the largest bucket
+		array += largestStart;
+		numOfStrings = counts[largest];
+		depth++;
+	}
+}
+
+// function that sorts an array of strings that all share the same first depth characters
+void sortStringsFromDepth(char **array, size_t numOfStrings, size_t depth) {
+	while (numOfStrings > 1) {
+		// small partitions are faster to sort with insertion sort
+		if (numOfStrings < 16) {
+			for (size_t i = 1; i < numOfStrings; i++) {
+				char *str = array[i];
+				size_t j = i;
+				while (j > 0 && strcmp(array[j - 1] + depth, str + depth) > 0) {
+					array[j] = array[j - 1];
+					j--;
+				}
+				array[j] = str;
+			}
+			return;
+		}
+
+		// use the median of the first, middle and last character at depth as the pivot
+		unsigned char first = (unsigned char) array[0][depth];
+		unsigned char middle = (unsigned char) array[numOfStrings / 2][depth];
+		unsigned char last = (unsigned char) array[numOfStrings - 1][depth];
+		unsigned char pivot = middle;
+		if ((first <= middle && middle <= last) || (last <= middle && middle <= first)) {
+			pivot = middle;
+		} else if ((middle <= first && first <= last) || (last <= first && first <= middle)) {
+			pivot = first;
+		} else {
+			pivot = last;
+		}
+
+		// partition the strings into 3 groups by their character at depth
+		// [0, lt) is smaller than the pivot, [lt, gt) is equal to the pivot and [gt, numOfStrings) is greater
+		size_t lt = 0;
+		size_t i = 0;
+		size_t gt = numOfStrings;
+		while (i < gt) {
+			unsigned char c = (unsigned char) array[i][depth];
+			if (c < pivot) {
+				char *temp = array[lt];
+				array[lt] = array[i];
+				array[i] = temp;
+				lt++;
+				i++;
+			} else if (c > pivot) {
+				gt--;
+				char *temp = array[gt];
+				array[gt] = array[i];
+				array[i] = temp;
+			} else {
+				i++;
+			}
+		}
+
+		// sort the smaller and greater groups at the same depth
+		sortStringsFromDepth(array, lt, depth);
+		sortStringsFromDepth(array + gt, numOfStrings - gt, depth);
+
+		// if the pivot is the null terminator, then the equal group is made of identical strings
+		if (pivot == '\0') {
+			return;
+		}
+
+		// otherwise sort the equal group by the next character
+		array += lt;
+		numOfStrings = gt - lt;
+		depth++;
+	}
+}
+
+// function that returns the 64-bit FNV-1a hash of the first length characters of str
+size_t strHash(const char *str, size_t length) {
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 1099511628211ULL;
+	}
+	return (size_t) hash;
+}
+
+// function that appends strLength characters of str to a dynamic buffer that is always NUL terminated
+// the buffer grows by doubling its capacity, and may be NULL with a capacity of 0 at first
+// returns false if the buffer could not grow, in which case it is unchanged
+bool strAppend(char **buffer, size_t *length, size_t *capacity, const char *str, size_t strLength) {
+	if (*length + strLength + 1 > *capacity) {
+		size_t newCapacity = *capacity == 0 ? 64 : *capacity;
+		while (*length + strLength + 1 > newCapacity) {
+			newCapacity *= 2;
+		}
+		char *newBuffer = realloc(*buffer, newCapacity);
+		if (newBuffer == NULL) {
+			return false;
+		}
+		*buffer = newBuffer;
+		*capacity = newCapacity;
+	}
+	memcpy(*buffer + *length, str, strLength);
+	*length += strLength;
+	(*buffer)[*length] = '\0';
+	return true;
+}
+
+// function that appends str to a dynamic buffer like strAppend() as a JSON string, in quotes and with '"', '\\' and control characters escaped
+// returns false if the buffer could not grow, in which case it may hold part of the string
+bool strAppendJson(char **buffer, size_t *length, size_t *capacity, const char *str) {
+	if (strAppend(buffer, length, capacity, "\"", 1) == false) {
+		return false;
+	}
+	size_t start = 0;
+	for (size_t i = 0; str[i] != '\0'; i++) {
+		unsigned char c = (unsigned char) str[i];
+		if (c != '"' && c != '\\' && c >= 0x20) {
+			continue;
+		}
+		char escape[8];
+		snprintf(escape, sizeof(escape), c == '"' || c == '\\' ? "\\%c" : "\\u%04x", c);
+		if (!strAppend(buffer, length, capacity, str + start, i - start) || !strAppend(buffer, length, capacity, escape, strlen(escape))) {
+			return false;
+		}
+		start = i + 1;
+	}
+	return strAppend(buffer, length, capacity, str + start, strlen(str + start)) && strAppend(buffer, length, capacity, "\"", 1);
+}
@@ -0,0 +1,282 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include <stdint.h>
+#include <time.h>
+#include "helper.c"
+
+// this file is built twice by "make microbench": microbench times the calls without the wrappers of helper.c,
+// and microbenchAlloc is built with MYSH_ALLOC_STATS and only counts the allocations of the calls, without timing them
+
+// define the number of trials of each case, and the bytes that the calls of a trial go through at least, so that small inputs are timed over many calls
+#define MICROBENCH_TRIALS 5
+#define MICROBENCH_TRIAL_BYTES (16 * 1024 * 1024)
+
+// define the number of calls whose allocations are counted, since every call of a case allocates the same
+#define MICROBENCH_COUNTED_CALLS 4
+
+// define enumeration for the primitives of helper.c that are measured
+typedef enum microbenchPrimitive {
+	BENCH_TOKENIZE,
+	BENCH_STRIP,
+	BENCH_COMBINE,
+	BENCH_REPLACE,
+	BENCH_DUP_ARRAY
+} microbenchPrimitive;
+
+// define structure for a case of the microbenchmark: a primitive over a generated line of size bytes
+// wordLength is the length of the words between single spaces, and operatorPercent the share of the words that are a "|", ">" or "<"
+// replacements is the numOfOccurrences given to strReplace(), where the line has a "$X" every wordLength + 1 bytes, and -1 replaces all of them
+typedef struct microbenchCase {
+	microbenchPrimitive primitive;
+	size_t size;
+	size_t wordLength;
+	int operatorPercent;
+	ssize_t replacements;
+} microbenchCase;
+
+// define the names of the primitives
+const char *primitiveNames[] = {"strTokenize", "strStrip", "strCombineTokens", "strReplace", "strDupArrayOfStrings"};
+
+// define global variable that every call adds its result to, which is printed at the end, so the compiler can not remove the calls
+volatile size_t sink = 0;
+
+// prototypes of all functions
+char* makeLine(const microbenchCase *c);
+long long nowNanos();
+int compareLongLongs(const void *a, const void *b);
+size_t runOnce(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens);
+void runCase(const microbenchCase *c, size_t maxSize);
+void timeCase(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens, const char *description);
+void countCase(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens, const char *description);
+void formatSize(size_t size, char *buffer, size_t bufferSize);
+
+// function that returns a new line of c->size bytes of words of c->wordLength letters separated by single spaces
+// operatorPercent of the words are an operator instead, and for strReplace() each word starts with "$X"
+// for strStrip(), the line starts and ends with a run of spaces of a tenth of its size
+// returns NULL if an error occurs
+char* makeLine(const microbenchCase *c) {
+	char *line = malloc(c->size + 1);
+	if (line == NULL) {
+		return NULL;
+	}
+	const char operators[] = "|><";
+	size_t padding = c->primitive == BENCH_STRIP ? c->size / 10 : 0;
+	unsigned int seed = 1;
+	size_t i = 0;
+	while (i < c->size) {
+		if (i < padding || i >= c->size - padding) {
+			line[i++] = ' ';
+			continue;
+		}
+		seed = seed * 1103515245 + 12345;
+		if ((int) (seed >> 16) % 100 < c->operatorPercent) {
+			line[i++] = operators[(seed >> 8) % 3];
+		} else {
+			for (size_t j = 0; j < c->wordLength && i < c->size; j++) {
+				line[i] = c->primitive == BENCH_REPLACE && j < 2 ? "$X"[j] : (char) ('a' + i % 26);
+				i++;
+			}
+		}
+		if (i < c->size) {
+			line[i++] = ' ';
+		}
+	}
+	line[c->size] = '\0';
+	return line;
+}
+
+// function that returns the time of the monotonic clock in nanoseconds
+long long nowNanos() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// function that compares 2 long longs for qsort()
+int compareLongLongs(const void *a, const void *b) {
+	long long x = *(const long long *) a;
+	long long y = *(const long long *) b;
+	return x < y ? -1 : x > y;
+}
+
+// function that calls the primitive of c once on line, or on tokens for strCombineTokens() and strDupArrayOfStrings(), and frees its result
+// returns a number from the result, like its length, that the caller adds to sink
+size_t runOnce(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens) {
+	size_t result = 0;
+	switch (c->primitive) {
+		case BENCH_TOKENIZE: {
+			size_t n = 0;
+			char **t = strTokenize(line, " ", &n, "|><");
+			result = n;
+			t = freeStrTokens(t, n);
+			break;
+		}
+		case BENCH_STRIP: {
+			char *s = strStrip(line, " ");
+			result = s == NULL ? 0 : (size_t) (unsigned char) s[0];
+			s = Free(s);
+			break;
+		}
+		case BENCH_COMBINE: {
+			char *s = strCombineTokens(tokens, numOfTokens, " ");
+			result = s == NULL ? 0 : (size_t) (unsigned char) s[0];
+			s = Free(s);
+			break;
+		}
+		case BENCH_REPLACE: {
+			char *s = strReplace(line, "$X", "value", c->replacements);
+			result = s == NULL ? 0 : (size_t) (unsigned char) s[0];
+			s = Free(s);
+			break;
+		}
+		case BENCH_DUP_ARRAY: {
+			char **a = strDupArrayOfStrings(tokens, numOfTokens);
+			result = a == NULL ? 0 : (size_t) (unsigned char) a[0][0];
+			a = freeArrayOfStrings(a, numOfTokens);
+			break;
+		}
+	}
+	return result;
+}
+
+// function that writes a size like "10B", "100KB" or "100MB" to buffer
+void formatSize(size_t size, char *buffer, size_t bufferSize) {
+	if (size >= 1000000 && size % 1000000 == 0) {
+		snprintf(buffer, bufferSize, "%zuMB", size / 1000000);
+	} else if (size >= 1000 && size % 1000 == 0) {
+		snprintf(buffer, bufferSize, "%zuKB", size / 1000);
+	} else {
+		snprintf(buffer, bufferSize, "%zuB", size);
+	}
+}
+
+// function that runs a case, which times it or counts its allocations depending on how the file was built
+// a case that is larger than maxSize is skipped
+void runCase(const microbenchCase *c, size_t maxSize) {
+	if (c->size > maxSize) {
+		return;
+	}
+	char *line = makeLine(c);
+	size_t numOfTokens = 0;
+	char **tokens = line == NULL ? NULL : strTokenize(line, " ", &numOfTokens, "|><");
+	if (line == NULL || ((c->primitive == BENCH_COMBINE || c->primitive == BENCH_DUP_ARRAY) && tokens == NULL)) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	// the first call warms up the caches and the allocator, and is neither timed nor counted
+	sink += runOnce(c, line, tokens, numOfTokens);
+
+	char size[32];
+	char replacements[32] = "";
+	char description[128];
+	formatSize(c->size, size, sizeof(size));
+	if (c->primitive == BENCH_REPLACE) {
+		snprintf(replacements, sizeof(replacements), " replace %zd", c->replacements);
+	}
+	snprintf(description, sizeof(description), "%-20s %6s words %2zu ops %2d%%%s", primitiveNames[c->primitive], size, c->wordLength, c->operatorPercent, replacements);
+#ifdef MYSH_ALLOC_STATS
+	countCase(c, line, tokens, numOfTokens, description);
+#else
+	timeCase(c, line, tokens, numOfTokens, description);
+#endif
+
+	tokens = freeStrTokens(tokens, numOfTokens);
+	line = Free(line);
+}
+
+// function that runs MICROBENCH_TRIALS trials of a case and prints the min, median and max ns/byte
+// each trial makes enough calls to go through MICROBENCH_TRIAL_BYTES, and at least 1
+void timeCase(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens, const char *description) {
+	size_t calls = MICROBENCH_TRIAL_BYTES / c->size;
+	if (calls == 0) {
+		calls = 1;
+	}
+	long long trials[MICROBENCH_TRIALS];
+	for (int t = 0; t < MICROBENCH_TRIALS; t++) {
+		long long start = nowNanos();
+		for (size_t i = 0; i < calls; i++) {
+			sink += runOnce(c, line, tokens, numOfTokens);
+		}
+		trials[t] = nowNanos() - start;
+	}
+	qsort(trials, MICROBENCH_TRIALS, sizeof(long long), compareLongLongs);
+	double bytes = (double) c->size * calls;
+	printf("microbench: %s: ns/byte min %.3f median %.3f max %.3f\n", description, trials[0] / bytes, trials[MICROBENCH_TRIALS / 2] / bytes,
+		trials[MICROBENCH_TRIALS - 1] / bytes);
+}
+
+// function that makes MICROBENCH_COUNTED_CALLS calls of a case, which are not timed, and prints the allocations and bytes allocated per call
+void countCase(const microbenchCase *c, const char *line, char **tokens, size_t numOfTokens, const char *description) {
+#ifdef MYSH_ALLOC_STATS
+	uint64_t allocCalls = 0;
+	uint64_t allocBytes = 0;
+	for (size_t p = 0; p < NUM_OF_ALLOC_PHASES; p++) {
+		allocCalls -= allocStats.calls[p];
+		allocBytes -= allocStats.bytes[p];
+	}
+	for (size_t i = 0; i < MICROBENCH_COUNTED_CALLS; i++) {
+		sink += runOnce(c, line, tokens, numOfTokens);
+	}
+	for (size_t p = 0; p < NUM_OF_ALLOC_PHASES; p++) {
+		allocCalls += allocStats.calls[p];
+		allocBytes += allocStats.bytes[p];
+	}
+	printf("microbench: %s: allocs/call %.1f, bytes/call %.0f\n", description, (double) allocCalls / MICROBENCH_COUNTED_CALLS,
+		(double) allocBytes / MICROBENCH_COUNTED_CALLS);
+#endif
+}
+
+// usage: ./microbench [max bytes] or ./microbenchAlloc [max bytes]
+// measures strTokenize(), strStrip(), strCombineTokens(), strReplace() and strDupArrayOfStrings() of helper.c, first over lines from 10B to 100MB,
+// which shows a primitive whose time per byte grows with the line, and then over token densities, operator densities and replacement counts
+// the cases of lines larger than max bytes (100MB by default) are skipped, since the largest need a few GB for their tokens
+int main(int argc, char **argv) {
+	setbuf(stdout, NULL);
+	size_t maxSize = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 100000000;
+	if (maxSize == 0) {
+		fprintf(stderr, "usage: %s [max bytes]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	// the sizes, with words of 8 letters and 10% operators like a typical command line
+	const size_t sizes[] = {10, 1000, 100000, 10000000, 100000000};
+	for (int p = BENCH_TOKENIZE; p <= BENCH_DUP_ARRAY; p++) {
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			microbenchCase c = {(microbenchPrimitive) p, sizes[i], 8, 10, -1};
+			runCase(&c, maxSize);
+		}
+	}
+
+	// the densities over lines of 100KB: words of 1 to 64 letters, 0 to 50% operators, and replacing 1, 100 or all of the "$X"
+	const size_t wordLengths[] = {1, 8, 64};
+	const int operatorPercents[] = {0, 10, 50};
+	for (size_t w = 0; w < sizeof(wordLengths) / sizeof(wordLengths[0]); w++) {
+		for (size_t o = 0; o < sizeof(operatorPercents) / sizeof(operatorPercents[0]); o++) {
+			microbenchCase c = {BENCH_TOKENIZE, 100000, wordLengths[w], operatorPercents[o], -1};
+			runCase(&c, maxSize);
+		}
+	}
+	const ssize_t replacements[] = {1, 100, -1};
+	for (size_t w = 0; w < sizeof(wordLengths) / sizeof(wordLengths[0]); w++) {
+		for (size_t r = 0; r < sizeof(replacements) / sizeof(replacements[0]); r++) {
+			microbenchCase c = {BENCH_REPLACE, 100000, wordLengths[w] + 2, 0, replacements[r]};
+			runCase(&c, maxSize);
+		}
+	}
+	printf("microbench: done (%zu)\n", (size_t) sink);
+	return 0;
+}
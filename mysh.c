@@ -1,3 +1,6 @@
+// request the POSIX 2008 and BSD interfaces (such as d_type in struct dirent) and the GNU ones (such as pipe2() and F_GETPIPE_SZ) from the system headers
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -11,8 +14,682 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <glob.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <execinfo.h>
+#include <time.h>
+#include <math.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#ifdef __has_include
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define MYSH_PROBES 1
+#endif
+#endif
 #include "helper.c"
 
+// define structure for a directory that the wildcard walker still has to read
+// dirPath is the directory prefix with a trailing "/" (or "" for the working directory)
+// segmentIndex is the index of the pattern segment that is matched against the entries of dirPath
+typedef struct walkTask {
+	char *dirPath;
+	size_t segmentIndex;
+} walkTask;
+
+// define structure for the work-stealing deque owned by each walker thread
+// the owner pushes and pops tasks at the tail, idle threads steal tasks from the head
+typedef struct walkDeque {
+	pthread_mutex_t lock;
+	walkTask *tasks;
+	size_t head;
+	size_t tail;
+	size_t capacity;
+} walkDeque;
+
+// define structure for the open-addressing hash table of the tasks a walker has pushed, probed linearly like variableTable
+// a pattern with two "**" segments reaches the same directory at the same segment along several paths,
+// for example "**/b/**/c" reaches "b/b/" at "c" with the first or the second "**" matching "b/", so every task is only pushed once
+typedef struct walkVisited {
+	walkTask *slots;
+	size_t count;
+	size_t capacity;
+} walkVisited;
+
+// define structure for the matches found by a single walker thread
+typedef struct walkResults {
+	char **paths;
+	size_t numOfPaths;
+	size_t capacity;
+} walkResults;
+
+// define structure for a single {...} group of a brace expression
+// a list group holds its alternatives ("{a,b,c}"), each already expanded if it has braces of its own
+// a range group generates count numbers or letters from first by step ("{1..10..2}" or "{a..e}"),
+// and numbers are padded with zeros to width if an end of the range was written with a leading zero
+typedef struct braceGroup {
+	char **alternatives;
+	size_t numOfAlternatives;
+	bool letters;
+	long first;
+	long step;
+	int width;
+	size_t count;
+} braceGroup;
+
+// define structure for a token with brace groups, which generates its words one at a time without touching the filesystem
+// literals[i] comes before groups[i], and literals[numOfGroups] comes after the last group
+// the last group varies fastest, so "{a,b}{1,2}" generates a1 a2 b1 b2
+typedef struct braceGenerator {
+	char **literals;
+	braceGroup *groups;
+	size_t numOfGroups;
+	size_t count;
+	size_t next;
+} braceGenerator;
+
+// define structure for a shell variable, whose name is an interned string and whose value is its own copy, freed when it is replaced
+// a variable that was exported before it was assigned has a NULL value and is not passed to programs
+typedef struct variable {
+	const char *name;
+	char *value;
+	size_t hash;
+	bool exported;
+} variable;
+
+// define structure for the open-addressing hash table of shell variables, probed linearly
+// capacity is a power of 2, and the table grows before it is half full so that probe sequences stay short
+typedef struct variableTable {
+	variable *slots;
+	size_t capacity;
+	size_t count;
+} variableTable;
+
+// define structure for the table of interned strings, which holds a single copy of every distinct name
+// interned strings live until the shell exits, so only the names of variables and functions are interned, which a script has few of
+typedef struct internTable {
+	char **slots;
+	size_t capacity;
+	size_t count;
+} internTable;
+
+// define structure for a command of a function body or an alias, which is parsed once when it is defined
+// tokens has "~/" replaced and the program names that could be found replaced with their paths
+// names holds the program name of every token that was replaced with its path and NULL for the others, so the path can be checked before each run
+// the flags tell which steps of parseCommand() still have to run every time the command runs
+typedef struct storedCommand {
+	char **tokens;
+	char **names;
+	size_t numOfTokens;
+	bool assignments;
+	bool substitute;
+	bool expand;
+	bool resolve;
+} storedCommand;
+
+// define structure for a function or an alias, whose source is NULL once it is removed
+typedef struct definition {
+	const char *name;
+	size_t hash;
+	char *source;
+	storedCommand *commands;
+	size_t numOfCommands;
+} definition;
+
+// define structure for the stored commands of a function that was redefined or removed while a call was running them
+// they are kept in a list until the outermost call returns, since a call walks the commands of its body
+typedef struct retiredCommands {
+	storedCommand *commands;
+	size_t numOfCommands;
+	struct retiredCommands *next;
+} retiredCommands;
+
+// define the kinds of blocks that span several lines
+typedef enum blockType {
+	FUNCTION_BLOCK = 1,
+	LOOP_BLOCK
+} blockType;
+
+// define structure for a block that has been started but not closed yet, like "name() {" or "for f in *.c; do"
+// name is the name of the function or the loop variable, words are the words of a loop and body collects the lines
+// needsDo is true for a loop whose header line did not end with "do", so the next line has to start with it
+// startLine is the script line of the header, which the profile charges the block to
+typedef struct pendingBlock {
+	blockType type;
+	char *name;
+	char *words;
+	char *body;
+	size_t length;
+	size_t capacity;
+	bool needsDo;
+	size_t startLine;
+} pendingBlock;
+
+// define structure for the open-addressing hash table of functions or aliases, probed linearly like variableTable
+typedef struct definitionTable {
+	definition *slots;
+	size_t capacity;
+	size_t count;
+} definitionTable;
+
+// define the kinds of instructions that a compiled pattern segment is made of
+// a literal matches a run of bytes, any matches one byte ("?"), a class matches one byte in a set ("[a-z]"),
+// and a star matches zero or more bytes ("*")
+typedef enum matchOpType {
+	MATCH_LITERAL,
+	MATCH_ANY,
+	MATCH_CLASS,
+	MATCH_STAR
+} matchOpType;
+
+// define structure for a single instruction of a compiled pattern segment
+// a literal refers to length bytes at offset start of the literal buffer of its matcher
+// a class holds a bitmap with a bit for each of the 256 byte values
+typedef struct matchOp {
+	matchOpType type;
+	size_t start;
+	size_t length;
+	uint64_t set[4];
+} matchOp;
+
+// define structure for a pattern segment that is compiled once and then matched against every directory entry
+// a literal prefix and a literal suffix (after the last star) are checked with memcmp() before the other instructions run,
+// and the instructions in [firstOp, lastOp) are matched against the bytes between them
+// a name must have at least minLength bytes, and exactly minLength bytes if the segment has no star
+typedef struct segmentMatcher {
+	matchOp *ops;
+	size_t numOfOps;
+	char *literals;
+	size_t firstOp;
+	size_t lastOp;
+	size_t prefixLength;
+	size_t suffixLength;
+	size_t minLength;
+	bool hasStar;
+	bool explicitPeriod;
+} segmentMatcher;
+
+// define structure for a directory entry whose type is unknown after readdir(), so it has to be looked up with statx
+// path is the full path of the entry and path + nameOffset its name inside the directory
+// if follow is true, then symbolic links are resolved (the entry is a candidate file of the last segment),
+// otherwise the entry is a candidate directory of a "**" segment
+typedef struct statCandidate {
+	char *path;
+	size_t nameOffset;
+	bool follow;
+	bool found;
+	mode_t mode;
+} statCandidate;
+
+// define the number of submission queue entries of the io_uring that each walker thread uses for statx
+#define STAT_RING_ENTRIES 64
+
+// define structure for the io_uring of a walker thread, created the first time the thread needs more than one statx
+// the pointers refer to the shared ring buffers that io_uring_setup() returns and that are mapped with mmap()
+typedef struct statRing {
+	int fd;
+	bool unavailable;
+	void *sqRing;
+	size_t sqRingSize;
+	void *cqRing;
+	size_t cqRingSize;
+	struct io_uring_sqe *sqes;
+	size_t sqesSize;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	struct io_uring_cqe *cqes;
+} statRing;
+
+// define the size of the output buffer of a walker that streams its matches to a file descriptor
+#define STREAM_BUFFER_SIZE 4096
+
+// define structure that holds the shared state of one wildcard expansion
+// queuedTasks counts tasks waiting in the deques, pendingTasks counts tasks that are queued or running
+// failed is set by any walker thread, so it is only read and written with atomic builtins
+// a streaming walker writes its matches to streamFd, each followed by delimiter, instead of collecting them
+// visited is only used for a pattern with more than one "**" segment, whose tasks could repeat, and is guarded by lock
+typedef struct walker {
+	char **segments;
+	segmentMatcher *matchers;
+	size_t numOfSegments;
+	size_t numOfWorkers;
+	walkDeque *deques;
+	walkResults *results;
+	statRing *rings;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t queuedTasks;
+	size_t pendingTasks;
+	bool trackVisited;
+	walkVisited visited;
+	bool failed;
+	int streamFd;
+	char delimiter;
+	pthread_mutex_t streamLock;
+	char streamBuffer[STREAM_BUFFER_SIZE];
+	size_t streamLength;
+	size_t numOfStreamed;
+} walker;
+
+// define structure for the feeder of "<*", a thread of the shell that walks a pattern and writes the matches into a pipe
+// the feeders of the commands in progress form a stack, so a command only waits for the feeders that it started
+typedef struct streamFeeder {
+	walker w;
+	pthread_t thread;
+	long long start;
+	struct streamFeeder *next;
+} streamFeeder;
+
+// define structure that is passed to every walker thread
+typedef struct walkWorker {
+	walker *w;
+	size_t index;
+} walkWorker;
+
+// define the maximum number of threads used to expand a single wildcard
+#define MAX_WALK_THREADS 8
+
+// define the number of directories that are searched for programs, in the order of searchDirs
+#define NUM_SEARCH_DIRS 6
+
+// define the kinds of records in a compiled script
+typedef enum compiledRecordType {
+	COMPILED_TOKENS = 1,
+	COMPILED_LINE
+} compiledRecordType;
+
+// define structure for the header at the start of a compiled script (.myshc)
+// the stamps of the script and of the search directories tell whether the compiled script is still valid
+// the header is followed by the records at recordsOffset, and the table of program names and paths at programsOffset
+// a record is its type and the offset in the script just past its line, followed by either the number of tokens and the tokens, or the text of the line
+// and a string is its length as a uint32_t, its bytes and a NUL byte
+typedef struct compiledHeader {
+	char magic[8];
+	uint64_t scriptSize;
+	uint64_t scriptMtimeSec;
+	uint64_t scriptMtimeNsec;
+	uint64_t dirMtimeSec[NUM_SEARCH_DIRS];
+	uint64_t dirMtimeNsec[NUM_SEARCH_DIRS];
+	uint64_t numOfRecords;
+	uint64_t numOfPrograms;
+	uint64_t recordsOffset;
+	uint64_t programsOffset;
+} compiledHeader;
+
+// define structure for a program name and its path in the table of a compiled script, both pointing into the mapped file
+typedef struct compiledProgram {
+	const char *name;
+	const char *path;
+} compiledProgram;
+
+// define structure for the open-addressing hash table of the programs of the compiled script that is running
+typedef struct compiledProgramTable {
+	compiledProgram *slots;
+	size_t capacity;
+} compiledProgramTable;
+
+// define the number of lines that the front-end thread prepares ahead of the shell in batch mode, and the size of its reads
+#define FRONT_END_LINES 64
+#define FRONT_END_CHUNK 65536
+
+// define structure for a line of the script that the front-end thread has prepared before the shell runs it
+// tokens is NULL if the line is empty or starts a function or a loop (header is true), which blockLine() reads from line
+// programs[i] is a program name of the line that was found in the search directories, and paths[i] its path
+// end is the offset in the script just after the line. line is NULL at the end of the script, and error is set if read failed
+typedef struct preparedLine {
+	char *line;
+	bool header;
+	char **tokens;
+	size_t numOfTokens;
+	char **programs;
+	char **paths;
+	size_t numOfPrograms;
+	off_t end;
+	int error;
+	long long parseNanos;
+} preparedLine;
+
+// define structure for the bounded queue of prepared lines between the front-end thread and the shell
+// the shell discards the queue by changing generation, and the front end then starts over at offset
+// the front end reads the script in chunks into chunk, where the bytes in [chunkStart, chunkLength) have not been used yet
+// and readOffset is the offset in the script just after the chunk
+// watchFd is an inotify descriptor watching the search directories, or -1 if the front end does not look for programs
+// current is the line that the shell is running, whose program paths findProgramPath() looks up
+// without a thread (threaded is false), the shell prepares each line itself just before it runs it
+typedef struct frontEnd {
+	pthread_t thread;
+	bool running;
+	bool threaded;
+	char *chunk;
+	size_t chunkStart;
+	size_t chunkLength;
+	off_t readOffset;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t space;
+	preparedLine lines[FRONT_END_LINES];
+	size_t head;
+	size_t count;
+	off_t offset;
+	size_t generation;
+	bool stop;
+	int watchFd;
+	preparedLine current;
+} frontEnd;
+
+// define structure for a program that a timed command started, with the resource usage that wait4() returned for it
+// realNanos is the time from just before fork() until the program was reaped, and execNanos the time until execve()
+// closed the close-on-exec pipe of the child
+typedef struct timedStage {
+	pid_t pid;
+	char *program;
+	struct timespec started;
+	long long realNanos;
+	long long execNanos;
+	struct rusage usage;
+} timedStage;
+
+// define structure for the command that the time builtin is measuring
+// the time of the shell is split into its steps: parse (tokenizing), expand (aliases, "~/", assignments, braces and variables),
+// glob (wildcards) and resolve (syntax, functions and program paths). lap is when the last step ended
+// the programs are only added to stages if recordStages is true, which the time builtin sets but bench does not,
+// since the pipe that measures fork() to execve() makes the stages of a pipeline start one after another
+typedef struct commandTiming {
+	bool active;
+	bool recordStages;
+	struct timespec lap;
+	long long parseNanos;
+	long long expandNanos;
+	long long globNanos;
+	long long resolveNanos;
+	timedStage *stages;
+	size_t numOfStages;
+	size_t capacity;
+} commandTiming;
+
+// define the number of spans that each thread keeps when the shell is traced, and the number of bytes kept of a command line and a program
+#define TRACE_RING_EVENTS 16384
+#define TRACE_DETAIL_SIZE 112
+#define TRACE_PROGRAM_SIZE 48
+
+// define structure for a span of a traced shell, which becomes a complete event ("ph":"X") of the trace-event JSON
+// start and duration are nanoseconds since the trace started. track is the thread that recorded the span, or the pid of a child for its lifetime,
+// whose name is NULL because it is named after its program
+// pid, stage, stdInFd, stdOutFd and status are -1 if the span is not about a program, and the descriptors are -1 when the program inherits them
+// command holds the start of the line that the thread was working on, and program the start of a program path
+typedef struct traceEvent {
+	const char *category;
+	const char *name;
+	long long start;
+	long long duration;
+	pid_t track;
+	pid_t pid;
+	int stage;
+	int stdInFd;
+	int stdOutFd;
+	int status;
+	char command[TRACE_DETAIL_SIZE];
+	char program[TRACE_PROGRAM_SIZE];
+} traceEvent;
+
+// define structure for the ring buffer that a thread records its spans into without taking a lock
+// once it is full, the oldest spans are overwritten and counted in dropped. lap is when the last step of traceLap() ended
+typedef struct traceBuffer {
+	traceEvent *events;
+	size_t next;
+	size_t count;
+	size_t dropped;
+	pid_t tid;
+	const char *threadName;
+	long long lap;
+	char command[TRACE_DETAIL_SIZE];
+	struct traceBuffer *nextBuffer;
+} traceBuffer;
+
+// define structure for a program that a traced shell has forked and not reaped yet, whose lifetime becomes a span on a track of its own
+typedef struct traceChild {
+	pid_t pid;
+	long long start;
+	int stage;
+	int stdInFd;
+	int stdOutFd;
+	char command[TRACE_DETAIL_SIZE];
+	char program[TRACE_PROGRAM_SIZE];
+} traceChild;
+
+// define structure for the trace that "--trace=file.json" records and writes to fd when the shell exits
+// every thread gets its own buffer through key the first time it records a span, and lock only guards the list of buffers
+typedef struct traceState {
+	bool enabled;
+	int fd;
+	pid_t shellPid;
+	struct timespec origin;
+	pthread_key_t key;
+	pthread_mutex_t lock;
+	traceBuffer *buffers;
+	traceChild *children;
+	size_t numOfChildren;
+	size_t capacity;
+} traceState;
+
+// define the counters that the shell keeps while it runs, which the stats builtin prints in this order
+// a prepared path is a program path that a compiled script or the front end had found already, and a searched one was looked up in the search directories
+// a matched glob is a pattern that matched a file, and an unmatched one matched nothing
+// an environment hit is a command that used the cached envp without rebuilding it
+typedef enum statsCounter {
+	STATS_COMMANDS,
+	STATS_FORKS,
+	STATS_PATHS_PREPARED,
+	STATS_PATHS_SEARCHED,
+	STATS_GLOBS_MATCHED,
+	STATS_GLOBS_UNMATCHED,
+	STATS_ENV_HITS,
+	STATS_ENV_MISSES,
+	STATS_STAT,
+	STATS_OPEN,
+	STATS_READ,
+	NUM_STATS_COUNTERS
+} statsCounter;
+
+// define the number of buckets of a latency histogram in nanoseconds: the values below 8 have a bucket each,
+// and every power of 2 above is split into 8 buckets, so that a bucket is at most 12.5% wide like those of an HDR histogram
+#define STATS_SUB_BUCKETS 8
+#define STATS_BUCKETS 496
+
+// define structure for a histogram of latencies in nanoseconds, with their exact count, sum and maximum
+typedef struct statsHistogram {
+	uint64_t buckets[STATS_BUCKETS];
+	uint64_t count;
+	long long sum;
+	long long max;
+} statsHistogram;
+
+// define structure for the counters and histograms of the shell
+// the counters are added to atomically, since the walker and front-end threads count their system calls too
+// the histograms are only recorded by the shell while MYSH_STATS is set, for the last program of each command, which the shell waits for right after it starts
+typedef struct shellStats {
+	uint64_t counters[NUM_STATS_COUNTERS];
+	statsHistogram forkToExec;
+	statsHistogram execToExit;
+} shellStats;
+
+// define the steps of a command that the profile of "--profile" splits the time of a script line into
+// spawn is the time of the shell to resolve, fork and run the built-in commands, and wait is the time it waits for its programs
+typedef enum profilePhase {
+	PROFILE_PARSE,
+	PROFILE_EXPAND,
+	PROFILE_SPAWN,
+	PROFILE_WAIT,
+	NUM_PROFILE_PHASES
+} profilePhase;
+
+// define structure for the profile of a script line: how many commands it ran, the time of each step,
+// the CPU time of the programs that it waited for, and the start of the line for the report
+typedef struct profileLine {
+	uint64_t runs;
+	long long nanos[NUM_PROFILE_PHASES];
+	long long childCpuMicros;
+	char *text;
+} profileLine;
+
+// define structure for the time of a script line that was spent inside functions or sourced scripts, which are named by frames like "f;g"
+typedef struct profileStack {
+	size_t line;
+	char *frames;
+	size_t hash;
+	long long nanos[NUM_PROFILE_PHASES];
+} profileStack;
+
+// define the number of frames that a profile stack can have, which is enough for MAX_FUNCTION_DEPTH calls inside MAX_SOURCE_DEPTH sourced scripts
+#define MAX_PROFILE_DEPTH 320
+
+// define structure for the profile of "--profile", which charges the time since lap to the step of the line that is running
+// offset is where the line numbered offsetLine starts in the script, so that the next line is numbered by counting the newlines up to it
+// frames are the functions and sourced scripts that the shell is in, and depths are where each of them starts in frames
+typedef struct profileState {
+	bool enabled;
+	int stacksFd;
+	const char *script;
+	struct timespec start;
+	struct timespec lap;
+	size_t line;
+	off_t offset;
+	size_t offsetLine;
+	profileLine *lines;
+	size_t numOfLines;
+	char *frames;
+	size_t framesLength;
+	size_t framesCapacity;
+	size_t depths[MAX_PROFILE_DEPTH];
+	size_t depth;
+	profileStack *stacks;
+	size_t numOfStacks;
+	size_t stacksCapacity;
+} profileState;
+
+// define the number of bytes that the log of "--report" collects before it writes them
+#define REPORT_BUFFER_SIZE 65536
+
+// define structure for a program that a logged command started, whose status is -1 until it is reaped
+typedef struct reportStage {
+	pid_t pid;
+	char *program;
+	int status;
+} reportStage;
+
+// define structure for a command that is being logged, which lives on the stack of the function that runs the command
+// outputs are the files that its stdout was redirected to, whose sizes are the bytes it wrote once it is done
+// the resource usage is that of the programs that were reaped while it ran, including the programs of the commands inside it
+typedef struct reportRecord {
+	char *command;
+	size_t depth;
+	struct timespec start;
+	reportStage *stages;
+	size_t numOfStages;
+	size_t capacity;
+	char **outputs;
+	size_t numOfOutputs;
+	long long bytesIn;
+	long long userMicros;
+	long long sysMicros;
+	long maxrss;
+	struct reportRecord *parent;
+} reportRecord;
+
+// define structure for the log of "--report", which appends a line of JSON to buffer for every command that ends
+// only the shell logs commands, so the buffer has one writer and needs no lock. current is the innermost command that is running
+typedef struct reportState {
+	bool enabled;
+	int fd;
+	bool ownsFd;
+	char *buffer;
+	size_t length;
+	size_t capacity;
+	reportRecord *current;
+} reportState;
+
+// define the number of characters of a program path that the monitor keeps, and the size of the /proc files that it reads
+#define MONITOR_PROGRAM_SIZE 64
+#define MONITOR_FILE_SIZE 4096
+
+// define structure for a program that the shell has forked and not reaped yet while a command is monitored
+// ticks and sampled are the CPU time of the program and when it was last sampled, which its CPU% is measured from
+typedef struct monitorChild {
+	pid_t pid;
+	int stage;
+	char program[MONITOR_PROGRAM_SIZE];
+	long long ticks;
+	struct timespec sampled;
+} monitorChild;
+
+// define structure for the monitor of "monitor", whose thread samples the programs of the command every interval seconds until stop is set
+// lock guards the list of programs, which the shell adds to when it forks and removes from when it reaps
+typedef struct monitorState {
+	bool active;
+	double interval;
+	struct timespec start;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	bool stop;
+	monitorChild *children;
+	size_t numOfChildren;
+	size_t capacity;
+} monitorState;
+
+// define the static tracepoints (USDT probes) of the "mysh" provider, which bpftrace or perf can attach to without a special build
+// each probe is a nop in the code and a note in the binary, and its semaphore is only set while a tracer is attached,
+// so a probe that needs a duration only reads the clock when PROBE_ENABLED() is true
+// without sys/sdt.h, the probes are not compiled and PROBE_ENABLED() is false, and their arguments are only named and never evaluated
+#ifdef MYSH_PROBES
+#define PROBE_SEMAPHORE(name) unsigned short mysh_##name##_semaphore __attribute__((unused, section(".probes")))
+#define PROBE_ENABLED(name) __builtin_expect(mysh_##name##_semaphore != 0, 0)
+#define PROBE2(name, a, b) DTRACE_PROBE2(mysh, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(mysh, name, a, b, c)
+#else
+#define PROBE_SEMAPHORE(name) extern unsigned short mysh_##name##_semaphore
+#define PROBE_ENABLED(name) false
+#define PROBE2(name, a, b) ((void) sizeof(a), (void) sizeof(b))
+#define PROBE3(name, a, b, c) ((void) sizeof(a), (void) sizeof(b), (void) sizeof(c))
+#endif
+
+// define the number of stack samples that "--self-profile" keeps, the number of frames of each, and the CPU time between samples
+// and the largest distance between 2 frames that the frame pointer walk follows, so a register that is not a frame pointer ends the walk
+#define SELF_PROFILE_SAMPLES 16384
+#define SELF_PROFILE_DEPTH 64
+#define SELF_PROFILE_MICROS 1000
+#define SELF_PROFILE_MAX_FRAME (1024 * 1024)
+
+// define structure for a stack sample of the shell, taken by the SIGPROF handler on whichever thread was running
+// depth is stored last, so a sample with a depth of 0 was not finished
+typedef struct selfProfileSample {
+	int depth;
+	void *frames[SELF_PROFILE_DEPTH];
+} selfProfileSample;
+
+// define structure for the sampling profiler of the shell itself, which writes the samples to fd as collapsed stacks when the shell exits
+// numOfSamples counts every sample the handler took, including the ones that did not fit
+typedef struct selfProfileState {
+	bool enabled;
+	int fd;
+	selfProfileSample *samples;
+	size_t numOfSamples;
+} selfProfileState;
+
 // prototypes of all functions
 void setHomeDir();
 void checkArgs();
@@ -26,8 +703,18 @@ void pwdCommand(char **tokens, size_t numOfTokens);
 void cdCommand(char **tokens, size_t numOfTokens);
 void executeCommand(char **tokens, size_t numOfTokens);
 char* findProgramPath(const char *program);
-void executeProgram(const char *programPath, char **args, const int *stdInFd, const int *stdOutFd, bool isFinal, int *pipeFd, bool *pipeSet);
+char* searchProgramPath(const char *program);
+pid_t executeProgram(const char *programPath, char **args, char **envp, const int *stdInFd, const int *stdOutFd, bool isFinal, int *pipeFd, bool *pipeSet);
 ssize_t replaceWithHomeDir(char **tokens, size_t numOfTokens);
+char** braceExpand(char **tokens, size_t *numOfTokens);
+bool braceParse(const char *token, braceGenerator *g);
+bool braceGroupParse(braceGroup *group, const char *body, size_t bodyLength, bool isList);
+bool braceRangeParse(braceGroup *group, const char *body);
+char* braceWord(const braceGenerator *g, size_t index);
+char* braceNext(braceGenerator *g);
+braceGenerator* braceFree(braceGenerator *g);
+char** braceMaterialize(char **args, size_t *numOfArgs, size_t index, braceGenerator *g);
+bool isBuiltIn(const char *program);
 char** getFilenames(const char *filePath, size_t *numOfFilenames);
 char** wildcardFilenames(char **tokens, size_t *numOfTokens);
 bool isRegularFile(const char *path);
@@ -40,6 +727,188 @@ ssize_t checkCommandSyntax(char **tokens, size_t numOfTokens);
 ssize_t checkProgramSyntax(char **tokens, size_t numOfTokens);
 char** getProgramArgs(char **tokens, size_t numOfTokens, size_t *numOfArgs);
 char** getFilenamesExt(const char *filePath, size_t *pnumOfFilenames);
+char** wildcardWalk(const char *pattern, size_t *numOfPaths, bool sorted);
+void* streamFeederThread(void *arg);
+void joinStreamFeeders(streamFeeder *until);
+bool walkerInit(walker *w, const char *pattern, int streamFd, char delimiter);
+void walkerRun(walker *w);
+void walkerFree(walker *w);
+char** splitPatternSegments(const char *pattern, size_t *numOfSegments);
+bool isWildcardSegment(const char *segment);
+size_t walkThreadCount();
+bool walkPush(walker *w, size_t index, char *dirPath, size_t segmentIndex);
+bool walkVisit(walker *w, const char *dirPath, size_t segmentIndex, bool *isNew);
+bool walkPop(walker *w, size_t index, walkTask *task);
+void walkDirectory(walker *w, size_t index, char *dirPath, size_t segmentIndex);
+void* walkThread(void *arg);
+bool walkAddResult(walker *w, size_t index, char *path);
+char* walkJoin(const char *dirPath, const char *name, bool addSlash);
+void walkFlush(walker *w);
+ssize_t writeAll(int fd, const char *buffer, size_t length);
+size_t argumentListSize(char **args, size_t numOfArgs, char **envp);
+size_t argumentListLimit();
+bool isSplitSafeProgram(const char *programPath);
+bool isSplitQuietProgram(const char *programPath);
+void argumentListTooLong(const char *program);
+size_t countProgramArgs(char **tokens, size_t numOfTokens);
+void chunkedProgram(const char *programPath, char **args, char **envp, size_t numOfArgs, size_t numOfFixedArgs, size_t numOfTrailingArgs, braceGenerator *generator, const int *stdInFd, const int *stdOutFd);
+void markStreamRedirections(char *command);
+bool isStdInRedirection(const char *token);
+bool isRedirection(const char *token);
+bool isOperator(const char *token);
+int openStdInRedirection(const char *operator, const char *path);
+int openStreamRedirection(const char *pattern, char delimiter);
+bool compileSegment(segmentMatcher *m, const char *segment);
+size_t compileClass(const char *segment, uint64_t *set);
+void freeSegmentMatcher(segmentMatcher *m);
+bool segmentMatch(const segmentMatcher *m, const char *name, size_t length);
+bool matchOps(const segmentMatcher *m, const char *name, size_t length);
+void walkStatCandidates(walker *w, size_t index, int dirFd, statCandidate *candidates, size_t numOfCandidates);
+bool statRingInit(statRing *ring);
+bool statRingSupports(int fd, unsigned op);
+void statRingFree(statRing *ring);
+size_t statRingRun(statRing *ring, int dirFd, statCandidate *candidates, size_t numOfCandidates);
+void statSync(int dirFd, statCandidate *candidate);
+void importEnvironment();
+const char* intern(const char *str, size_t length);
+variable* findVariable(const char *name, size_t length, size_t hash);
+bool growVariables();
+bool setVariable(const char *name, size_t nameLength, const char *value, bool exported);
+const char* getVariable(const char *name);
+char** programEnvironment(bool withAssignments);
+void releaseEnvironment(char **envp);
+bool isAssignment(const char *token);
+ssize_t takeAssignments(char **tokens, size_t *numOfTokens);
+char* expandVariableReferences(const char *token);
+ssize_t expandVariables(char **tokens, size_t numOfTokens);
+void exportCommand(char **tokens, size_t numOfTokens);
+int openBuiltInStdOut(char **tokens, size_t numOfTokens);
+void clearCommandState();
+void freeVariables();
+void initWorkingDirectory();
+bool setWorkingDirectory(const char *logicalPath);
+const char* workingDirectory();
+char* joinLogicalPath(const char *base, const char *path);
+ssize_t changeDirectory(const char *path);
+void pushdCommand(char **tokens, size_t numOfTokens);
+void popdCommand(char **tokens, size_t numOfTokens);
+void dirsCommand(char **tokens, size_t numOfTokens);
+ssize_t printDirectoryStack(int fd);
+void freeWorkingDirectory();
+char** tokenizeCommand(char *command, size_t *numOfTokens);
+size_t functionHeaderLength(const char *command, size_t *nameStart, size_t *nameLength);
+size_t loopHeaderLength(const char *command, size_t *nameStart, size_t *nameLength, size_t *wordsStart, size_t *wordsLength, bool *needsDo);
+ssize_t blockEnd(const char *line, const char *terminator);
+bool blockLine(char *command);
+void clearBlock();
+bool storeCommands(const char *body, storedCommand **commands, size_t *numOfCommands);
+void runLoop(const char *name, const char *words, const char *body);
+bool storeCommand(storedCommand *c, const char *text);
+bool defineFunction(const char *name, const char *body);
+definition* definitionSlot(definitionTable *table, const char *name, size_t hash);
+definition* findDefinition(definitionTable *table, const char *name);
+bool setDefinition(definitionTable *table, const char *name, const char *source, storedCommand *commands, size_t numOfCommands);
+void freeStoredCommands(storedCommand *commands, size_t numOfCommands);
+bool retireStoredCommands(storedCommand *commands, size_t numOfCommands);
+void freeRetiredCommands();
+char** instantiateCommand(const storedCommand *c, size_t *numOfTokens);
+void runStoredCommand(storedCommand *c);
+void refreshStoredCommand(storedCommand *c);
+void functionCall(const definition *f, char **tokens, size_t numOfTokens);
+char** expandAliases(char **tokens, size_t *numOfTokens);
+void aliasCommand(char **tokens, size_t numOfTokens);
+void runTokens(char **tokens, size_t numOfTokens);
+char* readScript(const char *scriptPath, size_t *length);
+char* compiledScriptPath(const char *scriptPath);
+bool compiledStamps(const char *scriptPath, compiledHeader *header);
+bool compiledAppendString(char **buffer, size_t *length, size_t *capacity, const char *str, size_t strLength);
+const char* compiledReadString(const char *data, size_t size, size_t *offset, uint32_t *strLength);
+bool compileScript(const char *scriptPath);
+const char* mapCompiledScript(const char *scriptPath, size_t *size);
+bool runCompiledScript(const char *scriptPath, bool followInput);
+size_t compiledSkipRecord(const char *data, size_t size, size_t offset, uint32_t type);
+const char* compiledProgramPath(const char *program);
+void sourceCommand(char **tokens, size_t numOfTokens);
+bool frontEndStart(off_t offset);
+void* frontEndThread(void *arg);
+void frontEndSeek(off_t offset);
+void frontEndRead(preparedLine *p);
+void prepareLine(preparedLine *p, char *line);
+void frontEndNext(preparedLine *p);
+void frontEndRestart(off_t offset);
+void frontEndStop();
+void freePreparedLine(preparedLine *p);
+bool searchDirsChanged();
+const char* preparedProgramPath(const char *program);
+void pipelinedInputLoop();
+bool isProgramName(char **tokens, size_t index, size_t first);
+long long elapsedNanos(const struct timespec *since);
+void timingLap(long long *nanos);
+void timeCommand(char **tokens, size_t numOfTokens, bool expand);
+void timingStarted(pid_t pid, const char *programPath, const struct timespec *started, long long execNanos);
+pid_t waitChild(pid_t pid, int *status);
+void timingReport(const struct timespec *start, const struct rusage *shellBefore);
+void freeTiming();
+void benchCommand(char **tokens, size_t numOfTokens);
+int compareNanos(const void *a, const void *b);
+void takeOptions(int *argc, char **argv);
+void traceOpen(const char *path);
+long long traceNow();
+traceBuffer* traceLocalBuffer();
+void traceThreadName(const char *name);
+traceEvent* traceRecord(const char *category, const char *name, long long start);
+void traceSpan(const char *category, const char *name, long long start);
+void traceProgramSpan(const char *category, const char *name, long long start, pid_t pid, int stage, int stdInFd, int stdOutFd, const char *program);
+void traceLap(const char *category, const char *name);
+void traceCommand(const char *line);
+void traceCommandTokens(char **tokens, size_t numOfTokens);
+void traceChildStarted(pid_t pid, long long start, int stage, int stdInFd, int stdOutFd, const char *program);
+void traceChildReaped(pid_t pid, int status);
+void traceWrite();
+bool traceAppendEvent(char **buffer, size_t *length, size_t *capacity, const traceEvent *e);
+void statsAdd(statsCounter counter, uint64_t n);
+size_t statsBucket(long long nanos);
+long long statsBucketStart(size_t index);
+void statsRecord(statsHistogram *h, long long nanos);
+long long statsPercentile(const statsHistogram *h, double fraction);
+bool statsAppendHistogram(char **buffer, size_t *length, size_t *capacity, const char *name, const statsHistogram *h, bool withBuckets);
+char* statsReport(bool withBuckets, size_t *length);
+void statsCommand(char **tokens, size_t numOfTokens);
+void statsDump();
+void profileOpen(const char *stacksPath);
+void profileStartLine(off_t start);
+void profileLineText(const char *text);
+void profileLap(profilePhase phase);
+void profileCommand();
+void profileChildCpu(const struct rusage *usage);
+void profilePush(const char *frame);
+void profilePop();
+profileStack* profileFindStack(size_t line, const char *frames, size_t length, size_t hash);
+int compareProfileLines(const void *a, const void *b);
+void profileWrite();
+void reportOpen(const char *target);
+void reportBegin(reportRecord *record, const char *line, char **tokens, size_t numOfTokens);
+void reportChildStarted(pid_t pid, const char *program);
+void reportChildReaped(pid_t pid, int status, const struct rusage *usage);
+void reportRedirect(const char *path, bool isInput);
+void reportEnd(reportRecord *record);
+void reportFlush();
+void reportClose();
+void runRestOfCommand(char **tokens, size_t numOfTokens, size_t first, bool expand);
+void monitorCommand(char **tokens, size_t numOfTokens, bool expand);
+void monitorChildStarted(pid_t pid, int stage, const char *program);
+void monitorChildReaped(pid_t pid);
+void* monitorThread(void *arg);
+ssize_t readProcFile(pid_t pid, const char *name, char *buffer);
+const char* procField(const char *text, const char *name);
+bool monitorAppendChild(char **buffer, size_t *length, size_t *capacity, monitorChild *child, const struct timespec *now);
+void selfProfileOpen(const char *path);
+void selfProfileSignal(int signal, siginfo_t *info, void *context);
+bool selfProfileRegisters(const void *context, uintptr_t *pc, uintptr_t *fp);
+bool selfProfileRead(uintptr_t address, uintptr_t words[2]);
+char* selfProfileFrameName(char *symbol);
+void selfProfileWrite();
+void freeDefinitions();
 
 // define enumeration for the mode of the shell
 typedef enum mode {
@@ -56,10 +925,180 @@ ssize_t exit_status = 0;
 // define global variable for the home directory
 char *homeDir = NULL;
 
+// define the directories that are searched for programs, in order
+const char *searchDirs[NUM_SEARCH_DIRS] = {
+	"/usr/local/sbin/",
+	"/usr/local/bin/",
+	"/usr/sbin/",
+	"/usr/bin/",
+	"/sbin/",
+	"/bin/"
+};
+
+// define the magic number at the start of a compiled script, which changes with the format, and the extension of its file
+#define COMPILED_MAGIC "MYSHC\x02\x00\x00"
+#define COMPILED_EXTENSION ".myshc"
+
+// define global variable for the programs of the compiled script that is running, which findProgramPath() looks up first
+compiledProgramTable compiledPrograms = {NULL, 0};
+
+// define global variable for the number of scripts being sourced, which is limited so that a script that sources itself stops
+size_t sourceDepth = 0;
+#define MAX_SOURCE_DEPTH 64
+
+// define global variables for the logical working directory, which keeps the symbolic links that cd went through
+// cwdFd is an open descriptor of the working directory, and cwdDev and cwdIno identify it
+// so a rename or removal of the directory or of a directory above it is noticed with stat() instead of calling getcwd()
+char *logicalCwd = NULL;
+int cwdFd = -1;
+dev_t cwdDev = 0;
+ino_t cwdIno = 0;
+
+// define global variables for the directory stack of pushd and popd, with the top of the stack at the end
+char **dirStack = NULL;
+size_t dirStackSize = 0;
+
+// define global variables for the range of tokens produced by wildcard expansion in the last command
+// tokens in [expandedTokensStart, expandedTokensEnd) can be split across several runs of a program
+size_t expandedTokensStart = 0;
+size_t expandedTokensEnd = 0;
+
+// define the list of programs that give the same result when their arguments are split across several runs
+// ls sorts and lays out all of its arguments together, and grep only names the files when it is given more than one, so neither is in the list
+const char *splitSafePrograms[] = {
+	"cat", "chgrp", "chmod", "chown", "file", "md5sum", "rm",
+	"rmdir", "sha1sum", "sha256sum", "stat", "touch", NULL
+};
+
+// define the list of split safe programs that print nothing when they succeed, which are the only ones whose runs execute at the same time
+// the output of cat, file, stat and the checksums follows the order of their arguments, which concurrent runs would interleave
+const char *splitQuietPrograms[] = {
+	"chgrp", "chmod", "chown", "rm", "rmdir", "touch", NULL
+};
+
+// define the largest number of runs of a split program that execute at the same time
+#define MAX_SPLIT_JOBS 1024
+
+// define the number of bytes kept free below ARG_MAX, as recommended by POSIX for xargs
+#define ARG_MAX_HEADROOM 2048
+
+// define the operators that stream the matches of a wildcard pattern into stdin, one per line or NUL terminated
+// the tokenizer only splits single characters, so the operators are replaced with marks before tokenizing
+#define STREAM_REDIRECT "<*"
+#define STREAM_REDIRECT_NUL "<*0"
+#define STREAM_MARK "\x1c"
+#define STREAM_MARK_NUL "\x1d"
+
+// define the number of words above which a brace expression is generated while the program runs instead of all at once
+// and the number of words that a brace expression may never exceed when it has to be generated all at once
+#define BRACE_LAZY_WORDS 4096
+#define BRACE_MAX_WORDS 1000000
+
+// define the token that stands in for a brace expression that is generated while the program runs
+#define LAZY_BRACE_MARK "\x1e"
+
+// define global variable for the brace expression of the last command that is generated while the program runs
+braceGenerator *lazyBrace = NULL;
+
+// define global variables for the shell variables and the interned strings they are made of
+variableTable variables = {NULL, 0, 0};
+internTable internedStrings = {NULL, 0, 0};
+
+// define global variables for the envp passed to execve(), which is rebuilt only when an exported variable changes, and the buffer of its strings
+char **cachedEnvp = NULL;
+char *cachedEnvpStrings = NULL;
+bool envpChanged = true;
+
+// define global variables for the assignments at the start of the last command (like LC_ALL=C in "LC_ALL=C sort")
+// they are passed to the first program of the command without changing the shell variables
+char **commandAssignments = NULL;
+size_t numOfCommandAssignments = 0;
+
+// define global variables for the functions and the aliases
+definitionTable functions = {NULL, 0, 0};
+definitionTable aliases = {NULL, 0, 0};
+
+// define global variable for a function definition or loop that spans several lines and has not been closed yet
+pendingBlock block = {FUNCTION_BLOCK, NULL, NULL, NULL, 0, 0, false, 0};
+
+// define global variables for the variable of the loop that is running and its value in this iteration
+// the value is substituted without being stored in the shell variables, so a loop over many files does not intern every name
+const char *loopVariable = NULL;
+const char *loopValue = NULL;
+
+// define global variables for the arguments of the function that is running, where positionalArgs[0] is its name
+// and for the number of function calls in progress, which is limited so that endless recursion stops with an error
+char **positionalArgs = NULL;
+size_t numOfPositionalArgs = 0;
+size_t functionDepth = 0;
+#define MAX_FUNCTION_DEPTH 256
+
+// define global variable for the feeders of "<*" that are still running, the newest first
+streamFeeder *streamFeeders = NULL;
+
+// define global variable for the stored commands that were replaced while a function was running, which are freed when no call runs
+retiredCommands *retired = NULL;
+
+// define global variable for the front-end thread that reads and prepares the lines of a script while the shell runs earlier lines
+frontEnd front;
+
+// define global variables for the command that the time builtin is measuring, and the time it took to tokenize the last line
+commandTiming timing = {false, false, {0, 0}, 0, 0, 0, 0, NULL, 0, 0};
+long long lastParseNanos = 0;
+
+// define the largest number of runs and of warmups of the bench builtin, so the wall times of the runs can always be allocated
+#define BENCH_MAX_RUNS 10000000
+
+// define global variable for the trace of the shell, which is only recorded if the shell was started with "--trace=file.json"
+traceState trace = {false, -1, 0, {0, 0}, 0, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, 0};
+
+// define global variable for the counters and histograms of the shell, and the names that the stats builtin prints for the counters
+shellStats stats;
+const char *statsCounterNames[NUM_STATS_COUNTERS] = {
+	"commands", "forks", "paths prepared", "paths searched", "globs matched", "globs unmatched",
+	"env hits", "env misses", "stat calls", "open calls", "read calls"
+};
+
+// define global variable for the profile of the script lines, which is only recorded if the shell was started with "--profile"
+profileState profile = {false, -1, "stdin", {0, 0}, {0, 0}, 0, 0, 0, NULL, 0, NULL, 0, 0, {0}, 0, NULL, 0, 0};
+const char *profilePhaseNames[NUM_PROFILE_PHASES] = {"parse", "expand", "spawn", "wait"};
+
+// define global variable for the log of the commands, which is only written if the shell was started with "--report=fd|file"
+reportState reportLog = {false, -1, false, NULL, 0, 0, NULL};
+
+// define global variable for the monitor of the programs of a command, which only samples them while "monitor" runs the command
+monitorState monitor = {false, 1.0, {0, 0}, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, NULL, 0, 0};
+
+// define the semaphores of the probes, one for each probe
+// parse(command, tokens, nanos): a line was tokenized, by the shell or ahead of time by the front-end thread
+// wildcard(tokens before, tokens after, nanos): the wildcards of a command were expanded
+// resolve(program, path, nanos): the path of a program was found, or path is NULL. nanos is 0 if it was known ahead of time
+// fork(pid, path, stage) and exec(path, args): a program was forked, and its child is about to call execve()
+// wait(pid, status, nanos): a child was reaped after the shell waited nanos for it
+// builtin(name, exit status, nanos): a built-in command ran
+PROBE_SEMAPHORE(parse);
+PROBE_SEMAPHORE(wildcard);
+PROBE_SEMAPHORE(resolve);
+PROBE_SEMAPHORE(fork);
+PROBE_SEMAPHORE(exec);
+PROBE_SEMAPHORE(wait);
+PROBE_SEMAPHORE(builtin);
+
+// define global variable for the sampling profiler of the shell, which only samples if the shell was started with "--self-profile[=file]"
+selfProfileState selfProfile = {false, -1, NULL, 0};
+
 // this program accepts either 0 or 1 arguments
 // if no arguments are given, then the program will run in interactive mode
 // if 1 argument is given (file name for stdin), then the program will run in batch mode
 int main(int argc, char **argv) {
+	// take the options like "--trace=file.json" out of the arguments
+	takeOptions(&argc, argv);
+
+	// "mysh --compile script.sh" writes the compiled form of the script and exits
+	if (argc == 3 && strcmp(argv[1], "--compile") == 0) {
+		exit(compileScript(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// set shellMode to argc
 	shellMode = argc;
 
@@ -69,15 +1108,37 @@ int main(int argc, char **argv) {
 	// check the arguments of this program
 	checkArgs();
 
-	// set stdin to either the default or the input file
+	// set stdin to either the default or the input file, which the profile names its lines after
 	setStdIn(argv);
+	if (shellMode == BATCH) {
+		profile.script = argv[1];
+	}
 	
 	// if INTERACTIVE, greet the user
 	greet();
 
+	// copy the environment into the shell variables
+	importEnvironment();
+
 	// set homeDir to the home directory
 	setHomeDir();
+
+	// remember the working directory that the shell starts in
+	initWorkingDirectory();
+
+	// if BATCH and the script has been compiled, then run the compiled form and exit
+	// stdin follows the lines like in the input loops, and if a program read part of a line, then the rest of the script runs from its text
+	// a profiled script runs from its text, since the compiled form does not keep the line numbers
+	if (shellMode == BATCH && !profile.enabled && runCompiledScript(argv[1], true)) {
+		exitCommand();
+	}
 	
+	// if BATCH, then a front-end thread prepares the next lines while the shell runs a line
+	// this only returns if the script can not be read that way, like when it is a pipe
+	if (shellMode == BATCH) {
+		pipelinedInputLoop();
+	}
+
 	// at this point, stdin is set correctly
 	// so we can use the same input loop for both interactive and batch modes
 	inputLoop();
@@ -123,8 +1184,13 @@ void inputLoop() {
 	// if the user inputs a newline, then the buffer is complete and the command can be executed
 	// if EOF is read, then call exitCommand() to exit the program
 	while (true) {
+		// the profile charges the time from here on to the line that is read next, which is numbered from where it starts in the script
+		profileStartLine(profile.enabled ? lseek(STDIN_FILENO, 0, SEEK_CUR) : -1);
+
 		// if exit_status is 0 and it is INTERACTIVE, print "mysh> " otherwise print "!mysh> "
+		// the log is written first, so that the commands before a prompt are in it when the prompt is seen
 		if (shellMode == INTERACTIVE) {
+			reportFlush();
 			if (exit_status == 0) {
 				write(STDOUT_FILENO, "mysh> ", 6);
 			} else {
@@ -138,6 +1204,7 @@ void inputLoop() {
 		char c;
 		ssize_t readStatus;
 		while ((readStatus = read(STDIN_FILENO, &c, sizeof(char))) == sizeof(char)) {
+			statsAdd(STATS_READ, 1);
 			// if buffer is too small, increase size
 			if (i == size) {
 				size += 100;
@@ -178,6 +1245,7 @@ void inputLoop() {
 		}
 
 		// now the command is complete and can be parsed
+		profileLineText(buffer);
 		parseCommand(buffer);
 	}
 }
@@ -191,9 +1259,26 @@ void parseCommand(char *command) {
 		return;
 	}
 
+	// a function definition or a loop is read until it is closed, and may continue on the next lines
+	if (blockLine(command)) {
+		return;
+	}
+
+	// the command is logged from here on if the shell was started with "--report"
+	reportRecord record;
+	reportBegin(&record, command, NULL, 0);
+
 	// tokenize the command with whitespace as the delimiter and special tokens
+	// the time it takes is remembered for the time builtin
+	struct timespec parseStart;
+	clock_gettime(CLOCK_MONOTONIC, &parseStart);
+	traceCommand(command);
+	long long traceStart = traceNow();
 	size_t numOfTokens;
-	char **tokens = strTokenize(command, " \t\n\v\f\r", &numOfTokens, "|><");
+	char **tokens = tokenizeCommand(command, &numOfTokens);
+	lastParseNanos = elapsedNanos(&parseStart);
+	traceSpan("parse", "tokenizeCommand", traceStart);
+	PROBE3(parse, command, numOfTokens, lastParseNanos);
 
 	// free the command buffer because it is no longer needed
 	command = Free(command);
@@ -201,11 +1286,61 @@ void parseCommand(char *command) {
 	// if tokens is NULL, then set exit status to 0 and return
 	if (tokens == NULL) {
 		exit_status = 0;
+		reportEnd(&record);
+		return;
+	}
+
+	// run the tokens
+	runTokens(tokens, numOfTokens);
+	allocPhaseSet(ALLOC_OTHER);
+	reportEnd(&record);
+}
+
+// function that runs a command that has been tokenized, from expanding its tokens to executing it
+// the tokens are freed
+void runTokens(char **tokens, size_t numOfTokens) {
+	// "time" measures the rest of the command, including the steps below, and "bench" runs it many times
+	if (strcasecmp(tokens[0], "time") == 0) {
+		timeCommand(tokens, numOfTokens, true);
+		tokens = freeStrTokens(tokens, numOfTokens);
+		return;
+	}
+	if (strcasecmp(tokens[0], "bench") == 0) {
+		benchCommand(tokens, numOfTokens);
+		tokens = freeStrTokens(tokens, numOfTokens);
+		return;
+	}
+	if (strcasecmp(tokens[0], "monitor") == 0) {
+		monitorCommand(tokens, numOfTokens, true);
+		tokens = freeStrTokens(tokens, numOfTokens);
+		return;
+	}
+	timingLap(NULL);
+	traceCommandTokens(tokens, numOfTokens);
+	traceLap(NULL, NULL);
+	statsAdd(STATS_COMMANDS, 1);
+	profileCommand();
+
+	// "alias" and "unalias" work on the tokens as they were typed, before anything is expanded
+	if (strcasecmp(tokens[0], "alias") == 0 || strcasecmp(tokens[0], "unalias") == 0) {
+		aliasCommand(tokens, numOfTokens);
+		tokens = freeStrTokens(tokens, numOfTokens);
+		return;
+	}
+
+	// replace the program names that are aliases with the tokens of the alias
+	allocPhaseSet(ALLOC_EXPAND);
+	tokens = expandAliases(tokens, &numOfTokens);
+	traceLap("expand", "expandAliases");
+	if (tokens == NULL) {
+		exit_status = 1;
 		return;
 	}
 
 	// replace the "~/" with home directory
+	allocPhaseSet(ALLOC_TILDE);
 	ssize_t result = replaceWithHomeDir(tokens, numOfTokens);
+	traceLap("expand", "replaceWithHomeDir");
 
 	// if result is -1, then set exit status to 1
 	if (result == -1) {
@@ -214,41 +1349,125 @@ void parseCommand(char *command) {
 		return;
 	}
 
+	// call takeAssignments() to remove the assignments at the start of the command, like "LC_ALL=C" in "LC_ALL=C sort"
+	// if the command is made of assignments only, then they set shell variables and the command is done
+	allocPhaseSet(ALLOC_EXPAND);
+	result = takeAssignments(tokens, &numOfTokens);
+	traceLap("expand", "takeAssignments");
+	if (result == -1 || numOfTokens == 0) {
+		exit_status = result == -1 ? 1 : 0;
+		tokens = freeStrTokens(tokens, numOfTokens);
+		clearCommandState();
+		return;
+	}
+
+	// call braceExpand() to replace "{a,b}" and "{1..N}" with the words they generate
+	tokens = braceExpand(tokens, &numOfTokens);
+	traceLap("expand", "braceExpand");
+
+	// if tokens is NULL, then set exit status to 1 and return
+	if (tokens == NULL) {
+		exit_status = 1;
+		clearCommandState();
+		return;
+	}
+
+	// call expandVariables() to replace "$NAME" and "${NAME}" with the values of the variables
+	// tokens that become empty are removed, so a command of undefined variables does nothing
+	result = expandVariables(tokens, numOfTokens);
+	traceLap("expand", "expandVariables");
+	if (result <= 0) {
+		exit_status = result == -1 ? 1 : 0;
+		tokens = freeStrTokens(tokens, 0);
+		clearCommandState();
+		return;
+	}
+	numOfTokens = (size_t) result;
+	timingLap(&timing.expandNanos);
+
 	// call wildcardFilenames() to replace any wildcard file paths with sequence of filenames
+	allocPhaseSet(ALLOC_WILDCARD);
+	struct timespec probeStart = {0, 0};
+	size_t probeTokens = numOfTokens;
+	if (PROBE_ENABLED(wildcard)) {
+		clock_gettime(CLOCK_MONOTONIC, &probeStart);
+	}
 	tokens = wildcardFilenames(tokens, &numOfTokens);
+	timingLap(&timing.globNanos);
+	traceLap("glob", "wildcardFilenames");
+	if (PROBE_ENABLED(wildcard)) {
+		PROBE3(wildcard, probeTokens, tokens == NULL ? 0 : numOfTokens, elapsedNanos(&probeStart));
+	}
+	profileLap(PROFILE_EXPAND);
 
 	// if tokens is NULL, then set exit status to 1 and return
 	if (tokens == NULL) {
 		exit_status = 1;
+		clearCommandState();
 		return;
 	}
 
 	// check for syntax errors
+	allocPhaseSet(ALLOC_RESOLVE);
 	result = checkCommandSyntax(tokens, numOfTokens);
+	traceLap("resolve", "checkCommandSyntax");
 
 	// if result is -1, then set exit status to 1
 	if (result == -1) {
 		exit_status = 1;
 		tokens = freeStrTokens(tokens, numOfTokens);
+		clearCommandState();
+		return;
+	}
+
+	// if the command is a single program that is a function, then call it
+	definition *f = findDefinition(&functions, tokens[0]);
+	for (size_t i = 0; f != NULL && i < numOfTokens; i++) {
+		if (strcmp(tokens[i], "|") == 0) {
+			f = NULL;
+		}
+	}
+	if (f != NULL) {
+		timingLap(&timing.resolveNanos);
+		traceLap("resolve", "findDefinition");
+		profileLap(PROFILE_SPAWN);
+		allocPhaseSet(ALLOC_EXEC);
+		long long traceStart = traceNow();
+		functionCall(f, tokens, numOfTokens);
+		traceCommandTokens(tokens, numOfTokens);
+		traceSpan("execute", "functionCall", traceStart);
+		tokens = freeStrTokens(tokens, numOfTokens);
+		clearCommandState();
 		return;
 	}
 
 	// replace the program name with the program path
 	result = replaceWithProgramPath(tokens, numOfTokens);
+	traceLap("resolve", "replaceWithProgramPath");
 
 	// if result is -1, then set exit status to 1
 	if (result == -1) {
 		exit_status = 1;
 		tokens = freeStrTokens(tokens, numOfTokens);
+		clearCommandState();
 		return;
 	}
 
 	// at this point, the command is parsed and ready to be executed
 	// call executeCommand() to execute the command
+	timingLap(&timing.resolveNanos);
+	allocPhaseSet(ALLOC_EXEC);
+	long long traceStart = traceNow();
 	executeCommand(tokens, numOfTokens);
+	profileLap(PROFILE_SPAWN);
+
+	// the command line is set again for the span, since a function or a loop that it ran has set its own
+	traceCommandTokens(tokens, numOfTokens);
+	traceSpan("execute", "executeCommand", traceStart);
 
 	// free the memory allocated
 	tokens = freeStrTokens(tokens, numOfTokens);
+	clearCommandState();
 }
 
 // function that executes the command
@@ -259,6 +1478,22 @@ void executeCommand(char **tokens, size_t numOfTokens) {
 		return;
 	}
 
+	// a command of a function or a loop that starts with "time" has already been expanded, so only its programs are measured
+	// and "bench" runs the rest of it through runTokens() again, where only words with wildcards or braces are expanded differently
+	// "monitor" samples the programs of the rest of it
+	if (strcasecmp(tokens[0], "time") == 0) {
+		timeCommand(tokens, numOfTokens, false);
+		return;
+	}
+	if (strcasecmp(tokens[0], "bench") == 0) {
+		benchCommand(tokens, numOfTokens);
+		return;
+	}
+	if (strcasecmp(tokens[0], "monitor") == 0) {
+		monitorCommand(tokens, numOfTokens, false);
+		return;
+	}
+
 	// if the command does not contain a pipe, then call singleProgram()
 	// iterate over tokens and use strcmp to check if the token is a pipe
 	bool pipeFound = false;
@@ -270,11 +1505,14 @@ void executeCommand(char **tokens, size_t numOfTokens) {
 	}
 
 	// if pipe is found, then call multiProgram()
+	// the feeders of "<*" that the command started are waited for once its programs are done
+	streamFeeder *outerFeeders = streamFeeders;
 	if (pipeFound) {
 		multiProgram(tokens, numOfTokens);
 	} else {
 		singleProgram(tokens, numOfTokens);
 	}
+	joinStreamFeeders(outerFeeders);
 }
 
 // function that checks the arguments of this program
@@ -316,8 +1554,32 @@ void greet() {
 
 // function that exits the program successfully
 void exitCommand() {
+	// stop sampling the shell and write its stacks if "--self-profile" was given, so the reports below are not in them
+	selfProfileWrite();
+
+	// stop the front-end thread and free the lines it has prepared
+	frontEndStop();
+	freeTiming();
+
+	// write the trace now that no other thread is recording, and print the stats if MYSH_STATS is set and the profile if "--profile" was given
+	traceWrite();
+	statsDump();
+	profileWrite();
+
+	// log the commands that are still running, like the "exit" that called this, and write the rest of the log
+	reportClose();
+
 	// free all global variables
 	homeDir = Free(homeDir);
+	freeWorkingDirectory();
+	freeDefinitions();
+	freeVariables();
+
+	// print the allocations to stderr if the shell was built with MYSH_ALLOC_STATS and MYSH_ALLOC_REPORT is set
+	// this is done last, so the live bytes are the ones that were never freed
+	if (getenv("MYSH_ALLOC_REPORT") != NULL) {
+		allocReport(STDERR_FILENO);
+	}
 
 	// if INTERACTIVE, prints "mysh: exiting" to stdout and exits successfully
 	if (shellMode == INTERACTIVE) {
@@ -364,58 +1626,29 @@ void pwdCommand(char **tokens, size_t numOfTokens) {
 	// free the args because they are not needed
 	args = freeArrayOfStrings(args, numOfArgs);
 
-	// extract stdout redirection file path if it exists from the tokens
-	const char *stdOutFile = NULL;
-	for (size_t i = 0; i < numOfTokens; i++) {
-		if (strcmp(tokens[i], ">") == 0) {
-			stdOutFile = tokens[i + 1];
-			break;
-		}
-	}
-
-	// declare a file descriptor for stdout
-	int stdOutFd = STDOUT_FILENO;
-
-	if (stdOutFile != NULL) {
-		// if the file exists, then open it with O_WRONLY | O_CREAT | O_TRUNC
-		// mode is 0640
-		// if the file does not exist, then create it
-		// if the file exists, then truncate it
-		// if the file cannot be opened, then print an error message to stderr and set exit status to 1
-		stdOutFd = open(stdOutFile, O_WRONLY | O_CREAT | O_TRUNC, 0640);
-		if (stdOutFd == -1) {
-			perror("open");
-			exit_status = 1;
-			return;
-		}
+	// the working directory is kept up to date by cd, so it is printed without calling getcwd()
+	const char *cwd = workingDirectory();
+	if (cwd == NULL) {
+		perror("getcwd");
+		exit_status = 1;
+		return;
 	}
 
-	// using getcwd() to get the current working directory
-	// use a dynamic buffer to store the path
-	// if getcwd returns NULL, increase buffer size and try again until it works
-	// print the path
-	char *buffer = malloc(sizeof(char) * 101);
-	size_t size = 101;
-	while (getcwd(buffer, size) == NULL) {
-		size += 100;
-		buffer = Free(buffer);
-		buffer = malloc(sizeof(char) * size);
+	// open the stdout redirection if it exists
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	if (stdOutFd == -1) {
+		exit_status = 1;
+		return;
 	}
 
-	// increase buffer size by 1 if the buffer is full
-	if (strlen(buffer) + 1 == size) {
-		buffer = realloc(buffer, sizeof(char) * (size + 1));
+	// print the path followed by a newline with a single system call
+	struct iovec line[2] = {{(void *) cwd, strlen(cwd)}, {"\n", 1}};
+	if (writev(stdOutFd, line, 2) == -1) {
+		perror("writev");
 	}
 
-	// concat a newline character to the end of the buffer
-	strcat(buffer, "\n");
-
-	// print to stdout and free the buffer
-	write(stdOutFd, buffer, strlen(buffer));
-	buffer = Free(buffer);
-
 	// close the file descriptor if it was opened
-	if (stdOutFile != NULL && close(stdOutFd) == -1) {
+	if (stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
 		perror("close");
 		exit_status = 1;
 		return;
@@ -440,23 +1673,24 @@ void cdCommand(char **tokens, size_t numOfTokens) {
 	}
 
 	// if no arguments are given, then change to home directory
+	// "cd -" changes to the previous directory and prints it
+	// otherwise change to the given directory
 	if (numOfArgs == 1) {
-		if (chdir(homeDir) == -1) {
-			perror("chdir");
-			exit_status = 1;
-		} else {
-			exit_status = 0;
-		}
-	}
-
-	// if 1 argument is given, then change to the given directory
-	else {
-		if (chdir(args[1]) == -1) {
-			perror("chdir");
+		exit_status = changeDirectory(homeDir) == -1 ? 1 : 0;
+	} else if (strcmp(args[1], "-") == 0) {
+		const char *oldPwd = getVariable("OLDPWD");
+		if (oldPwd == NULL) {
+			write(STDERR_FILENO, "cd: OLDPWD not set\n", 19);
 			exit_status = 1;
 		} else {
-			exit_status = 0;
+			exit_status = changeDirectory(oldPwd) == -1 ? 1 : 0;
+			if (exit_status == 0 && logicalCwd != NULL) {
+				writeAll(STDOUT_FILENO, logicalCwd, strlen(logicalCwd));
+				writeAll(STDOUT_FILENO, "\n", 1);
+			}
 		}
+	} else {
+		exit_status = changeDirectory(args[1]) == -1 ? 1 : 0;
 	}
 
 	// free the args because they are not needed
@@ -478,17 +1712,36 @@ char* findProgramPath(const char *program) {
 		return strdup(program);
 	}
 
-	// otherwise, we know program is just a file name so traverse the list of directories
-	// define list of directories to search
-	char *dirs[] = {
-		"/usr/local/sbin/", 
-		"/usr/local/bin/", 
-		"/usr/sbin/", 
-		"/usr/bin/", 
-		"/sbin/", 
-		"/bin/"
-	};
-	size_t numOfDirs = 6;
+	// a compiled script that is running, or the front-end thread, has already found the paths of its programs
+	const char *compiledPath = compiledProgramPath(program);
+	if (compiledPath == NULL) {
+		compiledPath = preparedProgramPath(program);
+	}
+	if (compiledPath != NULL) {
+		statsAdd(STATS_PATHS_PREPARED, 1);
+		PROBE3(resolve, program, compiledPath, 0);
+		return strdup(compiledPath);
+	}
+
+	// otherwise, we know program is just a file name so search for it
+	statsAdd(STATS_PATHS_SEARCHED, 1);
+	if (!PROBE_ENABLED(resolve)) {
+		return searchProgramPath(program);
+	}
+	struct timespec probeStart = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &probeStart);
+	char *path = searchProgramPath(program);
+	PROBE3(resolve, program, path, elapsedNanos(&probeStart));
+	return path;
+}
+
+// function that returns the full path of a program name in the first directory of searchDirs that has it
+// it only looks at the filesystem, so the front-end thread can call it too
+// returns NULL if the program is not found
+char* searchProgramPath(const char *program) {
+	// traverse the list of directories in searchDirs
+	const char **dirs = searchDirs;
+	size_t numOfDirs = NUM_SEARCH_DIRS;
 
 	// check each directory in the list from beginning to end in order to find the file
 	// if the file is found, then return the full path of the file
@@ -517,14 +1770,64 @@ char* findProgramPath(const char *program) {
 }
 
 // function that executes a program and collects its exit status. Args must be NULL terminated
-void executeProgram(const char *programPath, char **args, const int *stdInFd, const int *stdOutFd, bool isFinal, int *pipeFd, bool *pipeSet) {
+// returns the pid of the child process, or -1 if fork failed
+pid_t executeProgram(const char *programPath, char **args, char **envp, const int *stdInFd, const int *stdOutFd, bool isFinal, int *pipeFd, bool *pipeSet) {
 	// initialize variables for wait()
 	int status = 0;
 	pid_t gotPid = 0;
 	bool abnormalExit = false;
 
+	// a close-on-exec pipe tells when execve() has replaced the child. it is used for every program of a timed command,
+	// and while MYSH_STATS is set for the last program of every command, since the shell only waits after starting it, for the latencies that stats prints
+	int execPipe[2] = {-1, -1};
+	struct timespec started;
+	long long execNanos = -1;
+	bool recordStage = timing.active && timing.recordStages;
+	bool recordLatency = isFinal && getVariable("MYSH_STATS") != NULL;
+	if (recordStage || recordLatency) {
+		clock_gettime(CLOCK_MONOTONIC, &started);
+		if (pipe2(execPipe, O_CLOEXEC) == -1) {
+			execPipe[0] = -1;
+			execPipe[1] = -1;
+		}
+	}
+
+	// the stage is 1 for the program that reads the pipe of a command, which has at most one pipe
+	int stage = pipeSet != NULL && pipeSet[0] ? 1 : 0;
+	int stdInFdValue = stdInFd == NULL ? -1 : *stdInFd;
+	int stdOutFdValue = stdOutFd == NULL ? -1 : *stdOutFd;
+	long long traceStart = traceNow();
+
 	// fork a child process
 	pid_t pid = fork();
+	if (pid > 0) {
+		statsAdd(STATS_FORKS, 1);
+		traceChildStarted(pid, traceStart, stage, stdInFdValue, stdOutFdValue, programPath);
+		reportChildStarted(pid, programPath);
+		monitorChildStarted(pid, stage, programPath);
+		PROBE3(fork, pid, programPath, stage);
+	}
+	if (pid != 0 && execPipe[0] != -1) {
+		// the read end sees end of file once the child has no write end left, which is when execve() succeeds or the child exits
+		close(execPipe[1]);
+		char c;
+		while (pid != -1 && read(execPipe[0], &c, 1) == -1 && errno == EINTR) {
+		}
+		statsAdd(STATS_READ, 1);
+		close(execPipe[0]);
+		if (pid != -1) {
+			execNanos = elapsedNanos(&started);
+			if (recordStage) {
+				timingStarted(pid, programPath, &started, execNanos);
+			}
+			if (recordLatency) {
+				statsRecord(&stats.forkToExec, execNanos);
+			}
+		}
+	}
+	if (pid != 0) {
+		traceProgramSpan("execute", "fork", traceStart, pid, stage, stdInFdValue, stdOutFdValue, programPath);
+	}
 	switch (pid) {
 		case -1:
 			// if fork returns -1, then perror and set exit status to 1
@@ -546,9 +1849,10 @@ void executeProgram(const char *programPath, char **args, const int *stdInFd, co
 					exit_status = 1;
 				}
 			}
+			traceStart = traceNow();
 			while (true) {
 				// get the pid of the child process that finished
-				gotPid = wait(&status);
+				gotPid = waitChild(-1, &status);
 
 				// if wait returns -1 or 0, there is an error or there are no more child processes
 				if (gotPid == -1 || gotPid == 0) {
@@ -575,16 +1879,21 @@ void executeProgram(const char *programPath, char **args, const int *stdInFd, co
 				if (abnormalExit == false && gotPid == pid && WIFEXITED(status) == true) {
 					exit_status = WEXITSTATUS(status);
 				}
+				if (gotPid == pid && recordLatency && execNanos != -1) {
+					statsRecord(&stats.execToExit, elapsedNanos(&started) - execNanos);
+				}
 			}
+			traceProgramSpan("execute", "wait", traceStart, pid, stage, -1, -1, programPath);
 			break;
 
 		case 0:
 			// if fork returns 0, then we are in the child process
+			// the child exits with _exit() because the threads of the shell do not exist in it, so the memory they hold would look leaked
 			// if stdInFd is not NULL, then redirect stdin to the file descriptor
 			if (stdInFd != NULL) {
 				if (dup2(*stdInFd, STDIN_FILENO) == -1) {
 					perror("dup2");
-					exit(EXIT_FAILURE);
+					_exit(EXIT_FAILURE);
 				}
 			}
 
@@ -592,7 +1901,7 @@ void executeProgram(const char *programPath, char **args, const int *stdInFd, co
 			if (stdOutFd != NULL) {
 				if (dup2(*stdOutFd, STDOUT_FILENO) == -1) {
 					perror("dup2");
-					exit(EXIT_FAILURE);
+					_exit(EXIT_FAILURE);
 				}
 			}
 
@@ -602,22 +1911,26 @@ void executeProgram(const char *programPath, char **args, const int *stdInFd, co
 			if (pipeFd != NULL && pipeSet != NULL && pipeSet[0] == false) {
 				if (close(pipeFd[0]) == -1) {
 					perror("close");
-					exit(EXIT_FAILURE);
+					_exit(EXIT_FAILURE);
 				}
 			}
 			if (pipeFd != NULL && pipeSet != NULL && pipeSet[1] == false) {
 				if (close(pipeFd[1]) == -1) {
 					perror("close");
-					exit(EXIT_FAILURE);
+					_exit(EXIT_FAILURE);
 				}
 			}
-			// use execv() to execute the program
-			// execv only returns when there is an error
+			// use execve() to execute the program with the exported shell variables as its environment
+			// execve only returns when there is an error
 			// so then perror and exit the child process with exit status 1
-			execv(programPath, args);
-			perror("execv");
-			exit(EXIT_FAILURE);
+			PROBE2(exec, programPath, args);
+			execve(programPath, args, envp);
+			perror("execve");
+			_exit(EXIT_FAILURE);
 	}
+
+	// return the pid of the child process
+	return pid;
 }
 
 // function that replaces tokens that begin with "~/" with the home directory
@@ -647,119 +1960,584 @@ ssize_t replaceWithHomeDir(char **tokens, size_t numOfTokens) {
 	return 0;
 }
 
-// function that returns a list of filenames that match the pattern in the file path
-char** getFilenames(const char *filePath, size_t *numOfFilenames) {
-	// if filePath is NULL, then return NULL
-	if (filePath == NULL || strlen(filePath) == 0 || numOfFilenames == NULL) {
+// function that replaces the tokens with brace expressions like "{a,b}" or "shard-{0..4095}.dat" with the words they generate
+// the words are generated from the text alone, so no directory is read even if the files do not exist yet
+// a brace expression that generates more than BRACE_LAZY_WORDS words is replaced with LAZY_BRACE_MARK instead,
+// and singleProgram() generates its words one chunk at a time while the runs of the program start
+// this is only done for one argument of a program that is not a built-in, in a command without a pipe
+// returns NULL if an error occurs
+char** braceExpand(char **tokens, size_t *numOfTokens) {
+	// if tokens is NULL or numOfTokens is NULL, then return NULL
+	if (tokens == NULL || numOfTokens == NULL) {
 		return NULL;
 	}
 
-	// initialize numOfFilenames to 0
-	*numOfFilenames = 0;
-
-	// if the filePath does not contain a "*" then return NULL
-	if (strchr(filePath, '*') == NULL) {
-		return NULL;
+	// a lazy brace expression is only possible when the command is a single program
+	bool lazyAllowed = !isBuiltIn(tokens[0]);
+	for (size_t i = 0; i < *numOfTokens; i++) {
+		if (strcmp(tokens[i], "|") == 0) {
+			lazyAllowed = false;
+		}
 	}
-
-	// if the filePath contains more than 1 "*" in the whole filePath then return NULL
-	if (strchr(filePath, '*') != strrchr(filePath, '*')) {
+	lazyBrace = braceFree(lazyBrace);
+
+	// count the words of every token, so the new tokens array can be allocated once
+	// the file path of a redirection is never expanded
+	size_t numOfWords = 0;
+	braceGenerator *generators = calloc(*numOfTokens, sizeof(braceGenerator));
+	bool *isGenerated = calloc(*numOfTokens, sizeof(bool));
+	if (generators == NULL || isGenerated == NULL) {
+		perror("calloc");
+		generators = Free(generators);
+		isGenerated = Free(isGenerated);
+		tokens = freeStrTokens(tokens, *numOfTokens);
 		return NULL;
 	}
-	
-	// the filePath is like "/dir1/dir2/dir3/a*t.txt" or "/dir1/a*" or "/dir1/*a" or "/dir1/*" or "/dir1/a*t" or "*a" or "*"
-	// if it is just the filename without "/", then search the current directory
-	// first check whether the path is a directory or a file. If it is a directory, then return NULL
-	// if the last character is a "/" that means the path is a directory so return NULL
-	size_t filePathLen = strlen(filePath);
-	if (filePath[filePathLen - 1] == '/') {
-		return NULL;
+	for (size_t i = 0; i < *numOfTokens; i++) {
+		if ((i > 0 && isRedirection(tokens[i - 1])) || braceParse(tokens[i], &generators[i]) == false) {
+			numOfWords++;
+			continue;
+		}
+		isGenerated[i] = true;
+		if (generators[i].count > BRACE_LAZY_WORDS && lazyAllowed && i > 0 && lazyBrace == NULL && isWildcardSegment(tokens[i]) == false) {
+			lazyBrace = malloc(sizeof(braceGenerator));
+			if (lazyBrace != NULL) {
+				*lazyBrace = generators[i];
+				memset(&generators[i], 0, sizeof(braceGenerator));
+				numOfWords++;
+				continue;
+			}
+		}
+		// the sum stops just above BRACE_MAX_WORDS, since a count of braceParse() may be as large as SIZE_MAX and would wrap it
+		if (numOfWords > BRACE_MAX_WORDS || generators[i].count > BRACE_MAX_WORDS - numOfWords) {
+			numOfWords = BRACE_MAX_WORDS + 1;
+		} else {
+			numOfWords += generators[i].count;
+		}
 	}
 
-	// extract the directory path (dirPath) and the file pattern (filePattern) from the filePath
-	// if there is no directory path, then set dirPath to "./" so that the full path becomes "./a*t.txt"
-	// otherwise if filePath is "/dir1/dir2/dir3/a*" then dirPath is "/dir1/dir2/dir3/" and filePattern is "a*"
-	char *dirPath = NULL;
-	char *filePattern = NULL;
-	if (strchr(filePath, '/') == NULL) {
-		dirPath = strdup("./");
-		filePattern = strdup(filePath);
+	// a brace expression that has to be generated all at once may not exceed BRACE_MAX_WORDS words
+	char **words = NULL;
+	if (numOfWords <= BRACE_MAX_WORDS) {
+		words = malloc(sizeof(char *) * (numOfWords + 1));
+	} else {
+		write(STDERR_FILENO, "brace expansion too large\n", 26);
 	}
-	else {
-		// if there is a directory path, then extract the directory path and the file pattern
-		// first find the last occurrence of "/". No need to check for NULL because we already checked for "/" above
-		char *lastSlash = strrchr(filePath, '/');
 
-		// if filePath is "/dir1/a*" then copy "/dir1/" to dirPath and "a*" to filePattern
-		// allocate memory for dirPath and copy the directory path to dirPath
-		dirPath = malloc(lastSlash - filePath + 2);
-		if (dirPath == NULL) {
-			perror("malloc");
-			exit_status = 1;
-			return NULL;
+	// copy the tokens into the new array, replacing each brace expression with its words
+	size_t n = 0;
+	for (size_t i = 0; i < *numOfTokens; i++) {
+		if (words == NULL) {
+			if (isGenerated[i]) {
+				braceFree(&generators[i]);
+			}
+			tokens[i] = Free(tokens[i]);
+			continue;
 		}
-
-		// copy the directory path to dirPath
-		strncpy(dirPath, filePath, lastSlash - filePath + 1);
-		dirPath[lastSlash - filePath + 1] = '\0';
-
-		// allocate memory for filePattern and copy the file pattern to filePattern
-		filePattern = strdup(lastSlash + 1);
-		if (filePattern == NULL) {
-			perror("strdup");
-			exit_status = 1;
-			dirPath = Free(dirPath);
-			return NULL;
+		if (isGenerated[i] == false) {
+			words[n++] = tokens[i];
+			continue;
 		}
+		tokens[i] = Free(tokens[i]);
+		if (generators[i].numOfGroups == 0) {
+			// the brace expression was moved into lazyBrace
+			words[n++] = strdup(LAZY_BRACE_MARK);
+			continue;
+		}
+		char *word = NULL;
+		while ((word = braceNext(&generators[i])) != NULL) {
+			words[n++] = word;
+		}
+		braceFree(&generators[i]);
 	}
-
-	// at this point dirPath and filePattern are set
-	// if file pattern does not contain a "*" then return NULL
-	if (strchr(filePattern, '*') == NULL) {
-		dirPath = Free(dirPath);
-		filePattern = Free(filePattern);
+	tokens = Free(tokens);
+	generators = Free(generators);
+	isGenerated = Free(isGenerated);
+	if (words == NULL) {
+		lazyBrace = braceFree(lazyBrace);
 		return NULL;
 	}
 
-	// open the directory for reading filenames
-	DIR *dir = opendir(dirPath);
-
-	if (dir == NULL) {
-		dirPath = Free(dirPath);
-		filePattern = Free(filePattern);
+	// if a word could not be allocated, then free the words and return NULL
+	// words that are empty (like the first word of "{,a}") are dropped
+	size_t kept = 0;
+	bool failed = false;
+	for (size_t i = 0; i < n; i++) {
+		if (words[i] == NULL) {
+			failed = true;
+		} else if (words[i][0] == '\0') {
+			words[i] = Free(words[i]);
+		} else {
+			words[kept++] = words[i];
+		}
+	}
+	words[kept] = NULL;
+	*numOfTokens = kept;
+	if (failed || kept == 0) {
+		words = freeStrTokens(words, kept);
+		lazyBrace = braceFree(lazyBrace);
 		return NULL;
 	}
+	return words;
+}
 
-	// first count the number of filenames that match the file pattern
-	// if the file pattern is "*" then all filenames match
-	// if the file pattern is "a*" then the filename must start with "a"
-	// if the file pattern is "*a" then the filename must end with "a"
-	// if the file pattern is "a*t" then the filename must start with "a" and end with "t"
-	// if the file pattern is "ab*t.txt" then the filename must start with "ab" and end with "t.txt"
-	// initialize variables to count the number of filenames that match the file pattern
-	size_t numOfCharsBeforeAst = strcspn(filePattern, "*");
-	size_t numOfCharsAfterAst = strlen(filePattern) - numOfCharsBeforeAst - 1;
+// function that parses the brace groups of a token into a generator
+// a "{" starts a group if its matching "}" follows and the text between them has a "," outside nested braces
+// or is a range like "1..10", "1..10..2" or "a..e", otherwise the "{" is an ordinary character
+// returns false if the token has no brace group or an error occurs
+bool braceParse(const char *token, braceGenerator *g) {
+	memset(g, 0, sizeof(braceGenerator));
+	size_t length = strlen(token);
+	if (strchr(token, '{') == NULL) {
+		return false;
+	}
 
-	// initialize a variable to store a pointer to the current entry in the directory
-	struct dirent *entry = NULL;
+	// there are at most length / 2 groups, and a literal before, between and after them
+	g->literals = calloc(length / 2 + 2, sizeof(char *));
+	g->groups = calloc(length / 2 + 1, sizeof(braceGroup));
+	if (g->literals == NULL || g->groups == NULL) {
+		braceFree(g);
+		return false;
+	}
 
-	// set errno to 0 before calling readdir() to check for errors
-	errno = 0;
-	while ((entry = readdir(dir)) != NULL) {
-		// extract filename from the current entry
-		char *filename = entry->d_name;
+	size_t literalStart = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (token[i] != '{') {
+			continue;
+		}
 
-		// if filename is NULL or filename is empty or begins with ".", then skip to the next filename
-		if (filename == NULL || strlen(filename) == 0 || filename[0] == '.') {
+		// find the matching "}" and whether there is a "," outside nested braces
+		size_t depth = 0;
+		size_t close = length;
+		bool isList = false;
+		for (size_t j = i; j < length; j++) {
+			if (token[j] == '{') {
+				depth++;
+			} else if (token[j] == '}' && --depth == 0) {
+				close = j;
+				break;
+			} else if (token[j] == ',' && depth == 1) {
+				isList = true;
+			}
+		}
+		if (close == length) {
+			break;
+		}
+		if (braceGroupParse(&g->groups[g->numOfGroups], token + i + 1, close - i - 1, isList) == false) {
 			continue;
 		}
 
-		// concatenate the directory path and the filename to get the full path
-		char *fullFilePath = malloc(strlen(dirPath) + strlen(filename) + 1);
+		// save the literal before the group
+		g->literals[g->numOfGroups] = strndup(token + literalStart, i - literalStart);
+		g->numOfGroups++;
+		if (g->literals[g->numOfGroups - 1] == NULL) {
+			braceFree(g);
+			return false;
+		}
+		literalStart = close + 1;
+		i = close;
+	}
 
-		if (fullFilePath == NULL) {
-			perror("malloc");
-			exit_status = 1;
+	// if there is no group, then the token is not a brace expression
+	if (g->numOfGroups == 0) {
+		braceFree(g);
+		return false;
+	}
+
+	// save the literal after the last group and multiply the number of words of every group
+	g->literals[g->numOfGroups] = strdup(token + literalStart);
+	g->count = 1;
+	for (size_t i = 0; i < g->numOfGroups; i++) {
+		if (g->groups[i].count != 0 && g->count > SIZE_MAX / g->groups[i].count) {
+			g->count = SIZE_MAX;
+			break;
+		}
+		g->count *= g->groups[i].count;
+	}
+	if (g->literals[g->numOfGroups] == NULL) {
+		braceFree(g);
+		return false;
+	}
+	return true;
+}
+
+// function that parses the text between the braces of a group into a list of alternatives or a range
+// returns false if the text is neither
+bool braceGroupParse(braceGroup *group, const char *body, size_t bodyLength, bool isList) {
+	memset(group, 0, sizeof(braceGroup));
+	char *text = strndup(body, bodyLength);
+	if (text == NULL) {
+		return false;
+	}
+	if (isList == false) {
+		bool isRange = braceRangeParse(group, text);
+		text = Free(text);
+		return isRange;
+	}
+
+	// split the text at the "," outside nested braces, and expand the alternatives that have braces of their own
+	size_t capacity = 4;
+	group->alternatives = malloc(sizeof(char *) * capacity);
+	size_t depth = 0;
+	size_t start = 0;
+	for (size_t i = 0; group->alternatives != NULL && i <= bodyLength; i++) {
+		if (i < bodyLength && text[i] == '{') {
+			depth++;
+		} else if (i < bodyLength && text[i] == '}' && depth > 0) {
+			depth--;
+		}
+		if (i < bodyLength && (text[i] != ',' || depth > 0)) {
+			continue;
+		}
+		text[i] = '\0';
+		braceGenerator nested;
+		bool isNested = braceParse(text + start, &nested);
+		size_t numOfNew = isNested ? nested.count : 1;
+		if (group->numOfAlternatives + numOfNew > BRACE_MAX_WORDS) {
+			if (isNested) {
+				braceFree(&nested);
+			}
+			group->alternatives = freeArrayOfStrings(group->alternatives, group->numOfAlternatives);
+			break;
+		}
+		if (group->numOfAlternatives + numOfNew > capacity) {
+			while (group->numOfAlternatives + numOfNew > capacity) {
+				capacity *= 2;
+			}
+			char **grown = realloc(group->alternatives, sizeof(char *) * capacity);
+			if (grown == NULL) {
+				if (isNested) {
+					braceFree(&nested);
+				}
+				group->alternatives = freeArrayOfStrings(group->alternatives, group->numOfAlternatives);
+				break;
+			}
+			group->alternatives = grown;
+		}
+		if (isNested) {
+			char *word = NULL;
+			while ((word = braceNext(&nested)) != NULL) {
+				group->alternatives[group->numOfAlternatives++] = word;
+			}
+			braceFree(&nested);
+		} else {
+			group->alternatives[group->numOfAlternatives++] = strdup(text + start);
+		}
+		start = i + 1;
+	}
+	text = Free(text);
+	if (group->alternatives == NULL) {
+		group->numOfAlternatives = 0;
+		return false;
+	}
+	group->count = group->numOfAlternatives;
+	return true;
+}
+
+// function that parses a range like "1..10", "-5..5", "01..10", "1..10..3" or "a..e" into a group
+// returns false if the text is not a range
+bool braceRangeParse(braceGroup *group, const char *body) {
+	const char *dots = strstr(body, "..");
+	if (dots == NULL || dots == body) {
+		return false;
+	}
+	char *firstText = strndup(body, (size_t) (dots - body));
+	char *lastText = strdup(dots + 2);
+	if (firstText == NULL || lastText == NULL) {
+		firstText = Free(firstText);
+		lastText = Free(lastText);
+		return false;
+	}
+
+	// an optional increment follows a second ".."
+	long increment = 1;
+	char *stepDots = strstr(lastText, "..");
+	bool valid = true;
+	if (stepDots != NULL) {
+		*stepDots = '\0';
+		char *end = NULL;
+		errno = 0;
+		increment = strtol(stepDots + 2, &end, 10);
+		valid = errno == 0 && stepDots[2] != '\0' && *end == '\0' && increment != LONG_MIN;
+		if (increment < 0) {
+			increment = -increment;
+		}
+		if (increment == 0) {
+			increment = 1;
+		}
+	}
+
+	// both ends are single letters, or both are integers
+	long first = 0;
+	long last = 0;
+	if (valid && strlen(firstText) == 1 && strlen(lastText) == 1 && isalpha((unsigned char) firstText[0]) && isalpha((unsigned char) lastText[0])) {
+		group->letters = true;
+		first = (unsigned char) firstText[0];
+		last = (unsigned char) lastText[0];
+	} else if (valid) {
+		char *firstEnd = NULL;
+		char *lastEnd = NULL;
+		errno = 0;
+		first = strtol(firstText, &firstEnd, 10);
+		last = strtol(lastText, &lastEnd, 10);
+		valid = errno == 0 && firstText[0] != '\0' && lastText[0] != '\0' && *firstEnd == '\0' && *lastEnd == '\0';
+
+		// an end written with a leading zero pads every number to the longer of the two ends
+		const char *firstDigits = firstText[0] == '-' ? firstText + 1 : firstText;
+		const char *lastDigits = lastText[0] == '-' ? lastText + 1 : lastText;
+		if ((firstDigits[0] == '0' && firstDigits[1] != '\0') || (lastDigits[0] == '0' && lastDigits[1] != '\0')) {
+			size_t width = strlen(firstText) > strlen(lastText) ? strlen(firstText) : strlen(lastText);
+			group->width = (int) width;
+		}
+	}
+	firstText = Free(firstText);
+	lastText = Free(lastText);
+	if (valid == false) {
+		return false;
+	}
+
+	// count the values from first to last, in the direction of last
+	// a range of every long has one value more than an unsigned long can count, so it is left as a literal word like bash does
+	unsigned long distance = first <= last ? (unsigned long) last - (unsigned long) first : (unsigned long) first - (unsigned long) last;
+	if (distance / (unsigned long) increment == ULONG_MAX) {
+		return false;
+	}
+	group->first = first;
+	group->step = first <= last ? increment : -increment;
+	group->count = distance / (unsigned long) increment + 1;
+	return true;
+}
+
+// function that returns the word at the given index of a brace expression
+// the index is split into the index of every group like the digits of a number, with the last group as the lowest digit
+// returns NULL if an error occurs
+char* braceWord(const braceGenerator *g, size_t index) {
+	// find the alternative or value of every group, starting from the last one
+	size_t length = 0;
+	char numbers[g->numOfGroups][24];
+	const char *parts[g->numOfGroups];
+	for (size_t i = g->numOfGroups; i > 0; i--) {
+		const braceGroup *group = &g->groups[i - 1];
+		size_t digit = index % group->count;
+		index /= group->count;
+		if (group->alternatives != NULL) {
+			parts[i - 1] = group->alternatives[digit];
+		} else if (group->letters) {
+			numbers[i - 1][0] = (char) (group->first + group->step * (long) digit);
+			numbers[i - 1][1] = '\0';
+			parts[i - 1] = numbers[i - 1];
+		} else {
+			// the value is computed in unsigned arithmetic, since step * digit alone may not fit in a long even though the value does
+			long value = (long) ((unsigned long) group->first + (unsigned long) group->step * digit);
+			snprintf(numbers[i - 1], sizeof(numbers[i - 1]), "%0*ld", group->width, value);
+			parts[i - 1] = numbers[i - 1];
+		}
+		length += strlen(parts[i - 1]) + strlen(g->literals[i - 1]);
+	}
+	length += strlen(g->literals[g->numOfGroups]);
+
+	// join the literals and the parts
+	char *word = malloc(length + 1);
+	if (word == NULL) {
+		perror("malloc");
+		return NULL;
+	}
+	size_t n = 0;
+	for (size_t i = 0; i <= g->numOfGroups; i++) {
+		size_t literalLength = strlen(g->literals[i]);
+		memcpy(word + n, g->literals[i], literalLength);
+		n += literalLength;
+		if (i < g->numOfGroups) {
+			size_t partLength = strlen(parts[i]);
+			memcpy(word + n, parts[i], partLength);
+			n += partLength;
+		}
+	}
+	word[n] = '\0';
+	return word;
+}
+
+// function that returns the next word of a brace expression, or NULL after the last word or if an error occurs
+char* braceNext(braceGenerator *g) {
+	if (g == NULL || g->next >= g->count) {
+		return NULL;
+	}
+	return braceWord(g, g->next++);
+}
+
+// function that frees the groups and literals of a brace generator
+// a generator that was allocated on its own (like lazyBrace) is freed as well, so this returns NULL for both uses
+braceGenerator* braceFree(braceGenerator *g) {
+	if (g == NULL) {
+		return NULL;
+	}
+	for (size_t i = 0; g->groups != NULL && i < g->numOfGroups; i++) {
+		g->groups[i].alternatives = freeArrayOfStrings(g->groups[i].alternatives, g->groups[i].numOfAlternatives);
+	}
+	if (g->literals != NULL) {
+		for (size_t i = 0; i <= g->numOfGroups; i++) {
+			g->literals[i] = Free(g->literals[i]);
+		}
+	}
+	g->literals = Free(g->literals);
+	g->groups = Free(g->groups);
+	g->numOfGroups = 0;
+	if (g == lazyBrace) {
+		g = Free(g);
+	}
+	return NULL;
+}
+
+// function that replaces the argument at index (a LAZY_BRACE_MARK) with every word of a brace generator
+// this is needed when a program can not be split into several runs, so it gets all the words at once
+// returns NULL if an error occurs, in which case args is freed and numOfArgs is set to 0
+char** braceMaterialize(char **args, size_t *numOfArgs, size_t index, braceGenerator *g) {
+	char **newArgs = NULL;
+	if (g->count > BRACE_MAX_WORDS) {
+		write(STDERR_FILENO, "brace expansion too large\n", 26);
+	} else if ((newArgs = malloc(sizeof(char *) * (*numOfArgs + g->count))) == NULL) {
+		perror("malloc");
+	}
+	if (newArgs == NULL) {
+		args = freeArrayOfStrings(args, *numOfArgs);
+		*numOfArgs = 0;
+		return NULL;
+	}
+
+	// copy the arguments before the mark, the words, and the arguments after the mark
+	memcpy(newArgs, args, sizeof(char *) * index);
+	size_t n = index;
+	char *word = NULL;
+	while ((word = braceNext(g)) != NULL) {
+		if (word[0] == '\0') {
+			word = Free(word);
+			continue;
+		}
+		newArgs[n++] = word;
+	}
+	memcpy(newArgs + n, args + index + 1, sizeof(char *) * (*numOfArgs - index - 1));
+	n += *numOfArgs - index - 1;
+	newArgs[n] = NULL;
+	args[index] = Free(args[index]);
+	args = Free(args);
+	*numOfArgs = n;
+	return newArgs;
+}
+
+// function that returns a list of filenames that match the pattern in the file path
+char** getFilenames(const char *filePath, size_t *numOfFilenames) {
+	// if filePath is NULL, then return NULL
+	if (filePath == NULL || strlen(filePath) == 0 || numOfFilenames == NULL) {
+		return NULL;
+	}
+
+	// initialize numOfFilenames to 0
+	*numOfFilenames = 0;
+
+	// if the filePath does not contain a "*" then return NULL
+	if (strchr(filePath, '*') == NULL) {
+		return NULL;
+	}
+
+	// if the filePath contains more than 1 "*" in the whole filePath then return NULL
+	if (strchr(filePath, '*') != strrchr(filePath, '*')) {
+		return NULL;
+	}
+	
+	// the filePath is like "/dir1/dir2/dir3/a*t.txt" or "/dir1/a*" or "/dir1/*a" or "/dir1/*" or "/dir1/a*t" or "*a" or "*"
+	// if it is just the filename without "/", then search the current directory
+	// first check whether the path is a directory or a file. If it is a directory, then return NULL
+	// if the last character is a "/" that means the path is a directory so return NULL
+	size_t filePathLen = strlen(filePath);
+	if (filePath[filePathLen - 1] == '/') {
+		return NULL;
+	}
+
+	// extract the directory path (dirPath) and the file pattern (filePattern) from the filePath
+	// if there is no directory path, then set dirPath to "./" so that the full path becomes "./a*t.txt"
+	// otherwise if filePath is "/dir1/dir2/dir3/a*" then dirPath is "/dir1/dir2/dir3/" and filePattern is "a*"
+	char *dirPath = NULL;
+	char *filePattern = NULL;
+	if (strchr(filePath, '/') == NULL) {
+		dirPath = strdup("./");
+		filePattern = strdup(filePath);
+	}
+	else {
+		// if there is a directory path, then extract the directory path and the file pattern
+		// first find the last occurrence of "/". No need to check for NULL because we already checked for "/" above
+		char *lastSlash = strrchr(filePath, '/');
+
+		// if filePath is "/dir1/a*" then copy "/dir1/" to dirPath and "a*" to filePattern
+		// allocate memory for dirPath and copy the directory path to dirPath
+		dirPath = malloc(lastSlash - filePath + 2);
+		if (dirPath == NULL) {
+			perror("malloc");
+			exit_status = 1;
+			return NULL;
+		}
+
+		// copy the directory path to dirPath
+		strncpy(dirPath, filePath, lastSlash - filePath + 1);
+		dirPath[lastSlash - filePath + 1] = '\0';
+
+		// allocate memory for filePattern and copy the file pattern to filePattern
+		filePattern = strdup(lastSlash + 1);
+		if (filePattern == NULL) {
+			perror("strdup");
+			exit_status = 1;
+			dirPath = Free(dirPath);
+			return NULL;
+		}
+	}
+
+	// at this point dirPath and filePattern are set
+	// if file pattern does not contain a "*" then return NULL
+	if (strchr(filePattern, '*') == NULL) {
+		dirPath = Free(dirPath);
+		filePattern = Free(filePattern);
+		return NULL;
+	}
+
+	// open the directory for reading filenames
+	statsAdd(STATS_OPEN, 1);
+	DIR *dir = opendir(dirPath);
+
+	if (dir == NULL) {
+		dirPath = Free(dirPath);
+		filePattern = Free(filePattern);
+		return NULL;
+	}
+
+	// first count the number of filenames that match the file pattern
+	// if the file pattern is "*" then all filenames match
+	// if the file pattern is "a*" then the filename must start with "a"
+	// if the file pattern is "*a" then the filename must end with "a"
+	// if the file pattern is "a*t" then the filename must start with "a" and end with "t"
+	// if the file pattern is "ab*t.txt" then the filename must start with "ab" and end with "t.txt"
+	// initialize variables to count the number of filenames that match the file pattern
+	size_t numOfCharsBeforeAst = strcspn(filePattern, "*");
+	size_t numOfCharsAfterAst = strlen(filePattern) - numOfCharsBeforeAst - 1;
+
+	// initialize a variable to store a pointer to the current entry in the directory
+	struct dirent *entry = NULL;
+
+	// set errno to 0 before calling readdir() to check for errors
+	errno = 0;
+	while ((entry = readdir(dir)) != NULL) {
+		// extract filename from the current entry
+		char *filename = entry->d_name;
+
+		// if filename is NULL or filename is empty or begins with ".", then skip to the next filename
+		if (filename == NULL || strlen(filename) == 0 || filename[0] == '.') {
+			continue;
+		}
+
+		// concatenate the directory path and the filename to get the full path
+		char *fullFilePath = malloc(strlen(dirPath) + strlen(filename) + 1);
+
+		if (fullFilePath == NULL) {
+			perror("malloc");
+			exit_status = 1;
 			dirPath = Free(dirPath);
 			filePattern = Free(filePattern);
 			closedir(dir);
@@ -827,6 +2605,7 @@ char** getFilenames(const char *filePath, size_t *numOfFilenames) {
 	// make sure to calculate size of the filename before allocating memory for it
 	// set the last element of the array to NULL
 	// open the directory for reading filenames
+	statsAdd(STATS_OPEN, 1);
 	dir = opendir(dirPath);
 
 	if (dir == NULL) {
@@ -943,15 +2722,35 @@ char** wildcardFilenames(char **tokens, size_t *numOfTokens) {
 	// the tokens that contain wildcards, which are ["./foo*", "*", "file.txt*", "a*", "*b"]
 	size_t numOfTokensCopy = *numOfTokens;
 	size_t numOfFilenames = 0;
+
+	// keep track of where the expanded filenames end up in the new tokens array
+	// newIndex is the index in the new tokens array of the token that is expanded next
+	size_t newIndex = 0;
+	expandedTokensStart = 0;
+	expandedTokensEnd = 0;
 	for (size_t i = 0; i < numOfTokensCopy; i++) {
+		// the pattern of a stream redirection is expanded while the program runs, so skip it
+		if (i > 0 && (strcmp(tokens[i - 1], STREAM_REDIRECT) == 0 || strcmp(tokens[i - 1], STREAM_REDIRECT_NUL) == 0)) {
+			newIndex++;
+			continue;
+		}
+
 		// call getFilenames() to get the filenames that match the wildcard pattern if there is one
 		char **filenames = getFilenamesExt(tokens[i], &numOfFilenames);
 
 		// if there are no filenames that match the wildcard pattern, then skip to the next token
 		if (filenames == NULL) {
+			newIndex++;
 			continue;
 		}
 
+		// record the range of expanded tokens
+		if (expandedTokensEnd == 0) {
+			expandedTokensStart = newIndex;
+		}
+		newIndex += numOfFilenames;
+		expandedTokensEnd = newIndex;
+
 		// at this point, we know that there are filenames that match the wildcard pattern
 		// save old token and set the returned filenames to the token
 		char *oldToken = tokens[i];
@@ -966,6 +2765,8 @@ char** wildcardFilenames(char **tokens, size_t *numOfTokens) {
 		// if the returned string is NULL, then set it back to the old token
 		if (tokens[i] == NULL) {
 			tokens[i] = oldToken;
+			newIndex -= numOfFilenames - 1;
+			expandedTokensEnd = expandedTokensEnd > newIndex ? newIndex : expandedTokensEnd;
 			continue;
 		}
 
@@ -998,6 +2799,7 @@ bool isRegularFile(const char *path) {
 	struct stat st;
 
 	// if stat() returns -1, then return false
+	statsAdd(STATS_STAT, 1);
 	if (stat(path, &st) == -1) {
 		return false;
 	}
@@ -1023,6 +2825,7 @@ bool isExecutableFile(const char *path) {
 	struct stat st;
 
 	// if stat() returns -1, then return false
+	statsAdd(STATS_STAT, 1);
 	if (stat(path, &st) == -1) {
 		return false;
 	}
@@ -1041,7 +2844,7 @@ ssize_t replaceWithProgramPath(char **tokens, size_t numOfTokens) {
 	// tokens are like ["ls", ">", "file.txt", "|", "grep", "a*", "*b"]
 	// the command names are the first token in each subcommand separated by pipes
 	// so including the first token, the token following a pipe is a command name
-	// if the command name is a built-in command using strcasecmp ("cd", "pwd", "exit"), then continue to the next command name
+	// if the command name is a built-in command ("cd", "pwd", "exit", "export", "pushd", "popd", "dirs", "source", "."), then continue to the next command name
 	// if the command name is not a built-in command, then call findProgramPath() to get the full path of the program
 	// if the full path of the program is NULL, then perror() and set exit status to 1 and return -1
 	// if the full path is not NULL, then use isExecutableFile() to check if the full path points to an executable file
@@ -1053,12 +2856,12 @@ ssize_t replaceWithProgramPath(char **tokens, size_t numOfTokens) {
 	for (size_t i = 0; i < numOfTokens; i++) {
 		// if this is not the first token and it is not following a pipe, then continue to the next token
 		// because the first token is a command name, and the token following a pipe is a command name
-		if (i > 0 && strcmp(tokens[i - 1], "|") != 0) {
+		if (!isProgramName(tokens, i, 0)) {
 			continue;
 		}
 
 		// if this is a built-in command, then continue to the next token
-		if (strcasecmp(tokens[i], "cd") == 0 || strcasecmp(tokens[i], "pwd") == 0 || strcasecmp(tokens[i], "exit") == 0) {
+		if (isBuiltIn(tokens[i])) {
 			continue;
 		}
 
@@ -1066,6 +2869,15 @@ ssize_t replaceWithProgramPath(char **tokens, size_t numOfTokens) {
 		// call findProgramPath() to get the full path of the program
 		char *fullPath = findProgramPath(tokens[i]);
 
+		// a function can only be called as a whole command, so a function in a pipeline is an error of its own
+		if (fullPath == NULL && findDefinition(&functions, tokens[i]) != NULL) {
+			commandNotFound = true;
+			write(STDERR_FILENO, "mysh: a function can not be used in a pipeline: ", 48);
+			write(STDERR_FILENO, tokens[i], strlen(tokens[i]));
+			write(STDERR_FILENO, "\n", 1);
+			continue;
+		}
+
 		// if the full path is NULL, then print error and set exit status to 1 and return -1
 		if (fullPath == NULL) {
 			commandNotFound = true;
@@ -1103,6 +2915,10 @@ ssize_t builtIn(char **tokens, size_t numOfTokens) {
 		exit_status = 0;
 		return 0;
 	}
+	struct timespec probeStart = {0, 0};
+	if (PROBE_ENABLED(builtin)) {
+		clock_gettime(CLOCK_MONOTONIC, &probeStart);
+	}
 
 	// if command is "exit", then call exitCommand() to exit the program
 	if (strcasecmp(tokens[0], "exit") == 0) {
@@ -1119,15 +2935,55 @@ ssize_t builtIn(char **tokens, size_t numOfTokens) {
 		cdCommand(tokens, numOfTokens);
 	}
 
+	// if command is "export", then call exportCommand() to export shell variables to programs
+	else if (strcasecmp(tokens[0], "export") == 0) {
+		exportCommand(tokens, numOfTokens);
+	}
+
+	// if command is "pushd", "popd" or "dirs", then call the command that works on the directory stack
+	else if (strcasecmp(tokens[0], "pushd") == 0) {
+		pushdCommand(tokens, numOfTokens);
+	}
+	else if (strcasecmp(tokens[0], "popd") == 0) {
+		popdCommand(tokens, numOfTokens);
+	}
+	else if (strcasecmp(tokens[0], "dirs") == 0) {
+		dirsCommand(tokens, numOfTokens);
+	}
+
+	// if command is "source" or ".", then run the commands of the script in this shell
+	else if (strcasecmp(tokens[0], "source") == 0 || strcmp(tokens[0], ".") == 0) {
+		sourceCommand(tokens, numOfTokens);
+	}
+
+	// if command is "stats", then print the counters and latency histograms of the shell
+	else if (strcasecmp(tokens[0], "stats") == 0) {
+		statsCommand(tokens, numOfTokens);
+	}
+
 	// otherwise this is not a built-in command so return -1
 	else {
 		return -1;
 	}
+	if (PROBE_ENABLED(builtin)) {
+		PROBE3(builtin, tokens[0], exit_status, elapsedNanos(&probeStart));
+	}
 
 	// return 0 because this is a built-in command
 	return 0;
 }
 
+// function that returns whether a program name is handled by builtIn()
+bool isBuiltIn(const char *program) {
+	const char *builtIns[] = {"exit", "pwd", "cd", "export", "pushd", "popd", "dirs", "source", ".", "time", "bench", "stats", "monitor", NULL};
+	for (size_t i = 0; builtIns[i] != NULL; i++) {
+		if (strcasecmp(program, builtIns[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 // function that deals with a command that contains a single program
 void singleProgram(char **tokens, size_t numOfTokens) {
 	// if tokens is NULL or numOfTokens is 0, then return
@@ -1144,7 +3000,9 @@ void singleProgram(char **tokens, size_t numOfTokens) {
 
 	// call builtIn() to check if the command is a built-in command
 	// if it is, then return
+	long long traceStart = traceNow();
 	if (builtIn(tokens, numOfTokens) == 0) {
+		traceSpan("execute", "builtIn", traceStart);
 		return;
 	}
 
@@ -1162,14 +3020,16 @@ void singleProgram(char **tokens, size_t numOfTokens) {
 	// if there is no stdout redirection, then set stdOutFile to NULL
 	// tokens can be like ["ls", "cool", "*", ">", "file.txt", "<", "file2.txt"] or ["ls", "<", "file.txt"] or ["ls"]
 	const char *stdInFile = NULL;
+	const char *stdInOperator = NULL;
 	const char *stdOutFile = NULL;
 	const char *programPath = tokens[0];
 
 	// iterate over tokens and use strcmp to check if the command contains a redirection operator
 	// if it does contain a redirection operator, then set the corresponding stdin or stdout file path
 	for (size_t i = 0; i < numOfTokens; i++) {
-		if (strcmp(tokens[i], "<") == 0) {
+		if (isStdInRedirection(tokens[i])) {
 			stdInFile = tokens[i + 1];
+			stdInOperator = tokens[i];
 		} else if (strcmp(tokens[i], ">") == 0) {
 			stdOutFile = tokens[i + 1];
 		}
@@ -1182,10 +3042,12 @@ void singleProgram(char **tokens, size_t numOfTokens) {
 	const int *stdOutFd = NULL;
 	bool isStdInFdOpen = false;
 	bool isStdOutFdOpen = false;
+	traceStart = traceNow();
 
 	if (stdInFile != NULL) {
 		// get the file descriptor of the file specified by stdInFile
-		stdInFdValue = open(stdInFile, O_RDONLY);
+		// or of the pipe that the matches of the pattern are streamed into
+		stdInFdValue = openStdInRedirection(stdInOperator, stdInFile);
 
 		// if the file descriptor is -1, then print error and set exit status to 1 and return
 		if (stdInFdValue == -1) {
@@ -1204,7 +3066,9 @@ void singleProgram(char **tokens, size_t numOfTokens) {
 	// exist. Use mode 0640 (S_IRUSR|S_IWUSR|S_IRGRP) when creating
 	if (stdOutFile != NULL) {
 		// get the file descriptor of the file specified by stdOutFile
+		statsAdd(STATS_OPEN, 1);
 		stdOutFdValue = open(stdOutFile, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+		reportRedirect(stdOutFile, false);
 
 		// if the file descriptor is -1, then print error and set exit status to 1 and return
 		if (stdOutFdValue == -1) {
@@ -1221,12 +3085,63 @@ void singleProgram(char **tokens, size_t numOfTokens) {
 		stdOutFd = &stdOutFdValue;
 		isStdOutFdOpen = true;
 	}
+	traceProgramSpan("execute", "redirect", traceStart, -1, 0, stdInFdValue, stdOutFdValue, programPath);
+
+	// the assignments at the start of the command are added to the environment of the program
+	char **envp = programEnvironment(true);
+
+	// a large brace expression is generated while the runs start, one chunk of words per run
+	// if the program does not give the same result when split, then all the words are generated first
+	size_t lazyIndex = numOfArgs;
+	for (size_t i = 1; lazyBrace != NULL && i < numOfArgs; i++) {
+		if (strcmp(args[i], LAZY_BRACE_MARK) == 0) {
+			lazyIndex = i;
+			break;
+		}
+	}
+	bool splitSafe = isSplitSafeProgram(programPath) || getVariable("MYSH_SPLIT_ARGS") != NULL;
+	bool lazyRuns = lazyIndex < numOfArgs && splitSafe;
+	if (lazyIndex < numOfArgs && !splitSafe) {
+		args = braceMaterialize(args, &numOfArgs, lazyIndex, lazyBrace);
+		expandedTokensEnd = 0;
+	}
+
+	// run the program once for each chunk of the words of the brace expression
+	if (lazyRuns) {
+		chunkedProgram(programPath, args, envp, numOfArgs, lazyIndex, numOfArgs - lazyIndex - 1, lazyBrace, stdInFd, stdOutFd);
+	}
+
+	// if the brace expression could not be generated, then there is nothing to run
+	else if (args == NULL) {
+		exit_status = 1;
+	}
+
+	// if the arguments and the environment do not fit in ARG_MAX, then execv() would fail with E2BIG
+	// so run the program several times over chunks of the expanded arguments like xargs does
+	// this is only done for programs that give the same result when split, or when MYSH_SPLIT_ARGS is set
+	else if (argumentListSize(args, numOfArgs, envp) > argumentListLimit()) {
+		size_t numOfFixedArgs = countProgramArgs(tokens, expandedTokensStart);
+		size_t numOfTrailingArgs = numOfArgs - countProgramArgs(tokens, expandedTokensEnd);
+		if (expandedTokensEnd == 0) {
+			numOfFixedArgs = 1;
+			numOfTrailingArgs = 0;
+		}
+		if (splitSafe) {
+			chunkedProgram(programPath, args, envp, numOfArgs, numOfFixedArgs, numOfTrailingArgs, NULL, stdInFd, stdOutFd);
+		} else {
+			exit_status = 1;
+			argumentListTooLong(args[0]);
+		}
+	}
 
-	// call executeProgram() to execute the program
-	executeProgram(programPath, args, stdInFd, stdOutFd, true, NULL, NULL);
+	// otherwise call executeProgram() to execute the program
+	else {
+		executeProgram(programPath, args, envp, stdInFd, stdOutFd, true, NULL, NULL);
+	}
 
-	// free the memory allocated for args
+	// free the memory allocated for args and the environment
 	args = freeArrayOfStrings(args, numOfArgs);
+	releaseEnvironment(envp);
 
 	// close the file descriptors if they are open
 	if (isStdInFdOpen && close(stdInFdValue) == -1) {
@@ -1250,6 +3165,7 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 	// we can assume that there is only one pipe in the command
 
 	// tokenize the tokens into programs
+	long long traceStart = traceNow();
 	size_t numOfPrograms = 0;
 	char *combinedStr = strCombineTokens(tokens, numOfTokens, " ");
 	char **programs = strTokenize(combinedStr, "|", &numOfPrograms, "");
@@ -1267,6 +3183,7 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 
 	// now we can free the memory allocated for programs because we have the tokens for each program
 	programs = freeArrayOfStrings(programs, numOfPrograms);
+	traceSpan("execute", "splitPipeline", traceStart);
 
 	// check program syntax for each program
 	// if either program has invalid syntax, then print error and set exit status to 1 and return
@@ -1325,6 +3242,26 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 	size_t numOfProgram2Args = 0;
 	program2Args = getProgramArgs(program2Tokens, numOfProgram2Tokens, &numOfProgram2Args);
 
+	// the assignments at the start of the command only apply to the first program
+	char **envp1 = programEnvironment(true);
+	char **envp2 = programEnvironment(false);
+	bool tooLong1 = argumentListSize(program1Args, numOfProgram1Args, envp1) > argumentListLimit();
+	bool tooLong2 = argumentListSize(program2Args, numOfProgram2Args, envp2) > argumentListLimit();
+
+	// if the arguments of either program do not fit in ARG_MAX, then print error and set exit status to 1 and return
+	// the arguments of a piped program are not split into chunks
+	if (tooLong1 || tooLong2) {
+		exit_status = 1;
+		argumentListTooLong(tooLong1 ? program1Args[0] : program2Args[0]);
+		program1Tokens = freeArrayOfStrings(program1Tokens, numOfProgram1Tokens);
+		program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
+		program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
+		program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+		releaseEnvironment(envp1);
+		releaseEnvironment(envp2);
+		return;
+	}
+
 	// this is a piped program so the stdin for the first program is either the default stdin NULL or what is specified in file redirection
 	// the stdout for the first program is the write end of the pipe
 	// the stdin for the second program is the read end of the pipe
@@ -1349,12 +3286,13 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 	bool isPipeReadSet = false;
 
 	// iterate over program1Tokens and set stdin and stdout for program1
+	traceStart = traceNow();
 	for (size_t i = 0; i < numOfProgram1Tokens; i++) {
 		// if the token is "<", then the next token is the file to redirect stdin from
 		// so set stdInFd1 to the file descriptor of the file to redirect stdin from
 		// and set isStdInFdOpen1 to true
-		if (strcmp(program1Tokens[i], "<") == 0) {
-			stdInFdValue1 = open(program1Tokens[i + 1], O_RDONLY);
+		if (isStdInRedirection(program1Tokens[i])) {
+			stdInFdValue1 = openStdInRedirection(program1Tokens[i], program1Tokens[i + 1]);
 			if (stdInFdValue1 == -1) {
 				exit_status = 1;
 				perror("open");
@@ -1362,6 +3300,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 				program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 				program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
 				program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+				releaseEnvironment(envp1);
+				releaseEnvironment(envp2);
 				if (isStdOutFdOpen1 && close(stdOutFdValue1) == -1) {
 					perror("close");
 				}
@@ -1375,7 +3315,9 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 		// so set stdOutFd1 to the file descriptor of the file to redirect stdout to
 		// and set isStdOutFdOpen1 to true
 		if (strcmp(program1Tokens[i], ">") == 0) {
+			statsAdd(STATS_OPEN, 1);
 			stdOutFdValue1 = open(program1Tokens[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0640);
+			reportRedirect(program1Tokens[i + 1], false);
 			if (stdOutFdValue1 == -1) {
 				exit_status = 1;
 				perror("open");
@@ -1383,6 +3325,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 				program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 				program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
 				program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+				releaseEnvironment(envp1);
+				releaseEnvironment(envp2);
 				if (isStdInFdOpen1 && close(stdInFdValue1) == -1) {
 					perror("close");
 				}
@@ -1393,14 +3337,17 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 		}
 	}
 
+	traceProgramSpan("execute", "redirect", traceStart, -1, 0, stdInFdValue1, stdOutFdValue1, program1Path);
+	traceStart = traceNow();
+
 	// iterate over program2Tokens and set stdin and stdout for program2
 	// make sure to close program1's file descriptors if they are open before returning from error
 	for (size_t i = 0; i < numOfProgram2Tokens; i++) {
 		// if the token is "<", then the next token is the file to redirect stdin from
 		// so set stdInFd2 to the file descriptor of the file to redirect stdin from
 		// and set isStdInFdOpen2 to true
-		if (strcmp(program2Tokens[i], "<") == 0) {
-			stdInFdValue2 = open(program2Tokens[i + 1], O_RDONLY);
+		if (isStdInRedirection(program2Tokens[i])) {
+			stdInFdValue2 = openStdInRedirection(program2Tokens[i], program2Tokens[i + 1]);
 			if (stdInFdValue2 == -1) {
 				exit_status = 1;
 				perror("open");
@@ -1408,6 +3355,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 				program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 				program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
 				program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+				releaseEnvironment(envp1);
+				releaseEnvironment(envp2);
 				if (isStdOutFdOpen1 && close(stdOutFdValue1) == -1) {
 					perror("close");
 				}
@@ -1427,7 +3376,9 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 		// so set stdOutFd2 to the file descriptor of the file to redirect stdout to
 		// and set isStdOutFdOpen2 to true
 		if (strcmp(program2Tokens[i], ">") == 0) {
+			statsAdd(STATS_OPEN, 1);
 			stdOutFdValue2 = open(program2Tokens[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0640);
+			reportRedirect(program2Tokens[i + 1], false);
 			if (stdOutFdValue2 == -1) {
 				exit_status = 1;
 				perror("open");
@@ -1435,6 +3386,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 				program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 				program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
 				program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+				releaseEnvironment(envp1);
+				releaseEnvironment(envp2);
 				if (isStdInFdOpen1 && close(stdInFdValue1) == -1) {
 					perror("close");
 				}
@@ -1455,6 +3408,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 	// so create a pipe
 	// if pipe fails, then set exit_status to 1 and print the error message
 	// and free all the memory and close all the file descriptors before returning
+	traceProgramSpan("execute", "redirect", traceStart, -1, 1, stdInFdValue2, stdOutFdValue2, program2Path);
+	traceStart = traceNow();
 	int pipeFd[2];
 	if (pipe(pipeFd) == -1) {
 		exit_status = 1;
@@ -1463,6 +3418,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 		program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 		program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
 		program2Args = freeArrayOfStrings(program2Args, numOfProgram2Args);
+		releaseEnvironment(envp1);
+		releaseEnvironment(envp2);
 		if (isStdInFdOpen1 && close(stdInFdValue1) == -1) {
 			perror("close");
 		}
@@ -1478,6 +3435,8 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 		return;
 	}
 
+	traceProgramSpan("execute", "pipe", traceStart, -1, -1, pipeFd[0], pipeFd[1], NULL);
+
 	// if program1 is missing a stdout redirection, then set it to the write end of the pipe
 	if (isStdOutFdOpen1 == false) {
 		stdOutFd1 = &pipeFd[1];
@@ -1500,10 +3459,12 @@ void multiProgram(char **tokens, size_t numOfTokens) {
 
 	// now call executeProgram twice
 	// once for program1 and once for program2
-	executeProgram(program1Path, program1Args, stdInFd1, stdOutFd1, false, pipeFd, pipeSet1);
-	executeProgram(program2Path, program2Args, stdInFd2, stdOutFd2, true, pipeFd, pipeSet2);
+	executeProgram(program1Path, program1Args, envp1, stdInFd1, stdOutFd1, false, pipeFd, pipeSet1);
+	executeProgram(program2Path, program2Args, envp2, stdInFd2, stdOutFd2, true, pipeFd, pipeSet2);
 
 	// free all the memory and close all the file descriptors and pipes if they are open
+	releaseEnvironment(envp1);
+	releaseEnvironment(envp2);
 	program1Tokens = freeArrayOfStrings(program1Tokens, numOfProgram1Tokens);
 	program2Tokens = freeArrayOfStrings(program2Tokens, numOfProgram2Tokens);
 	program1Args = freeArrayOfStrings(program1Args, numOfProgram1Args);
@@ -1542,7 +3503,7 @@ char** getProgramArgs(char **tokens, size_t numOfTokens, size_t *numOfArgs) {
 		if (strcmp(tokens[i], "|") == 0) {
 			break;
 		}
-		if (strcmp(tokens[i], "<") == 0 || strcmp(tokens[i], ">") == 0) {
+		if (isRedirection(tokens[i])) {
 			// if the token is "<" or ">", then skip the next token
 			i++;
 			continue;
@@ -1551,8 +3512,11 @@ char** getProgramArgs(char **tokens, size_t numOfTokens, size_t *numOfArgs) {
 	}
 
 	// allocate memory for the argument list
+	// the allocations are counted as the args phase, and the command goes on executing after
+	allocPhaseSet(ALLOC_ARGS);
 	char **args = malloc(sizeof(char *) * (*numOfArgs + 1));
 	if (args == NULL) {
+		allocPhaseSet(ALLOC_EXEC);
 		exit_status = 1;
 		perror("malloc");
 		return NULL;
@@ -1570,13 +3534,14 @@ char** getProgramArgs(char **tokens, size_t numOfTokens, size_t *numOfArgs) {
 		if (strcmp(tokens[i], "|") == 0) {
 			break;
 		}
-		if (strcmp(tokens[i], "<") == 0 || strcmp(tokens[i], ">") == 0) {
+		if (isRedirection(tokens[i])) {
 			// if the token is "<" or ">", then skip the next token
 			i++;
 			continue;
 		}
 		args[j] = strdup(tokens[i]);
 		if (args[j] == NULL) {
+			allocPhaseSet(ALLOC_EXEC);
 			exit_status = 1;
 			perror("strdup");
 			args = freeArrayOfStrings(args, *numOfArgs);
@@ -1584,6 +3549,7 @@ char** getProgramArgs(char **tokens, size_t numOfTokens, size_t *numOfArgs) {
 		}
 		j++;
 	}
+	allocPhaseSet(ALLOC_EXEC);
 
 	// return the argument list
 	return args;
@@ -1600,7 +3566,7 @@ ssize_t checkCommandSyntax(char **tokens, size_t numOfTokens) {
 
 	// check syntax for both single and multiple programs
 	// if the first token is a pipe or redirection operator, print error and set exit status to 1 and return
-	if (strcmp(tokens[0], "|") == 0 || strcmp(tokens[0], "<") == 0 || strcmp(tokens[0], ">") == 0) {
+	if (isOperator(tokens[0])) {
 		exit_status = 1;
 		write(STDERR_FILENO, "command has invalid syntax\n", 27);
 		return -1;
@@ -1609,8 +3575,8 @@ ssize_t checkCommandSyntax(char **tokens, size_t numOfTokens) {
 	// check the rest of the tokens
 	for (size_t i = 1; i < numOfTokens; i++) {
 		// if the token following a pipe is a pipe or redirection operator, print error and set exit status to 1 and return
-		if (strcmp(tokens[i], "|") == 0 || strcmp(tokens[i], "<") == 0 || strcmp(tokens[i], ">") == 0) {
-			if (i + 1 >= numOfTokens || strcmp(tokens[i + 1], "|") == 0 || strcmp(tokens[i + 1], "<") == 0 || strcmp(tokens[i + 1], ">") == 0) {
+		if (isOperator(tokens[i])) {
+			if (i + 1 >= numOfTokens || isOperator(tokens[i + 1])) {
 				exit_status = 1;
 				write(STDERR_FILENO, "command has invalid syntax\n", 27);
 				return -1;
@@ -1651,13 +3617,13 @@ ssize_t checkProgramSyntax(char **tokens, size_t numOfTokens) {
 
 	// iterate over the tokens
 	for (size_t i = 0; i < numOfTokens; i++) {
-		if (strcmp(tokens[i], "<") == 0) {
+		if (isStdInRedirection(tokens[i])) {
 			if (stdInFile != NULL) {
 				exit_status = 1;
 				write(STDERR_FILENO, "command can not have multiple stdin redirections\n", 49);
 				return -1;
 			}
-			if (i + 1 >= numOfTokens || strcmp(tokens[i + 1], "<") == 0 || strcmp(tokens[i + 1], ">") == 0) {
+			if (i + 1 >= numOfTokens || isRedirection(tokens[i + 1])) {
 				exit_status = 1;
 				write(STDERR_FILENO, "command is missing stdin redirection file path\n", 47);
 				return -1;
@@ -1669,7 +3635,7 @@ ssize_t checkProgramSyntax(char **tokens, size_t numOfTokens) {
 				write(STDERR_FILENO, "command can not have multiple stdout redirections\n", 50);
 				return -1;
 			}
-			if (i + 1 >= numOfTokens || strcmp(tokens[i + 1], "<") == 0 || strcmp(tokens[i + 1], ">") == 0) {
+			if (i + 1 >= numOfTokens || isRedirection(tokens[i + 1])) {
 				exit_status = 1;
 				write(STDERR_FILENO, "command is missing stdout redirection file path\n", 48);
 				return -1;
@@ -1693,12 +3659,13 @@ char** getFilenamesExt(const char *filePath, size_t *pnumOfFilenames) {
 	// initialize pnumOfFilenames to 0
 	*pnumOfFilenames = 0;
 
-	// if the filePath does not contain a "*" then return NULL
-	if (strchr(filePath, '*') == NULL) {
+	// if the filePath does not contain a "*", "?" or "[" then return NULL
+	if (isWildcardSegment(filePath) == false) {
 		return NULL;
 	}
 	
 	// the filePath is like "/dir1/dir2/dir3/a*t.txt" or "/dir1/a*" or "/dir1/*a" or "/dir1/*" or "/dir1/a*t" or "*a" or "*"
+	// segments may also use "?" for any single character and "[a-z]" or "[!a-z]" for a set of characters
 	// if it is just the filename without "/", then search the current directory
 	// first check whether the path is a directory or a file. If it is a directory, then return NULL
 	// if the last character is a "/" that means the path is a directory so return NULL
@@ -1708,107 +3675,5976 @@ char** getFilenamesExt(const char *filePath, size_t *pnumOfFilenames) {
 	}
 
 	// at this point you know that the filePath points to a file, not a directory (theoretically)
-	// use glob() to get the list of filenames that match the pattern in filePath
-	// do not include hidden files that start with a "."
-	// do not include directories or anything that is not a file in the list of filenames
-	// do not sort the list of filenames
-	// do not use any escape characters
+	// use wildcardWalk() to get the list of filenames that match the pattern in filePath
+	// the walker does not include hidden files that start with a "."
+	// the walker does not include directories or anything that is not a regular file
+	// "**" segments match zero or more directories, so "**/*.log" finds every .log file below the working directory
+	// the list of filenames is sorted so that the expansion does not depend on the order of directory entries,
+	// unless MYSH_GLOB_NOSORT is set because the order does not matter to the caller
 	// if no matches are found or an error occurs, then return NULL
-	// do not expand the pattern with tilda or anything else, keep it as it is
 	// otherwise return the list of filenames
-	glob_t globbuf;
-	int globStatus = glob(filePath, GLOB_MARK | GLOB_NOSORT | GLOB_NOESCAPE, NULL, &globbuf);
+	bool sorted = getVariable("MYSH_GLOB_NOSORT") == NULL;
+	size_t numOfFilenames = 0;
+	char **filenames = wildcardWalk(filePath, &numOfFilenames, sorted);
+	statsAdd(filenames == NULL || numOfFilenames == 0 ? STATS_GLOBS_UNMATCHED : STATS_GLOBS_MATCHED, 1);
 
-	// if an error occurs, then return NULL
-	if (globStatus != 0) {
+	// if no matches are found, then return NULL
+	if (filenames == NULL || numOfFilenames == 0) {
 		return NULL;
 	}
 
-	// if no matches are found, then return NULL
-	if (globbuf.gl_pathc == 0) {
-		globfree(&globbuf);
+	// set the number of filenames
+	*pnumOfFilenames = numOfFilenames;
+
+	// return the list of filenames
+	return filenames;
+}
+
+// function that returns a list of regular files matching a wildcard pattern
+// every directory that has to be read becomes a task on a pool of work-stealing threads,
+// so the latency of reading many directories (for example on network filesystems) overlaps
+// if sorted is false, then the matches are returned in the order the threads found them
+// returns NULL if nothing matches or an error occurs
+char** wildcardWalk(const char *pattern, size_t *numOfPaths, bool sorted) {
+	// if pattern is NULL or numOfPaths is NULL, then return NULL
+	if (pattern == NULL || numOfPaths == NULL) {
 		return NULL;
 	}
 
-	// copy the list of filenames to a new array of strings
-	// use strDupArrayOfStrings() or strdup() to duplicate the filenames
-	size_t numOfFilenames = globbuf.gl_pathc;
-	char **filenames = strDupArrayOfStrings(globbuf.gl_pathv, numOfFilenames);
-
-	// free the globbuf
-	globfree(&globbuf);
-
-	// if you get here, then you have a list of filenames that match the pattern in filePath
-	// just make sure that none of the filenames are directories or hidden files
-	// if you find a directory or a hidden file, then remove it from the list
-	// if you remove a filename, then decrement the numOfFilenames
-	// if you remove all the filenames, then return NULL
-	// first iterate over filenames and count the number of directories and hidden files
-	size_t numOfWrongFiles = 0;
-
-	// use isRegularFile() to check whether a filename is a regular file or not
-	// make sure to extract last part of the filename before checking whether it is a regular file or not and "."
-	for (size_t i = 0; i < numOfFilenames; i++) {
-		// first extract the last part of the filename after checking whether filename contains a "/"
-		// use strdup and strchr and strrchr
-		char *lastPart = NULL;
-		if (strchr(filenames[i], '/') == NULL || filenames[i][strlen(filenames[i]) - 1] == '/') {
-			lastPart = strdup(filenames[i]);
-		} else {
-			lastPart = strdup(strrchr(filenames[i], '/') + 1);
+	// initialize numOfPaths to 0
+	*numOfPaths = 0;
+
+	// set up the walker and read every directory the pattern reaches
+	walker w;
+	if (walkerInit(&w, pattern, -1, '\0') == false) {
+		return NULL;
+	}
+	walkerRun(&w);
+
+	// count the matches found by all the workers
+	size_t total = 0;
+	for (size_t i = 0; i < w.numOfWorkers; i++) {
+		total += w.results[i].numOfPaths;
+	}
+
+	// move the matches of all the workers into a single array
+	char **paths = NULL;
+	if (total > 0 && !__atomic_load_n(&w.failed, __ATOMIC_RELAXED)) {
+		paths = malloc(sizeof(char *) * total);
+		if (paths == NULL) {
+			perror("malloc");
+			exit_status = 1;
+			__atomic_store_n(&w.failed, true, __ATOMIC_RELAXED);
 		}
-		
-		// now check isRegularFile() passing in the entire path and "." is the first character of the last part of the filename
-		if (isRegularFile(filenames[i]) == false || lastPart[0] == '.') {
-			numOfWrongFiles++;
+	}
+	size_t j = 0;
+	for (size_t i = 0; i < w.numOfWorkers; i++) {
+		for (size_t k = 0; k < w.results[i].numOfPaths; k++) {
+			if (paths != NULL) {
+				paths[j] = w.results[i].paths[k];
+				j++;
+			} else {
+				w.results[i].paths[k] = Free(w.results[i].paths[k]);
+			}
 		}
+		w.results[i].paths = Free(w.results[i].paths);
+		w.results[i].numOfPaths = 0;
+	}
 
-		// free the last part of the filename
-		lastPart = Free(lastPart);
+	// free the state of the walker
+	walkerFree(&w);
+
+	// if nothing matched, then return NULL
+	if (paths == NULL) {
+		return NULL;
 	}
 
-	// calculate the final number of filenames
-	size_t finalNumOfFilenames = numOfFilenames - numOfWrongFiles;
+	// the workers finish in any order, so sort the matches to make the expansion deterministic
+	if (sorted) {
+		sortArrayOfStrings(paths, total);
+	}
 
-	// if the final number of filenames is 0, then return NULL
-	if (finalNumOfFilenames == 0) {
-		filenames = freeArrayOfStrings(filenames, numOfFilenames);
+	// set numOfPaths and return the matches
+	*numOfPaths = total;
+	return paths;
+}
+
+// function that runs the walker of a feeder of "<*", which writes the regular files matching the pattern to the pipe while the walk is running
+// every match is followed by the delimiter, so the reader sees the first matches before the walk finishes
+// matches are not kept in memory, so they are written in the order the threads find them
+// the walker was set up by the shell thread, so this thread only reads the directories and never the shell variables
+void* streamFeederThread(void *arg) {
+	streamFeeder *f = arg;
+	traceThreadName("feeder");
+	walkerRun(&f->w);
+
+	// write the matches that are still buffered, and close the pipe so that the program sees end of file
+	pthread_mutex_lock(&f->w.streamLock);
+	walkFlush(&f->w);
+	pthread_mutex_unlock(&f->w.streamLock);
+	close(f->w.streamFd);
+	traceEvent *e = traceRecord("child", STREAM_REDIRECT, f->start);
+	if (e != NULL) {
+		e->stdOutFd = f->w.streamFd;
+	}
+	return NULL;
+}
+
+// function that waits for the feeders of "<*" that were started after until, and frees them
+// the caller has closed its read ends by now, so a feeder whose program stopped reading gets EPIPE and stops
+void joinStreamFeeders(streamFeeder *until) {
+	while (streamFeeders != NULL && streamFeeders != until) {
+		streamFeeder *f = streamFeeders;
+		streamFeeders = f->next;
+		pthread_join(f->thread, NULL);
+		walkerFree(&f->w);
+		f = Free(f);
+	}
+}
+
+// function that sets up the shared state of a walker for a wildcard pattern
+// if streamFd is not -1, then matches are written to streamFd followed by delimiter instead of being collected
+// returns false if the pattern has no segments or memory could not be allocated
+bool walkerInit(walker *w, const char *pattern, int streamFd, char delimiter) {
+	// split the pattern into its path segments
+	// so "/dir1/*/**/a*.log" becomes ["/", "dir1", "*", "**", "a*.log"]
+	size_t numOfSegments = 0;
+	char **segments = splitPatternSegments(pattern, &numOfSegments);
+	if (segments == NULL) {
+		return false;
+	}
+
+	// compile every segment once, so each directory entry is matched without parsing the pattern again
+	segmentMatcher *matchers = calloc(numOfSegments, sizeof(segmentMatcher));
+	if (matchers == NULL) {
+		perror("calloc");
+		exit_status = 1;
+		segments = freeArrayOfStrings(segments, numOfSegments);
+		return false;
+	}
+	for (size_t i = 0; i < numOfSegments; i++) {
+		if (isWildcardSegment(segments[i]) && compileSegment(&matchers[i], segments[i]) == false) {
+			for (size_t j = 0; j < i; j++) {
+				freeSegmentMatcher(&matchers[j]);
+			}
+			matchers = Free(matchers);
+			segments = freeArrayOfStrings(segments, numOfSegments);
+			return false;
+		}
+	}
+
+	// use more than one thread only if more than one directory could be read,
+	// which is the case when a wildcard appears before the last segment
+	bool parallel = false;
+	for (size_t i = 0; i + 1 < numOfSegments; i++) {
+		if (isWildcardSegment(segments[i])) {
+			parallel = true;
+			break;
+		}
+	}
+
+	// only a pattern with more than one "**" segment can reach the same directory at the same segment twice
+	size_t numOfGlobstars = 0;
+	for (size_t i = 0; i < numOfSegments; i++) {
+		if (strcmp(segments[i], "**") == 0) {
+			numOfGlobstars++;
+		}
+	}
+
+	// initialize the shared state of the walker
+	w->segments = segments;
+	w->matchers = matchers;
+	w->numOfSegments = numOfSegments;
+	w->numOfWorkers = parallel ? walkThreadCount() : 1;
+	w->queuedTasks = 0;
+	w->pendingTasks = 0;
+	w->trackVisited = numOfGlobstars > 1;
+	w->visited = (walkVisited) {NULL, 0, 0};
+	w->failed = false;
+	w->streamFd = streamFd;
+	w->delimiter = delimiter;
+	w->streamLength = 0;
+	w->numOfStreamed = 0;
+	w->deques = calloc(w->numOfWorkers, sizeof(walkDeque));
+	w->results = calloc(w->numOfWorkers, sizeof(walkResults));
+	w->rings = calloc(w->numOfWorkers, sizeof(statRing));
+	if (w->deques == NULL || w->results == NULL || w->rings == NULL) {
+		perror("calloc");
+		exit_status = 1;
+		w->deques = Free(w->deques);
+		w->results = Free(w->results);
+		w->rings = Free(w->rings);
+		for (size_t i = 0; i < w->numOfSegments; i++) {
+			freeSegmentMatcher(&w->matchers[i]);
+		}
+		w->matchers = Free(w->matchers);
+		w->segments = freeArrayOfStrings(w->segments, w->numOfSegments);
+		return false;
+	}
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_mutex_init(&w->streamLock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	for (size_t i = 0; i < w->numOfWorkers; i++) {
+		pthread_mutex_init(&w->deques[i].lock, NULL);
+		w->rings[i].fd = -1;
+		w->rings[i].unavailable = getVariable("MYSH_GLOB_SYNC_STAT") != NULL;
+	}
+	return true;
+}
+
+// function that reads every directory the pattern of a walker reaches and waits until all of them are read
+void walkerRun(walker *w) {
+	// the first task reads the directory the pattern starts in
+	// an absolute pattern starts in "/" which is kept as its own segment
+	size_t firstSegment = 0;
+	char *firstDir = NULL;
+	if (strcmp(w->segments[0], "/") == 0) {
+		firstDir = strdup("/");
+		firstSegment = 1;
+	} else {
+		firstDir = strdup("");
+	}
+	if (firstDir == NULL || walkPush(w, 0, firstDir, firstSegment) == false) {
+		firstDir = Free(firstDir);
+		__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+		return;
+	}
+
+	// start the helper threads, the calling thread works as worker 0
+	pthread_t threads[MAX_WALK_THREADS];
+	walkWorker workers[MAX_WALK_THREADS];
+	size_t numOfThreads = 0;
+	for (size_t i = 1; i < w->numOfWorkers; i++) {
+		workers[i].w = w;
+		workers[i].index = i;
+		if (pthread_create(&threads[numOfThreads], NULL, walkThread, &workers[i]) != 0) {
+			break;
+		}
+		numOfThreads++;
+	}
+	workers[0].w = w;
+	workers[0].index = 0;
+	walkThread(&workers[0]);
+	for (size_t i = 0; i < numOfThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
+
+// function that frees the shared state of a walker
+// every task has finished at this point, so the deques only hold their arrays
+void walkerFree(walker *w) {
+	for (size_t i = 0; i < w->numOfWorkers; i++) {
+		pthread_mutex_destroy(&w->deques[i].lock);
+		statRingFree(&w->rings[i]);
+		w->deques[i].tasks = Free(w->deques[i].tasks);
+		w->results[i].paths = freeArrayOfStrings(w->results[i].paths, w->results[i].numOfPaths);
+	}
+	for (size_t i = 0; i < w->visited.capacity; i++) {
+		w->visited.slots[i].dirPath = Free(w->visited.slots[i].dirPath);
+	}
+	w->visited.slots = Free(w->visited.slots);
+	pthread_mutex_destroy(&w->lock);
+	pthread_mutex_destroy(&w->streamLock);
+	pthread_cond_destroy(&w->cond);
+	w->deques = Free(w->deques);
+	w->results = Free(w->results);
+	w->rings = Free(w->rings);
+	for (size_t i = 0; i < w->numOfSegments; i++) {
+		freeSegmentMatcher(&w->matchers[i]);
+	}
+	w->matchers = Free(w->matchers);
+	w->segments = freeArrayOfStrings(w->segments, w->numOfSegments);
+}
+
+// function that splits a wildcard pattern into its path segments
+// a leading "/" becomes its own segment, empty segments are dropped, and consecutive "**" segments are merged
+// a trailing "**" is followed by an implicit "*" so that it matches the files in every directory below
+char** splitPatternSegments(const char *pattern, size_t *numOfSegments) {
+	// if pattern is NULL or numOfSegments is NULL, then return NULL
+	if (pattern == NULL || numOfSegments == NULL) {
+		return NULL;
+	}
+
+	// tokenize the pattern with "/" as the delimiter
+	size_t numOfTokens = 0;
+	char **tokens = strTokenize(pattern, "/", &numOfTokens, "");
+	if (tokens == NULL) {
 		return NULL;
 	}
 
-	// allocate memory for the final list of filenames
-	char **finalFilenames = malloc(finalNumOfFilenames * sizeof(char *));
+	// allocate room for the root segment, every token, and the implicit "*"
+	char **segments = malloc(sizeof(char *) * (numOfTokens + 2));
+	if (segments == NULL) {
+		perror("malloc");
+		exit_status = 1;
+		tokens = freeStrTokens(tokens, numOfTokens);
+		return NULL;
+	}
 
-	// iterate over the filenames and copy the filenames that are not directories or hidden files to the final list of filenames
-	// a filename is of the form "/dir1/dir2/dir3/a.txt", so just copy the last part of the filename because we just want the filename
-	// extract the last part of the filename before isRegularFile() and "." is checked
-	size_t j = 0;
-	for (size_t i = 0; i < numOfFilenames; i++) {
-		// first extract the last part of the filename after checking whether filename contains a "/"
-		// use strdup and strchr and strrchr
-		char *lastPart = NULL;
-		if (strchr(filenames[i], '/') == NULL || filenames[i][strlen(filenames[i]) - 1] == '/') {
-			lastPart = strdup(filenames[i]);
+	// copy the segments, merging consecutive "**" segments
+	*numOfSegments = 0;
+	if (pattern[0] == '/') {
+		segments[(*numOfSegments)++] = strdup("/");
+	}
+	for (size_t i = 0; i < numOfTokens; i++) {
+		if (strcmp(tokens[i], "**") == 0 && *numOfSegments > 0 && strcmp(segments[*numOfSegments - 1], "**") == 0) {
+			tokens[i] = Free(tokens[i]);
+			continue;
+		}
+		segments[(*numOfSegments)++] = tokens[i];
+	}
+	tokens = Free(tokens);
+	if (strcmp(segments[*numOfSegments - 1], "**") == 0) {
+		segments[(*numOfSegments)++] = strdup("*");
+	}
+
+	// return the segments
+	return segments;
+}
+
+// function that returns whether a path segment has to be matched against directory entries
+bool isWildcardSegment(const char *segment) {
+	return segment != NULL && strpbrk(segment, "*?[") != NULL;
+}
+
+// function that returns the number of threads used by the wildcard walker
+// the number of online processors is used unless MYSH_GLOB_THREADS is set
+size_t walkThreadCount() {
+	// read the number of threads from the shell variable if it is set
+	const char *env = getVariable("MYSH_GLOB_THREADS");
+	long count = 0;
+	if (env != NULL && strlen(env) > 0) {
+		count = strtol(env, NULL, 10);
+	} else {
+		count = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	// clamp the number of threads between 1 and MAX_WALK_THREADS
+	if (count < 1) {
+		return 1;
+	}
+	if (count > MAX_WALK_THREADS) {
+		return MAX_WALK_THREADS;
+	}
+	return (size_t) count;
+}
+
+// function that pushes a task onto the deque of a walker thread
+// the task takes ownership of dirPath, and a task that was already pushed is freed instead. returns false if memory could not be allocated
+bool walkPush(walker *w, size_t index, char *dirPath, size_t segmentIndex) {
+	walkDeque *deque = &w->deques[index];
+
+	// count the task before it is published, so a thread that takes and finishes it right away never sees the counters drop below it
+	pthread_mutex_lock(&w->lock);
+	bool isNew = true;
+	if (w->trackVisited && walkVisit(w, dirPath, segmentIndex, &isNew) == false) {
+		pthread_mutex_unlock(&w->lock);
+		perror("malloc");
+		__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+		return false;
+	}
+	if (!isNew) {
+		pthread_mutex_unlock(&w->lock);
+		dirPath = Free(dirPath);
+		return true;
+	}
+	w->queuedTasks++;
+	w->pendingTasks++;
+	pthread_mutex_unlock(&w->lock);
+
+	// grow the deque if it is full, moving the remaining tasks to the front
+	pthread_mutex_lock(&deque->lock);
+	if (deque->tail == deque->capacity) {
+		size_t numOfTasks = deque->tail - deque->head;
+		size_t capacity = numOfTasks * 2 + 16;
+		walkTask *tasks = malloc(sizeof(walkTask) * capacity);
+		if (tasks == NULL) {
+			pthread_mutex_unlock(&deque->lock);
+			perror("malloc");
+			__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			pthread_mutex_lock(&w->lock);
+			w->queuedTasks--;
+			w->pendingTasks--;
+			if (w->pendingTasks == 0) {
+				pthread_cond_broadcast(&w->cond);
+			}
+			pthread_mutex_unlock(&w->lock);
+			return false;
+		}
+		if (numOfTasks > 0) {
+			memcpy(tasks, deque->tasks + deque->head, sizeof(walkTask) * numOfTasks);
+		}
+		deque->tasks = Free(deque->tasks);
+		deque->tasks = tasks;
+		deque->head = 0;
+		deque->tail = numOfTasks;
+		deque->capacity = capacity;
+	}
+	deque->tasks[deque->tail].dirPath = dirPath;
+	deque->tasks[deque->tail].segmentIndex = segmentIndex;
+	deque->tail++;
+	pthread_mutex_unlock(&deque->lock);
+
+	// wake up an idle thread because there is new work
+	pthread_mutex_lock(&w->lock);
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	return true;
+}
+
+// function that records that a walker reached dirPath at segmentIndex, and sets isNew to whether it had not been reached before
+// the caller holds the lock of the walker. returns false if memory could not be allocated
+bool walkVisit(walker *w, const char *dirPath, size_t segmentIndex, bool *isNew) {
+	walkVisited *visited = &w->visited;
+	size_t length = strlen(dirPath);
+	size_t hash = strHash(dirPath, length) ^ segmentIndex;
+
+	// grow the table before it is half full, moving every task to its slot in the larger table
+	if (2 * (visited->count + 1) > visited->capacity) {
+		size_t capacity = visited->capacity == 0 ? 256 : visited->capacity * 2;
+		walkTask *slots = calloc(capacity, sizeof(walkTask));
+		if (slots == NULL) {
+			return false;
+		}
+		for (size_t i = 0; i < visited->capacity; i++) {
+			walkTask *slot = &visited->slots[i];
+			if (slot->dirPath == NULL) {
+				continue;
+			}
+			size_t j = (strHash(slot->dirPath, strlen(slot->dirPath)) ^ slot->segmentIndex) & (capacity - 1);
+			while (slots[j].dirPath != NULL) {
+				j = (j + 1) & (capacity - 1);
+			}
+			slots[j] = *slot;
+		}
+		visited->slots = Free(visited->slots);
+		visited->slots = slots;
+		visited->capacity = capacity;
+	}
+
+	// probe from the slot of the hash until the task or an empty slot is found
+	size_t mask = visited->capacity - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		walkTask *slot = &visited->slots[i];
+		if (slot->dirPath == NULL) {
+			slot->dirPath = strndup(dirPath, length);
+			if (slot->dirPath == NULL) {
+				return false;
+			}
+			slot->segmentIndex = segmentIndex;
+			visited->count++;
+			*isNew = true;
+			return true;
+		}
+		if (slot->segmentIndex == segmentIndex && strcmp(slot->dirPath, dirPath) == 0) {
+			*isNew = false;
+			return true;
+		}
+	}
+}
+
+// function that takes a task for a walker thread
+// the thread first pops the newest task of its own deque, then steals the oldest task of another deque
+// returns false if every deque is empty
+bool walkPop(walker *w, size_t index, walkTask *task) {
+	for (size_t i = 0; i < w->numOfWorkers; i++) {
+		size_t victim = (index + i) % w->numOfWorkers;
+		walkDeque *deque = &w->deques[victim];
+		bool found = false;
+		pthread_mutex_lock(&deque->lock);
+		if (deque->tail > deque->head) {
+			if (victim == index) {
+				deque->tail--;
+				*task = deque->tasks[deque->tail];
+			} else {
+				*task = deque->tasks[deque->head];
+				deque->head++;
+			}
+			found = true;
+		}
+		pthread_mutex_unlock(&deque->lock);
+		if (found) {
+			pthread_mutex_lock(&w->lock);
+			w->queuedTasks--;
+			pthread_mutex_unlock(&w->lock);
+			return true;
+		}
+	}
+	return false;
+}
+
+// function that runs the task loop of a walker thread until every task is finished
+void* walkThread(void *arg) {
+	walkWorker *worker = arg;
+	walker *w = worker->w;
+	walkTask task;
+	allocPhaseSet(ALLOC_WILDCARD);
+	while (true) {
+		// run tasks while there are any
+		if (walkPop(w, worker->index, &task)) {
+			walkDirectory(w, worker->index, task.dirPath, task.segmentIndex);
+			pthread_mutex_lock(&w->lock);
+			w->pendingTasks--;
+			if (w->pendingTasks == 0) {
+				pthread_cond_broadcast(&w->cond);
+			}
+			pthread_mutex_unlock(&w->lock);
+			continue;
+		}
+
+		// otherwise wait until a task is queued or every task is finished
+		pthread_mutex_lock(&w->lock);
+		while (w->queuedTasks == 0 && w->pendingTasks > 0) {
+			pthread_cond_wait(&w->cond, &w->lock);
+		}
+		bool finished = w->pendingTasks == 0;
+		pthread_mutex_unlock(&w->lock);
+		if (finished) {
+			return NULL;
+		}
+	}
+}
+
+// function that matches the entries of dirPath against the pattern segment at segmentIndex
+// matching directories become new tasks and matching regular files become results. takes ownership of dirPath
+void walkDirectory(walker *w, size_t index, char *dirPath, size_t segmentIndex) {
+	// append the segments without wildcards directly to the directory path
+	// if the last segment has no wildcard, then it is a single candidate file
+	while (segmentIndex < w->numOfSegments && !isWildcardSegment(w->segments[segmentIndex])) {
+		const char *segment = w->segments[segmentIndex];
+		bool last = segmentIndex + 1 == w->numOfSegments;
+		char *path = walkJoin(dirPath, segment, !last);
+		dirPath = Free(dirPath);
+		if (path == NULL) {
+			__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			return;
+		}
+		if (last) {
+			if (segment[0] != '.' && isRegularFile(path)) {
+				walkAddResult(w, index, path);
+			} else {
+				path = Free(path);
+			}
+			return;
+		}
+		dirPath = path;
+		segmentIndex++;
+	}
+
+	// if there are no segments left, then there is nothing to match
+	if (segmentIndex >= w->numOfSegments) {
+		dirPath = Free(dirPath);
+		return;
+	}
+
+	const char *segment = w->segments[segmentIndex];
+	bool last = segmentIndex + 1 == w->numOfSegments;
+	bool globstar = strcmp(segment, "**") == 0;
+
+	// "**" matches zero directories, so the next segment is also matched inside dirPath
+	if (globstar) {
+		char *copy = strdup(dirPath);
+		if (copy == NULL || walkPush(w, index, copy, segmentIndex + 1) == false) {
+			copy = Free(copy);
+			__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+		}
+	}
+
+	// open the directory for reading filenames
+	statsAdd(STATS_OPEN, 1);
+	DIR *dir = opendir(strlen(dirPath) == 0 ? "." : dirPath);
+	if (dir == NULL) {
+		dirPath = Free(dirPath);
+		return;
+	}
+
+	// the entries whose type readdir() does not know are collected and looked up together after the loop
+	statCandidate *candidates = NULL;
+	size_t numOfCandidates = 0;
+	size_t candidatesCapacity = 0;
+
+	struct dirent *entry = NULL;
+	while ((entry = readdir(dir)) != NULL && !__atomic_load_n(&w->failed, __ATOMIC_RELAXED)) {
+		const char *name = entry->d_name;
+
+		// skip "." and ".." and names that begin with "."
+		// a segment that itself begins with "." may match hidden directories, but never hidden files
+		if (name[0] == '.') {
+			if (last || globstar || segment[0] != '.' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+				continue;
+			}
+		}
+
+		// an entry of unknown type in a "**" segment or a possible file in the last segment needs a statx
+		bool unknownDir = globstar && entry->d_type == DT_UNKNOWN;
+		bool unknownFile = !globstar && last && (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN);
+		if ((unknownDir || unknownFile) && (globstar || segmentMatch(&w->matchers[segmentIndex], name, strlen(name)))) {
+			if (numOfCandidates == candidatesCapacity) {
+				size_t capacity = candidatesCapacity == 0 ? 16 : candidatesCapacity * 2;
+				statCandidate *grown = realloc(candidates, sizeof(statCandidate) * capacity);
+				if (grown == NULL) {
+					__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+					break;
+				}
+				candidates = grown;
+				candidatesCapacity = capacity;
+			}
+			char *path = walkJoin(dirPath, name, false);
+			if (path == NULL) {
+				__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+				break;
+			}
+			candidates[numOfCandidates].path = path;
+			candidates[numOfCandidates].nameOffset = strlen(dirPath);
+			candidates[numOfCandidates].follow = unknownFile;
+			candidates[numOfCandidates].found = false;
+			numOfCandidates++;
+			continue;
+		}
+
+		// "**" descends into every subdirectory, without following symbolic links
+		if (globstar) {
+			if (entry->d_type == DT_DIR) {
+				char *path = walkJoin(dirPath, name, true);
+				if (path == NULL || walkPush(w, index, path, segmentIndex) == false) {
+					path = Free(path);
+					__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+				}
+			}
+			continue;
+		}
+
+		// skip the names that do not match the segment
+		if (segmentMatch(&w->matchers[segmentIndex], name, strlen(name)) == false) {
+			continue;
+		}
+
+		// a match in the last segment is a result if it is a regular file
+		// d_type saves a stat() call, symbolic links and unknown types were collected as candidates above
+		if (last) {
+			if (entry->d_type != DT_REG) {
+				continue;
+			}
+			char *path = walkJoin(dirPath, name, false);
+			if (path == NULL) {
+				__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+				break;
+			}
+			walkAddResult(w, index, path);
+			continue;
+		}
+
+		// a match in any other segment is a directory to read next
+		if (entry->d_type == DT_DIR || entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+			char *path = walkJoin(dirPath, name, true);
+			if (path == NULL || walkPush(w, index, path, segmentIndex + 1) == false) {
+				path = Free(path);
+				__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	// look up the types of the candidates in one batch, then add the regular files and read the directories
+	if (numOfCandidates > 0 && !__atomic_load_n(&w->failed, __ATOMIC_RELAXED)) {
+		walkStatCandidates(w, index, dirfd(dir), candidates, numOfCandidates);
+	}
+	for (size_t i = 0; i < numOfCandidates; i++) {
+		char *path = candidates[i].path;
+		if (__atomic_load_n(&w->failed, __ATOMIC_RELAXED) || candidates[i].found == false) {
+			path = Free(path);
+		} else if (candidates[i].follow) {
+			if (S_ISREG(candidates[i].mode)) {
+				walkAddResult(w, index, path);
+			} else {
+				path = Free(path);
+			}
+		} else if (S_ISDIR(candidates[i].mode)) {
+			char *dirWithSlash = walkJoin(path, "", true);
+			path = Free(path);
+			if (dirWithSlash == NULL || walkPush(w, index, dirWithSlash, segmentIndex) == false) {
+				dirWithSlash = Free(dirWithSlash);
+				__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			}
 		} else {
-			lastPart = strdup(strrchr(filenames[i], '/') + 1);
+			path = Free(path);
 		}
-		
-		// now check isRegularFile() passing in the entire path and "." is not the first character of the last part of the filename
-		if (isRegularFile(filenames[i]) == true && lastPart[0] != '.') {
-			finalFilenames[j] = strdup(filenames[i]);
-			j++;
+	}
+	candidates = Free(candidates);
+
+	// close the directory and free the directory path
+	closedir(dir);
+	dirPath = Free(dirPath);
+
+	// a streaming walker writes the matches of every directory right away, so the reader does not wait for the whole walk
+	if (w->streamFd != -1) {
+		pthread_mutex_lock(&w->streamLock);
+		walkFlush(w);
+		pthread_mutex_unlock(&w->streamLock);
+	}
+}
+
+// function that writes the output buffer of a streaming walker. the caller holds streamLock
+// if the reader closed its end, then the walk is stopped
+void walkFlush(walker *w) {
+	if (w->streamLength > 0 && !__atomic_load_n(&w->failed, __ATOMIC_RELAXED) && writeAll(w->streamFd, w->streamBuffer, w->streamLength) == -1) {
+		__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+	}
+	w->streamLength = 0;
+}
+
+// function that writes a whole buffer to a file descriptor, retrying after partial writes and interrupts
+// returns 0 on success and -1 on error
+ssize_t writeAll(int fd, const char *buffer, size_t length) {
+	size_t written = 0;
+	while (written < length) {
+		ssize_t result = write(fd, buffer + written, length - written);
+		if (result == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		written += result;
+	}
+	return 0;
+}
+
+// function that adds a matching path to the results of a walker thread. takes ownership of path
+// a streaming walker copies the path into its output buffer instead, which is written once it is full
+bool walkAddResult(walker *w, size_t index, char *path) {
+	if (w->streamFd != -1) {
+		size_t pathLen = strlen(path);
+		pthread_mutex_lock(&w->streamLock);
+		if (w->streamLength + pathLen + 1 > STREAM_BUFFER_SIZE) {
+			walkFlush(w);
+		}
+		if (pathLen + 1 > STREAM_BUFFER_SIZE) {
+			// a path longer than the buffer is written on its own
+			if (writeAll(w->streamFd, path, pathLen) == -1 || writeAll(w->streamFd, &w->delimiter, 1) == -1) {
+				__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			}
+		} else {
+			memcpy(w->streamBuffer + w->streamLength, path, pathLen);
+			w->streamBuffer[w->streamLength + pathLen] = w->delimiter;
+			w->streamLength += pathLen + 1;
+		}
+		w->numOfStreamed++;
+		pthread_mutex_unlock(&w->streamLock);
+		path = Free(path);
+		return !__atomic_load_n(&w->failed, __ATOMIC_RELAXED);
+	}
+
+	walkResults *results = &w->results[index];
+
+	// grow the array of results if it is full
+	if (results->numOfPaths == results->capacity) {
+		size_t capacity = results->capacity * 2 + 16;
+		char **paths = realloc(results->paths, sizeof(char *) * capacity);
+		if (paths == NULL) {
+			perror("realloc");
+			path = Free(path);
+			__atomic_store_n(&w->failed, true, __ATOMIC_RELAXED);
+			return false;
 		}
+		results->paths = paths;
+		results->capacity = capacity;
+	}
+
+	// add the path to the results
+	results->paths[results->numOfPaths] = path;
+	results->numOfPaths++;
+	return true;
+}
 
-		// free the last part of the filename
-		lastPart = Free(lastPart);
+// function that returns a new allocated path made of a directory path and a name
+// if addSlash is true, then a "/" is appended so that the path can be used as a directory path
+char* walkJoin(const char *dirPath, const char *name, bool addSlash) {
+	size_t dirPathLen = strlen(dirPath);
+	size_t nameLen = strlen(name);
+	char *path = malloc(dirPathLen + nameLen + 2);
+	if (path == NULL) {
+		return NULL;
 	}
+	memcpy(path, dirPath, dirPathLen);
+	memcpy(path + dirPathLen, name, nameLen);
+	if (addSlash) {
+		path[dirPathLen + nameLen] = '/';
+		path[dirPathLen + nameLen + 1] = '\0';
+	} else {
+		path[dirPathLen + nameLen] = '\0';
+	}
+	return path;
+}
 
-	// free the filenames
-	filenames = freeArrayOfStrings(filenames, numOfFilenames);
+// function that returns the number of bytes that execv() needs for the given arguments and the environment
+// every string takes its length plus the null terminator and a pointer in the argv or envp array
+size_t argumentListSize(char **args, size_t numOfArgs, char **envp) {
+	size_t size = 0;
 
-	// set the number of filenames
-	*pnumOfFilenames = finalNumOfFilenames;
+	// add the size of the arguments and the NULL pointer that terminates them
+	for (size_t i = 0; i < numOfArgs; i++) {
+		size += strlen(args[i]) + 1 + sizeof(char *);
+	}
+	size += sizeof(char *);
+
+	// add the size of the environment and the NULL pointer that terminates it
+	for (size_t i = 0; envp != NULL && envp[i] != NULL; i++) {
+		size += strlen(envp[i]) + 1 + sizeof(char *);
+	}
+	size += sizeof(char *);
+
+	// return the size
+	return size;
+}
+
+// function that returns the number of bytes that the arguments and the environment of a program may use
+size_t argumentListLimit() {
+	// get ARG_MAX from sysconf(), and fall back to the POSIX minimum if it is not known
+	long argMax = sysconf(_SC_ARG_MAX);
+	if (argMax <= 0) {
+		argMax = 4096;
+	}
+
+	// keep some headroom below ARG_MAX
+	if (argMax <= ARG_MAX_HEADROOM * 2) {
+		return (size_t) argMax / 2;
+	}
+	return (size_t) argMax - ARG_MAX_HEADROOM;
+}
+
+// function that prints the error message that is format "argument list too long: %s\n"
+void argumentListTooLong(const char *program) {
+	write(STDERR_FILENO, "argument list too long: ", 24);
+	write(STDERR_FILENO, program, strlen(program));
+	write(STDERR_FILENO, "\n", 1);
+}
 
-	// return the final list of filenames
-	return finalFilenames;
+// function that returns whether a program gives the same result when its arguments are split across several runs
+bool isSplitSafeProgram(const char *programPath) {
+	// if programPath is NULL, then return false
+	if (programPath == NULL) {
+		return false;
+	}
+
+	// compare the name of the program without its directory against the list of split safe programs
+	const char *name = strrchr(programPath, '/') == NULL ? programPath : strrchr(programPath, '/') + 1;
+	for (size_t i = 0; splitSafePrograms[i] != NULL; i++) {
+		if (strcmp(name, splitSafePrograms[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// function that returns whether a program prints nothing when it succeeds, so its runs over chunks of arguments can execute at the same time
+bool isSplitQuietProgram(const char *programPath) {
+	// if programPath is NULL, then return false
+	if (programPath == NULL) {
+		return false;
+	}
+
+	// compare the name of the program without its directory against the list of quiet programs
+	const char *name = strrchr(programPath, '/') == NULL ? programPath : strrchr(programPath, '/') + 1;
+	for (size_t i = 0; splitQuietPrograms[i] != NULL; i++) {
+		if (strcmp(name, splitQuietPrograms[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// function that returns the number of program arguments among the first numOfTokens tokens
+// uses the same rules as getProgramArgs(), so redirection operators and their file paths are not arguments
+size_t countProgramArgs(char **tokens, size_t numOfTokens) {
+	size_t numOfArgs = 0;
+	for (size_t i = 0; i < numOfTokens; i++) {
+		if (strcmp(tokens[i], "|") == 0) {
+			break;
+		}
+		if (isRedirection(tokens[i])) {
+			// if the token is "<" or ">", then skip the next token
+			i++;
+			continue;
+		}
+		numOfArgs++;
+	}
+	return numOfArgs;
+}
+
+// function that runs a program several times over chunks of its arguments so that every run fits in ARG_MAX
+// the first numOfFixedArgs and the last numOfTrailingArgs arguments are passed to every run
+// up to MYSH_SPLIT_JOBS runs of a quiet program are executed at the same time (1 by default, and at most MAX_SPLIT_JOBS)
+// any other program runs one chunk at a time, so its output is written in the order of its arguments
+// the runs are collected by their pids from the oldest, so no other child of the shell is reaped here
+// the exit status is 0 if every run succeeds, otherwise it is the exit status of the first failed run that is collected
+void chunkedProgram(const char *programPath, char **args, char **envp, size_t numOfArgs, size_t numOfFixedArgs, size_t numOfTrailingArgs, braceGenerator *generator, const int *stdInFd, const int *stdOutFd) {
+	// calculate the size every run needs for the fixed arguments, the trailing arguments, and the environment
+	size_t limit = argumentListLimit();
+	char **trailingArgs = args + numOfArgs - numOfTrailingArgs;
+	size_t fixedSize = argumentListSize(args, numOfFixedArgs, envp) + argumentListSize(trailingArgs, numOfTrailingArgs, NULL) - argumentListSize(NULL, 0, NULL);
+
+	// read the number of runs that may execute at the same time
+	long jobs = 1;
+	if (getVariable("MYSH_SPLIT_JOBS") != NULL && isSplitQuietProgram(programPath)) {
+		jobs = strtol(getVariable("MYSH_SPLIT_JOBS"), NULL, 10);
+		if (jobs < 1) {
+			jobs = 1;
+		}
+		if (jobs > MAX_SPLIT_JOBS) {
+			jobs = MAX_SPLIT_JOBS;
+		}
+	}
+
+	// allocate the argument list of a single run, which points into args
+	// the words of a brace generator are created for each run, and a run holds at most as many words as fit in the limit
+	size_t capacity = generator == NULL ? numOfArgs + 1 : numOfFixedArgs + numOfTrailingArgs + limit / (sizeof(char *) + 2) + 1;
+	char **chunkArgs = malloc(sizeof(char *) * capacity);
+	pid_t *pids = malloc(sizeof(pid_t) * (size_t) jobs);
+	if (chunkArgs == NULL || pids == NULL) {
+		perror("malloc");
+		chunkArgs = Free(chunkArgs);
+		pids = Free(pids);
+		exit_status = 1;
+		return;
+	}
+	memcpy(chunkArgs, args, sizeof(char *) * numOfFixedArgs);
+
+	// start a run for each chunk of arguments, and wait for one to finish when jobs runs are executing
+	// the pids of the running runs are kept in a ring from the oldest at oldest
+	ssize_t status = 0;
+	long running = 0;
+	long oldest = 0;
+	size_t next = numOfFixedArgs;
+	size_t end = numOfArgs - numOfTrailingArgs;
+	char *word = generator == NULL ? NULL : braceNext(generator);
+	while (generator == NULL ? next < end : word != NULL) {
+		// add arguments to the chunk until the next one does not fit
+		size_t size = fixedSize;
+		size_t numOfChunkArgs = numOfFixedArgs;
+		while (generator == NULL && next < end && size + strlen(args[next]) + 1 + sizeof(char *) <= limit) {
+			size += strlen(args[next]) + 1 + sizeof(char *);
+			chunkArgs[numOfChunkArgs] = args[next];
+			numOfChunkArgs++;
+			next++;
+		}
+		while (generator != NULL && word != NULL && size + strlen(word) + 1 + sizeof(char *) <= limit) {
+			size += strlen(word) + 1 + sizeof(char *);
+			chunkArgs[numOfChunkArgs] = word;
+			numOfChunkArgs++;
+			word = braceNext(generator);
+		}
+
+		// if not even a single argument fits, then the command can not be run
+		if (numOfChunkArgs == numOfFixedArgs) {
+			argumentListTooLong(args[0]);
+			if (status == 0) {
+				status = 1;
+			}
+			break;
+		}
+
+		// add the trailing arguments and the NULL pointer that terminates the list
+		memcpy(chunkArgs + numOfChunkArgs, trailingArgs, sizeof(char *) * numOfTrailingArgs);
+		chunkArgs[numOfChunkArgs + numOfTrailingArgs] = NULL;
+
+		// wait for the oldest run to finish if the maximum number of runs are executing
+		if (running == jobs) {
+			int childStatus = 0;
+			if (waitChild(pids[oldest], &childStatus) > 0 && status == 0) {
+				status = WIFEXITED(childStatus) ? WEXITSTATUS(childStatus) : 1;
+			}
+			oldest = (oldest + 1) % jobs;
+			running--;
+		}
+
+		// start the run, then free the generated words because the child has its own copy
+		pid_t pid = executeProgram(programPath, chunkArgs, envp, stdInFd, stdOutFd, false, NULL, NULL);
+		for (size_t i = numOfFixedArgs; generator != NULL && i < numOfChunkArgs; i++) {
+			chunkArgs[i] = Free(chunkArgs[i]);
+		}
+		if (pid == -1) {
+			status = 1;
+			break;
+		}
+		pids[(oldest + running) % jobs] = pid;
+		running++;
+	}
+	word = Free(word);
+
+	// wait for the remaining runs to finish
+	for (; running > 0; running--) {
+		int childStatus = 0;
+		if (waitChild(pids[oldest], &childStatus) > 0 && status == 0) {
+			status = WIFEXITED(childStatus) ? WEXITSTATUS(childStatus) : 1;
+		}
+		oldest = (oldest + 1) % jobs;
+	}
+
+	// free the argument list and the pids and set the exit status
+	chunkArgs = Free(chunkArgs);
+	pids = Free(pids);
+	exit_status = status;
+}
+
+// function that replaces the "<*" and "<*0" operators in a command with single character marks, in place
+// an operator is only recognized when it is followed by whitespace or the end of the command,
+// so a pattern like "<**/*.c" is still a stdin redirection from the expansion of "**/*.c"
+void markStreamRedirections(char *command) {
+	// if command is NULL, then return
+	if (command == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; command[i] != '\0'; i++) {
+		if (command[i] != '<' || command[i + 1] != '*') {
+			continue;
+		}
+		if (command[i + 2] == '\0' || strchr(" \t\n\v\f\r", command[i + 2]) != NULL) {
+			// "<*" becomes the mark followed by a space
+			command[i] = STREAM_MARK[0];
+			command[i + 1] = ' ';
+		} else if (command[i + 2] == '0' && (command[i + 3] == '\0' || strchr(" \t\n\v\f\r", command[i + 3]) != NULL)) {
+			// "<*0" becomes the mark followed by 2 spaces
+			command[i] = STREAM_MARK_NUL[0];
+			command[i + 1] = ' ';
+			command[i + 2] = ' ';
+		}
+	}
+}
+
+// function that returns whether a token is an operator that redirects stdin
+bool isStdInRedirection(const char *token) {
+	return strcmp(token, "<") == 0 || strcmp(token, STREAM_REDIRECT) == 0 || strcmp(token, STREAM_REDIRECT_NUL) == 0;
+}
+
+// function that returns whether a token is an operator that redirects stdin or stdout
+bool isRedirection(const char *token) {
+	return isStdInRedirection(token) || strcmp(token, ">") == 0;
+}
+
+// function that returns whether a token is a pipe or redirection operator
+bool isOperator(const char *token) {
+	return isRedirection(token) || strcmp(token, "|") == 0;
+}
+
+// function that returns a file descriptor for the stdin redirection of a program
+// "<" opens the file at path, while "<*" and "<*0" stream the matches of the pattern at path
+// returns -1 on error
+int openStdInRedirection(const char *operator, const char *path) {
+	if (strcmp(operator, STREAM_REDIRECT) == 0) {
+		return openStreamRedirection(path, '\n');
+	}
+	if (strcmp(operator, STREAM_REDIRECT_NUL) == 0) {
+		return openStreamRedirection(path, '\0');
+	}
+	statsAdd(STATS_OPEN, 1);
+	reportRedirect(path, true);
+	return open(path, O_RDONLY);
+}
+
+// function that returns the read end of a pipe that the matches of a wildcard pattern are streamed into
+// a feeder thread walks the directories and writes every match followed by the delimiter,
+// so memory stays bounded by the pipe and the reader sees the first matches right away
+// the feeder is a thread and not a forked child, since a child of a shell with walker, trace or stats threads could inherit
+// one of their locks while it is held and wait for it forever. it is joined by the command that started it
+// returns -1 on error
+int openStreamRedirection(const char *pattern, char delimiter) {
+	// create the pipe between the feeder and the program, close-on-exec so only the program that it is moved onto inherits the read end
+	int pipeFd[2];
+	if (pipe2(pipeFd, O_CLOEXEC) == -1) {
+		return -1;
+	}
+
+	// set up the walker here, where it reads the shell variables, and give the feeder a pattern that matches nothing an empty pipe
+	streamFeeder *f = malloc(sizeof(streamFeeder));
+	if (f == NULL) {
+		perror("malloc");
+		close(pipeFd[0]);
+		close(pipeFd[1]);
+		return -1;
+	}
+	f->start = traceNow();
+	if (walkerInit(&f->w, pattern, pipeFd[1], delimiter) == false) {
+		f = Free(f);
+		close(pipeFd[1]);
+		return pipeFd[0];
+	}
+
+	// block SIGPIPE in the feeder and its walker threads, so a program that stops reading early makes the writes fail with EPIPE
+	// instead of killing the shell
+	sigset_t pipeSignal;
+	sigset_t callerSignals;
+	sigemptyset(&pipeSignal);
+	sigaddset(&pipeSignal, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSignal, &callerSignals);
+	int error = pthread_create(&f->thread, NULL, streamFeederThread, f);
+	pthread_sigmask(SIG_SETMASK, &callerSignals, NULL);
+	if (error != 0) {
+		errno = error;
+		perror("pthread_create");
+		walkerFree(&f->w);
+		f = Free(f);
+		close(pipeFd[0]);
+		close(pipeFd[1]);
+		return -1;
+	}
+	f->next = streamFeeders;
+	streamFeeders = f;
+	return pipeFd[0];
+}
+
+// function that compiles a pattern segment into the instructions of a matcher
+// "*" matches any run of bytes, "?" matches any byte, "[...]" matches a set of bytes ("[!...]" or "[^...]" the complement),
+// and every other byte (including "\", because escapes are not supported) matches itself
+// a "[" without a closing "]" matches itself. returns false on error
+bool compileSegment(segmentMatcher *m, const char *segment) {
+	// allocate the worst case of one instruction per byte, and a literal buffer as long as the segment
+	size_t segmentLength = strlen(segment);
+	m->ops = calloc(segmentLength + 1, sizeof(matchOp));
+	m->literals = malloc(segmentLength + 1);
+	if (m->ops == NULL || m->literals == NULL) {
+		perror("malloc");
+		exit_status = 1;
+		freeSegmentMatcher(m);
+		return false;
+	}
+
+	// translate the segment into instructions, merging adjacent literal bytes and adjacent stars
+	size_t numOfLiterals = 0;
+	m->numOfOps = 0;
+	m->minLength = 0;
+	m->hasStar = false;
+	for (size_t i = 0; i < segmentLength; ) {
+		matchOp *previous = m->numOfOps > 0 ? &m->ops[m->numOfOps - 1] : NULL;
+		matchOp *op = &m->ops[m->numOfOps];
+		size_t classLength = 0;
+		if (segment[i] == '*') {
+			m->hasStar = true;
+			i++;
+			if (previous != NULL && previous->type == MATCH_STAR) {
+				continue;
+			}
+			op->type = MATCH_STAR;
+		} else if (segment[i] == '?') {
+			op->type = MATCH_ANY;
+			m->minLength++;
+			i++;
+		} else if (segment[i] == '[' && (classLength = compileClass(segment + i, op->set)) > 0) {
+			op->type = MATCH_CLASS;
+			m->minLength++;
+			i += classLength;
+		} else {
+			m->literals[numOfLiterals++] = segment[i++];
+			m->minLength++;
+			if (previous != NULL && previous->type == MATCH_LITERAL) {
+				previous->length++;
+				continue;
+			}
+			op->type = MATCH_LITERAL;
+			op->start = numOfLiterals - 1;
+			op->length = 1;
+		}
+		m->numOfOps++;
+	}
+
+	// a leading literal is checked with memcmp() at the start of the name
+	// a trailing literal after the last star is checked with memcmp() at the end of the name
+	m->firstOp = 0;
+	m->lastOp = m->numOfOps;
+	m->prefixLength = 0;
+	m->suffixLength = 0;
+	if (m->numOfOps > 0 && m->ops[0].type == MATCH_LITERAL) {
+		m->prefixLength = m->ops[0].length;
+		m->firstOp = 1;
+	}
+	if (m->hasStar && m->lastOp > m->firstOp && m->ops[m->lastOp - 1].type == MATCH_LITERAL) {
+		m->suffixLength = m->ops[m->lastOp - 1].length;
+		m->lastOp--;
+	}
+
+	// like fnmatch() with FNM_PERIOD, a leading "." in a name only matches a "." in the pattern
+	m->explicitPeriod = segment[0] == '.';
+	return true;
+}
+
+// function that compiles the bracket expression at the start of segment into a set of bytes
+// supports ranges ("a-z"), the character classes of ctype.h ("[:digit:]"), and a leading "]" that matches itself
+// returns the length of the bracket expression, or 0 if it has no closing "]"
+size_t compileClass(const char *segment, uint64_t *set) {
+	// define the character classes that may appear inside a bracket expression
+	static const struct {
+		const char *name;
+		int (*isClass)(int);
+	} classes[] = {
+		{"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl},
+		{"digit", isdigit}, {"graph", isgraph}, {"lower", islower}, {"print", isprint},
+		{"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit}
+	};
+	const size_t numOfClasses = sizeof(classes) / sizeof(classes[0]);
+
+	memset(set, 0, sizeof(uint64_t) * 4);
+	size_t i = 1;
+	bool negate = segment[i] == '!' || segment[i] == '^';
+	if (negate) {
+		i++;
+	}
+
+	// a "]" right after the opening bracket is part of the set
+	bool first = true;
+	while (segment[i] != '\0' && (segment[i] != ']' || first)) {
+		first = false;
+
+		// a character class adds every byte it contains
+		if (segment[i] == '[' && segment[i + 1] == ':') {
+			const char *end = strstr(segment + i + 2, ":]");
+			size_t j = 0;
+			for (; end != NULL && j < numOfClasses; j++) {
+				size_t nameLength = strlen(classes[j].name);
+				if ((size_t) (end - (segment + i + 2)) == nameLength && strncmp(segment + i + 2, classes[j].name, nameLength) == 0) {
+					break;
+				}
+			}
+			if (end != NULL && j < numOfClasses) {
+				for (int c = 0; c < 256; c++) {
+					if (classes[j].isClass(c)) {
+						set[c >> 6] |= (uint64_t) 1 << (c & 63);
+					}
+				}
+				i = (size_t) (end - segment) + 2;
+				continue;
+			}
+		}
+
+		// a range adds every byte from low to high, and a single byte adds itself
+		unsigned int low = (unsigned char) segment[i];
+		unsigned int high = low;
+		if (segment[i + 1] == '-' && segment[i + 2] != '\0' && segment[i + 2] != ']') {
+			high = (unsigned char) segment[i + 2];
+			i += 3;
+		} else {
+			i++;
+		}
+		for (unsigned int c = low; c <= high; c++) {
+			set[c >> 6] |= (uint64_t) 1 << (c & 63);
+		}
+	}
+
+	// without a closing "]" the "[" is an ordinary byte
+	if (segment[i] != ']') {
+		return 0;
+	}
+	if (negate) {
+		for (size_t j = 0; j < 4; j++) {
+			set[j] = ~set[j];
+		}
+	}
+	return i + 1;
+}
+
+// function that frees the instructions of a compiled pattern segment
+void freeSegmentMatcher(segmentMatcher *m) {
+	m->ops = Free(m->ops);
+	m->literals = Free(m->literals);
+	m->numOfOps = 0;
+}
+
+// function that returns whether a name of the given length matches a compiled pattern segment
+// the length checks and the memcmp() of the literal prefix and suffix reject most names
+// before the remaining instructions are run against the middle of the name
+bool segmentMatch(const segmentMatcher *m, const char *name, size_t length) {
+	if (length > 0 && name[0] == '.' && m->explicitPeriod == false) {
+		return false;
+	}
+	if (length < m->minLength || (m->hasStar == false && length != m->minLength)) {
+		return false;
+	}
+	if (m->prefixLength > 0 && memcmp(name, m->literals + m->ops[0].start, m->prefixLength) != 0) {
+		return false;
+	}
+	if (m->suffixLength > 0 && memcmp(name + length - m->suffixLength, m->literals + m->ops[m->lastOp].start, m->suffixLength) != 0) {
+		return false;
+	}
+	return matchOps(m, name + m->prefixLength, length - m->prefixLength - m->suffixLength);
+}
+
+// function that matches the instructions in [firstOp, lastOp) of a compiled segment against a name
+// when an instruction fails, the match resumes one byte further after the last star, which never needs more
+// than that single saved position because every other instruction matches a fixed number of bytes
+// a literal that follows a star is located with memchr() instead of trying every position
+bool matchOps(const segmentMatcher *m, const char *name, size_t length) {
+	size_t op = m->firstOp;
+	size_t pos = 0;
+	size_t starOp = SIZE_MAX;
+	size_t starPos = 0;
+
+	while (pos < length || (op < m->lastOp && m->ops[op].type == MATCH_STAR)) {
+		if (op < m->lastOp) {
+			const matchOp *current = &m->ops[op];
+			if (current->type == MATCH_STAR) {
+				// a star at the end matches whatever is left of the name
+				if (op + 1 == m->lastOp) {
+					return true;
+				}
+				starOp = op++;
+				starPos = pos;
+				continue;
+			}
+
+			// after a star, skip ahead to the next position where the first byte of the literal appears
+			if (current->type == MATCH_LITERAL && starOp != SIZE_MAX && starOp + 1 == op) {
+				const char *found = memchr(name + pos, m->literals[current->start], length - pos);
+				if (found == NULL) {
+					return false;
+				}
+				pos = (size_t) (found - name);
+				starPos = pos;
+			}
+
+			bool matched = false;
+			switch (current->type) {
+				case MATCH_LITERAL:
+					matched = length - pos >= current->length && memcmp(name + pos, m->literals + current->start, current->length) == 0;
+					break;
+				case MATCH_ANY:
+					matched = true;
+					break;
+				case MATCH_CLASS:
+					matched = (current->set[(unsigned char) name[pos] >> 6] >> ((unsigned char) name[pos] & 63)) & 1;
+					break;
+				default:
+					break;
+			}
+			if (matched) {
+				pos += current->type == MATCH_LITERAL ? current->length : 1;
+				op++;
+				continue;
+			}
+		}
+
+		// resume after the last star one byte further, or fail if there was no star
+		if (starOp == SIZE_MAX || starPos >= length) {
+			return false;
+		}
+		op = starOp + 1;
+		pos = ++starPos;
+	}
+	return op == m->lastOp;
+}
+
+// function that looks up the types of the candidate entries of a directory
+// several candidates are submitted to the io_uring of the walker thread as one batch of statx requests,
+// so on a filesystem with a high round trip time (such as NFS or FUSE) the lookups overlap instead of waiting in turn
+// if io_uring is unavailable or MYSH_GLOB_SYNC_STAT is set, then every candidate is looked up with fstatat()
+void walkStatCandidates(walker *w, size_t index, int dirFd, statCandidate *candidates, size_t numOfCandidates) {
+	statRing *ring = &w->rings[index];
+	size_t done = 0;
+	if (numOfCandidates > 1 && ring->unavailable == false && (ring->fd != -1 || statRingInit(ring))) {
+		done = statRingRun(ring, dirFd, candidates, numOfCandidates);
+	}
+	for (size_t i = done; i < numOfCandidates; i++) {
+		statSync(dirFd, &candidates[i]);
+	}
+}
+
+// function that creates an io_uring and maps its submission queue, completion queue and submission entries
+// io_uring_setup() fails on kernels older than 5.1 or where it is disabled, and a ring that can not run statx requests
+// (kernels older than 5.6) is not used either. in both cases the ring is marked unavailable
+// returns false if the ring is unavailable
+bool statRingInit(statRing *ring) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ring->fd = (int) syscall(__NR_io_uring_setup, STAT_RING_ENTRIES, &params);
+	if (ring->fd == -1) {
+		ring->unavailable = true;
+		return false;
+	}
+
+	// both queues are mapped with a single mmap(), which kernel 5.4 added, and the opcode of statx has to be supported,
+	// which kernel 5.6 added along with the probe that tells, so a kernel without the probe has no statx either
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || statRingSupports(ring->fd, IORING_OP_STATX) == false) {
+		statRingFree(ring);
+		ring->unavailable = true;
+		return false;
+	}
+
+	// map the queues and the array of submission entries
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (ring->cqRingSize > ring->sqRingSize) {
+		ring->sqRingSize = ring->cqRingSize;
+	}
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+		statRingFree(ring);
+		ring->unavailable = true;
+		return false;
+	}
+	ring->cqRing = ring->sqRing;
+
+	// find the head, tail, mask and entries of both queues inside the mapping
+	ring->sqTail = (unsigned *) ((char *) ring->sqRing + params.sq_off.tail);
+	ring->sqMask = (unsigned *) ((char *) ring->sqRing + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned *) ((char *) ring->sqRing + params.sq_off.array);
+	ring->cqHead = (unsigned *) ((char *) ring->cqRing + params.cq_off.head);
+	ring->cqTail = (unsigned *) ((char *) ring->cqRing + params.cq_off.tail);
+	ring->cqMask = (unsigned *) ((char *) ring->cqRing + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cqRing + params.cq_off.cqes);
+	return true;
+}
+
+// function that returns whether the io_uring fd supports the opcode op, which is asked with IORING_REGISTER_PROBE
+// returns false if the kernel has no probe or it fails
+bool statRingSupports(int fd, unsigned op) {
+	size_t numOfOps = 256;
+	struct io_uring_probe *probe = calloc(1, sizeof(struct io_uring_probe) + numOfOps * sizeof(struct io_uring_probe_op));
+	if (probe == NULL) {
+		return false;
+	}
+	bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, (unsigned) numOfOps) == 0 &&
+		op <= probe->last_op && op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+	probe = Free(probe);
+	return supported;
+}
+
+// function that unmaps and closes the io_uring of a walker thread, if it was created
+void statRingFree(statRing *ring) {
+	if (ring->sqRing != NULL && ring->sqRing != MAP_FAILED) {
+		munmap(ring->sqRing, ring->sqRingSize);
+	}
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+		munmap(ring->sqes, ring->sqesSize);
+	}
+	if (ring->fd != -1) {
+		close(ring->fd);
+	}
+	ring->sqRing = NULL;
+	ring->cqRing = NULL;
+	ring->sqes = NULL;
+	ring->fd = -1;
+}
+
+// function that looks up the candidates with statx requests on an io_uring, STAT_RING_ENTRIES at a time
+// each batch is submitted and waited for with a single io_uring_enter()
+// returns the number of candidates that were looked up, the caller looks up the rest synchronously
+size_t statRingRun(statRing *ring, int dirFd, statCandidate *candidates, size_t numOfCandidates) {
+	struct statx *buffers = malloc(sizeof(struct statx) * STAT_RING_ENTRIES);
+	if (buffers == NULL) {
+		return 0;
+	}
+
+	size_t done = 0;
+	while (done < numOfCandidates) {
+		size_t batch = numOfCandidates - done;
+		if (batch > STAT_RING_ENTRIES) {
+			batch = STAT_RING_ENTRIES;
+		}
+
+		// fill a submission entry for each candidate, relative to the directory so the kernel does not walk the whole path again
+		unsigned tail = *ring->sqTail;
+		for (size_t i = 0; i < batch; i++) {
+			const statCandidate *candidate = &candidates[done + i];
+			unsigned slot = (tail + (unsigned) i) & *ring->sqMask;
+			struct io_uring_sqe *sqe = &ring->sqes[slot];
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = dirFd;
+			sqe->addr = (unsigned long) (candidate->path + candidate->nameOffset);
+			sqe->len = STATX_TYPE;
+			sqe->off = (unsigned long) &buffers[i];
+			sqe->statx_flags = candidate->follow ? 0 : AT_SYMLINK_NOFOLLOW;
+			sqe->user_data = i;
+			ring->sqArray[slot] = slot;
+		}
+		__atomic_store_n(ring->sqTail, tail + (unsigned) batch, __ATOMIC_RELEASE);
+
+		// submit the batch and wait until every request has completed
+		statsAdd(STATS_STAT, batch);
+		long submitted;
+		do {
+			submitted = syscall(__NR_io_uring_enter, ring->fd, (unsigned) batch, (unsigned) batch, IORING_ENTER_GETEVENTS, NULL, 0);
+		} while (submitted == -1 && errno == EINTR);
+
+		// collect the completions of the requests that were submitted, waiting again if some are still missing
+		// the kernel writes into buffers until every submitted request has completed, so they are collected even if the submit came up short
+		size_t inFlight = submitted > 0 ? (size_t) submitted : 0;
+		size_t completed = 0;
+		while (completed < inFlight) {
+			unsigned head = *ring->cqHead;
+			unsigned cqTail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+			for (; head != cqTail; head++) {
+				const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+				statCandidate *candidate = &candidates[done + cqe->user_data];
+				candidate->found = cqe->res == 0;
+				candidate->mode = candidate->found ? buffers[cqe->user_data].stx_mode : 0;
+
+				// a request that the kernel or the filesystem can not run says nothing about the entry, so it is looked up with fstatat()
+				if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+					statSync(dirFd, candidate);
+				}
+				completed++;
+			}
+			__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+			if (completed < inFlight) {
+				syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			}
+		}
+
+		// if only part of the batch was submitted, then the ring is in an unknown state, so stop using it
+		// and the caller looks up the whole batch synchronously
+		if (submitted != (long) batch) {
+			statRingFree(ring);
+			ring->unavailable = true;
+			break;
+		}
+		done += batch;
+	}
+
+	buffers = Free(buffers);
+	return done;
+}
+
+// function that looks up the type of a single candidate with fstatat(), relative to the directory
+void statSync(int dirFd, statCandidate *candidate) {
+	struct stat st;
+	statsAdd(STATS_STAT, 1);
+	candidate->found = fstatat(dirFd, candidate->path + candidate->nameOffset, &st, candidate->follow ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+	candidate->mode = candidate->found ? st.st_mode : 0;
+}
+
+// function that copies the environment of the shell into exported shell variables
+void importEnvironment() {
+	extern char **environ;
+	for (size_t i = 0; environ != NULL && environ[i] != NULL; i++) {
+		const char *equals = strchr(environ[i], '=');
+		if (equals != NULL && equals != environ[i] && setVariable(environ[i], (size_t) (equals - environ[i]), equals + 1, true) == false) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// function that returns the single copy of the first length characters of str, adding it if it is new
+// returns NULL if an error occurs
+const char* intern(const char *str, size_t length) {
+	// grow the table before it is half full, moving every string to its slot in the larger table
+	if (2 * (internedStrings.count + 1) > internedStrings.capacity) {
+		size_t capacity = internedStrings.capacity == 0 ? 256 : internedStrings.capacity * 2;
+		char **slots = calloc(capacity, sizeof(char *));
+		if (slots == NULL) {
+			return NULL;
+		}
+		for (size_t i = 0; i < internedStrings.capacity; i++) {
+			char *slot = internedStrings.slots[i];
+			if (slot == NULL) {
+				continue;
+			}
+			size_t j = strHash(slot, strlen(slot)) & (capacity - 1);
+			while (slots[j] != NULL) {
+				j = (j + 1) & (capacity - 1);
+			}
+			slots[j] = slot;
+		}
+		internedStrings.slots = Free(internedStrings.slots);
+		internedStrings.slots = slots;
+		internedStrings.capacity = capacity;
+	}
+
+	// probe from the slot of the hash until the string or an empty slot is found
+	size_t mask = internedStrings.capacity - 1;
+	for (size_t i = strHash(str, length) & mask; ; i = (i + 1) & mask) {
+		char *slot = internedStrings.slots[i];
+		if (slot == NULL) {
+			slot = strndup(str, length);
+			if (slot == NULL) {
+				return NULL;
+			}
+			internedStrings.slots[i] = slot;
+			internedStrings.count++;
+			return slot;
+		}
+		if (strncmp(slot, str, length) == 0 && slot[length] == '\0') {
+			return slot;
+		}
+	}
+}
+
+// function that returns the slot of the variable with the given name, or the empty slot where it would be added
+// returns NULL if the table has no slots yet
+variable* findVariable(const char *name, size_t length, size_t hash) {
+	if (variables.capacity == 0) {
+		return NULL;
+	}
+	size_t mask = variables.capacity - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		variable *slot = &variables.slots[i];
+		if (slot->name == NULL || (slot->hash == hash && strncmp(slot->name, name, length) == 0 && slot->name[length] == '\0')) {
+			return slot;
+		}
+	}
+}
+
+// function that doubles the capacity of the variable table and moves every variable to its slot in the larger table
+// returns false if an error occurs
+bool growVariables() {
+	size_t capacity = variables.capacity == 0 ? 64 : variables.capacity * 2;
+	variable *slots = calloc(capacity, sizeof(variable));
+	if (slots == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < variables.capacity; i++) {
+		if (variables.slots[i].name == NULL) {
+			continue;
+		}
+		size_t j = variables.slots[i].hash & (capacity - 1);
+		while (slots[j].name != NULL) {
+			j = (j + 1) & (capacity - 1);
+		}
+		slots[j] = variables.slots[i];
+	}
+	variables.slots = Free(variables.slots);
+	variables.slots = slots;
+	variables.capacity = capacity;
+	return true;
+}
+
+// function that sets the value of the variable with the given name, adding the variable if it is new
+// a NULL value keeps the current value, and a variable that is exported stays exported
+// returns false if an error occurs
+bool setVariable(const char *name, size_t nameLength, const char *value, bool exported) {
+	// setting the variable of the running loop stores it and stops substituting the word of this iteration, and a NULL value keeps that word
+	if (loopVariable != NULL && strncmp(loopVariable, name, nameLength) == 0 && loopVariable[nameLength] == '\0') {
+		value = value == NULL ? loopValue : value;
+		loopVariable = NULL;
+	}
+	if (2 * (variables.count + 1) > variables.capacity && growVariables() == false) {
+		return false;
+	}
+	char *copy = value == NULL ? NULL : strdup(value);
+	if (value != NULL && copy == NULL) {
+		return false;
+	}
+
+	size_t hash = strHash(name, nameLength);
+	variable *slot = findVariable(name, nameLength, hash);
+	if (slot->name == NULL) {
+		slot->name = intern(name, nameLength);
+		if (slot->name == NULL) {
+			copy = Free(copy);
+			return false;
+		}
+		slot->hash = hash;
+		slot->value = copy;
+		slot->exported = exported;
+		variables.count++;
+	} else {
+		if (value != NULL) {
+			slot->value = Free(slot->value);
+			slot->value = copy;
+		}
+		slot->exported = slot->exported || exported;
+	}
+
+	// the cached envp only has to be rebuilt when a variable that programs see has changed
+	if (slot->exported) {
+		envpChanged = true;
+	}
+	return true;
+}
+
+// function that returns the value of a shell variable, or NULL if it is not set
+const char* getVariable(const char *name) {
+	size_t length = strlen(name);
+	variable *slot = findVariable(name, length, strHash(name, length));
+	return slot == NULL || slot->name == NULL ? NULL : slot->value;
+}
+
+// function that returns the envp of a program, which holds every exported variable that has a value
+// the envp is built once and reused for every program until an exported variable changes
+// if withAssignments is true, then the assignments at the start of the command are added to a copy of it
+// the envp must be released with releaseEnvironment()
+char** programEnvironment(bool withAssignments) {
+	extern char **environ;
+
+	// rebuild the cached envp from the exported variables, with the "NAME=value" strings one after another in a single buffer
+	statsAdd(envpChanged || cachedEnvp == NULL ? STATS_ENV_MISSES : STATS_ENV_HITS, 1);
+	if (envpChanged || cachedEnvp == NULL) {
+		size_t numOfExported = 0;
+		size_t size = 0;
+		for (size_t i = 0; i < variables.capacity; i++) {
+			const variable *slot = &variables.slots[i];
+			if (slot->name != NULL && slot->exported && slot->value != NULL) {
+				numOfExported++;
+				size += strlen(slot->name) + strlen(slot->value) + 2;
+			}
+		}
+		char **envp = malloc(sizeof(char *) * (numOfExported + 1));
+		char *strings = malloc(sizeof(char) * (size + 1));
+
+		// if the envp could not be built, then the programs inherit the environment of the shell
+		if (envp == NULL || strings == NULL) {
+			perror("malloc");
+			envp = Free(envp);
+			strings = Free(strings);
+			return environ;
+		}
+		size_t n = 0;
+		char *next = strings;
+		for (size_t i = 0; i < variables.capacity; i++) {
+			const variable *slot = &variables.slots[i];
+			if (slot->name == NULL || slot->exported == false || slot->value == NULL) {
+				continue;
+			}
+			size_t nameLength = strlen(slot->name);
+			size_t valueLength = strlen(slot->value);
+			envp[n++] = next;
+			memcpy(next, slot->name, nameLength);
+			next[nameLength] = '=';
+			memcpy(next + nameLength + 1, slot->value, valueLength + 1);
+			next += nameLength + valueLength + 2;
+		}
+		envp[n] = NULL;
+		cachedEnvp = Free(cachedEnvp);
+		cachedEnvpStrings = Free(cachedEnvpStrings);
+		cachedEnvp = envp;
+		cachedEnvpStrings = strings;
+		envpChanged = false;
+	}
+	if (withAssignments == false || numOfCommandAssignments == 0) {
+		return cachedEnvp;
+	}
+
+	// copy the cached envp, replacing the variables that are assigned and adding the others at the end
+	size_t numOfCached = 0;
+	while (cachedEnvp[numOfCached] != NULL) {
+		numOfCached++;
+	}
+	char **envp = malloc(sizeof(char *) * (numOfCached + numOfCommandAssignments + 1));
+	if (envp == NULL) {
+		perror("malloc");
+		return cachedEnvp;
+	}
+	memcpy(envp, cachedEnvp, sizeof(char *) * numOfCached);
+	size_t n = numOfCached;
+	for (size_t i = 0; i < numOfCommandAssignments; i++) {
+		size_t nameLength = (size_t) (strchr(commandAssignments[i], '=') - commandAssignments[i]) + 1;
+		size_t j = 0;
+		while (j < n && strncmp(envp[j], commandAssignments[i], nameLength) != 0) {
+			j++;
+		}
+		envp[j] = commandAssignments[i];
+		if (j == n) {
+			n++;
+		}
+	}
+	envp[n] = NULL;
+	return envp;
+}
+
+// function that frees an envp returned by programEnvironment() unless it is shared
+void releaseEnvironment(char **envp) {
+	extern char **environ;
+	if (envp != cachedEnvp && envp != environ) {
+		envp = Free(envp);
+	}
+}
+
+// function that returns whether a token assigns a variable, which is a name followed by "=" like "NAME=value"
+// a name starts with a letter or "_" and continues with letters, digits and "_"
+bool isAssignment(const char *token) {
+	if (!isalpha((unsigned char) token[0]) && token[0] != '_') {
+		return false;
+	}
+	size_t i = 1;
+	while (isalnum((unsigned char) token[i]) || token[i] == '_') {
+		i++;
+	}
+	return token[i] == '=';
+}
+
+// function that removes the assignments at the start of a command from its tokens, expanding variables in their values
+// if nothing but assignments is left, then they set shell variables and numOfTokens becomes 0
+// otherwise they are kept in commandAssignments for the environment of the first program
+// returns -1 if an error occurs
+ssize_t takeAssignments(char **tokens, size_t *numOfTokens) {
+	size_t numOfAssignments = 0;
+	while (numOfAssignments < *numOfTokens && isAssignment(tokens[numOfAssignments])) {
+		numOfAssignments++;
+	}
+	if (numOfAssignments == 0) {
+		return 0;
+	}
+
+	// expand the variables in the values, so "PATH=$PATH:/opt/bin" works
+	// a command made of assignments only sets shell variables from left to right, so "A=1 B=$A" sets B to 1
+	// the assignments are then freed, and the caller frees the empty tokens array
+	bool assignOnly = numOfAssignments == *numOfTokens;
+	ssize_t result = 0;
+	for (size_t i = 0; i < numOfAssignments; i++) {
+		char *expanded = result == 0 ? expandVariableReferences(tokens[i]) : NULL;
+		if (expanded == NULL) {
+			result = -1;
+		} else {
+			tokens[i] = Free(tokens[i]);
+			tokens[i] = expanded;
+		}
+		const char *equals = strchr(tokens[i], '=');
+		if (result == 0 && assignOnly && setVariable(tokens[i], (size_t) (equals - tokens[i]), equals + 1, false) == false) {
+			perror("malloc");
+			result = -1;
+		}
+		if (assignOnly) {
+			tokens[i] = Free(tokens[i]);
+		}
+	}
+	if (assignOnly) {
+		*numOfTokens = 0;
+	}
+	if (result == -1 || assignOnly) {
+		return result;
+	}
+
+	// otherwise move the assignments out of the tokens
+	commandAssignments = malloc(sizeof(char *) * numOfAssignments);
+	if (commandAssignments == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	memcpy(commandAssignments, tokens, sizeof(char *) * numOfAssignments);
+	numOfCommandAssignments = numOfAssignments;
+	memmove(tokens, tokens + numOfAssignments, sizeof(char *) * (*numOfTokens - numOfAssignments));
+	*numOfTokens -= numOfAssignments;
+	tokens[*numOfTokens] = NULL;
+	return (ssize_t) numOfAssignments;
+}
+
+// function that returns a copy of a token with every "$NAME", "${NAME}" and "$?" replaced with its value
+// inside a function, "$1" to "$9" (or "${10}" and so on) are its arguments, "$#" is their number and "$@" or "$*" joins them
+// a variable that is not set is replaced with nothing, and a "$" that starts none of them is kept
+// returns NULL if an error occurs
+char* expandVariableReferences(const char *token) {
+	char *result = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	if (strAppend(&result, &length, &capacity, "", 0) == false) {
+		return NULL;
+	}
+
+	for (size_t i = 0; token[i] != '\0'; ) {
+		// copy the text up to the next "$"
+		const char *dollar = strchr(token + i, '$');
+		size_t textLength = dollar == NULL ? strlen(token + i) : (size_t) (dollar - (token + i));
+		if (strAppend(&result, &length, &capacity, token + i, textLength) == false) {
+			result = Free(result);
+			return NULL;
+		}
+		i += textLength;
+		if (dollar == NULL) {
+			break;
+		}
+
+		// find the name after the "$", which may be enclosed in braces
+		size_t nameStart = i + 1;
+		bool braced = token[nameStart] == '{';
+		if (braced) {
+			nameStart++;
+		}
+		size_t nameEnd = nameStart;
+		if (token[nameStart] == '?' || token[nameStart] == '#' || token[nameStart] == '@' || token[nameStart] == '*') {
+			nameEnd++;
+		} else if (isdigit((unsigned char) token[nameStart])) {
+			nameEnd++;
+			while (braced && isdigit((unsigned char) token[nameEnd])) {
+				nameEnd++;
+			}
+		} else if (isalpha((unsigned char) token[nameStart]) || token[nameStart] == '_') {
+			while (isalnum((unsigned char) token[nameEnd]) || token[nameEnd] == '_') {
+				nameEnd++;
+			}
+		}
+		if (nameEnd == nameStart || (braced && token[nameEnd] != '}')) {
+			if (strAppend(&result, &length, &capacity, "$", 1) == false) {
+				result = Free(result);
+				return NULL;
+			}
+			i++;
+			continue;
+		}
+
+		// append the value of the variable, or the exit status of the last command for "$?"
+		char status[24];
+		const char *value = NULL;
+		if (token[nameStart] == '?') {
+			snprintf(status, sizeof(status), "%zd", exit_status);
+			value = status;
+		} else if (token[nameStart] == '#') {
+			snprintf(status, sizeof(status), "%zu", numOfPositionalArgs);
+			value = status;
+		} else if (isdigit((unsigned char) token[nameStart])) {
+			size_t index = strtoul(token + nameStart, NULL, 10);
+			value = index == 0 ? (positionalArgs == NULL ? "mysh" : positionalArgs[0]) : index <= numOfPositionalArgs ? positionalArgs[index] : NULL;
+		} else if (token[nameStart] == '@' || token[nameStart] == '*') {
+			// the arguments of the function are joined with spaces
+			for (size_t j = 1; j <= numOfPositionalArgs; j++) {
+				if ((j > 1 && !strAppend(&result, &length, &capacity, " ", 1)) || !strAppend(&result, &length, &capacity, positionalArgs[j], strlen(positionalArgs[j]))) {
+					result = Free(result);
+					return NULL;
+				}
+			}
+		} else if (loopVariable != NULL && strncmp(loopVariable, token + nameStart, nameEnd - nameStart) == 0 && loopVariable[nameEnd - nameStart] == '\0') {
+			value = loopValue;
+		} else {
+			variable *slot = findVariable(token + nameStart, nameEnd - nameStart, strHash(token + nameStart, nameEnd - nameStart));
+			value = slot == NULL || slot->name == NULL ? NULL : slot->value;
+		}
+		if (value != NULL && strAppend(&result, &length, &capacity, value, strlen(value)) == false) {
+			result = Free(result);
+			return NULL;
+		}
+		i = braced ? nameEnd + 1 : nameEnd;
+	}
+	return result;
+}
+
+// function that replaces the variable references in every token and removes the tokens that become empty
+// the file path of a redirection is expanded too
+// returns the number of tokens left, or -1 if an error occurs in which case every token is freed
+ssize_t expandVariables(char **tokens, size_t numOfTokens) {
+	size_t kept = 0;
+	for (size_t i = 0; i < numOfTokens; i++) {
+		if (strchr(tokens[i], '$') != NULL) {
+			char *expanded = expandVariableReferences(tokens[i]);
+			if (expanded == NULL) {
+				for (size_t j = 0; j < kept; j++) {
+					tokens[j] = Free(tokens[j]);
+				}
+				for (size_t j = i; j < numOfTokens; j++) {
+					tokens[j] = Free(tokens[j]);
+				}
+				return -1;
+			}
+			tokens[i] = Free(tokens[i]);
+			tokens[i] = expanded;
+		}
+		if (tokens[i][0] == '\0') {
+			tokens[i] = Free(tokens[i]);
+			continue;
+		}
+		tokens[kept++] = tokens[i];
+	}
+	for (size_t i = kept; i < numOfTokens; i++) {
+		tokens[i] = NULL;
+	}
+	return (ssize_t) kept;
+}
+
+// function that exports shell variables, so they are passed to the programs the shell runs
+// "export NAME=value" assigns and exports, "export NAME" exports an existing or future variable,
+// and "export" alone prints every exported variable in sorted order
+void exportCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+
+	// export every argument
+	exit_status = 0;
+	for (size_t i = 1; i < numOfArgs; i++) {
+		const char *equals = strchr(args[i], '=');
+		size_t nameLength = equals == NULL ? strlen(args[i]) : (size_t) (equals - args[i]);
+		bool valid = nameLength > 0 && (isalpha((unsigned char) args[i][0]) || args[i][0] == '_');
+		for (size_t j = 1; valid && j < nameLength; j++) {
+			valid = isalnum((unsigned char) args[i][j]) || args[i][j] == '_';
+		}
+		if (valid == false) {
+			write(STDERR_FILENO, "export: not a valid identifier: ", 32);
+			write(STDERR_FILENO, args[i], strlen(args[i]));
+			write(STDERR_FILENO, "\n", 1);
+			exit_status = 1;
+			continue;
+		}
+		if (setVariable(args[i], nameLength, equals == NULL ? NULL : equals + 1, true) == false) {
+			perror("malloc");
+			exit_status = 1;
+		}
+	}
+	if (numOfArgs > 1) {
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+	args = freeArrayOfStrings(args, numOfArgs);
+
+	// print the exported variables, sorted so the output does not depend on the hash table
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	if (stdOutFd == -1) {
+		exit_status = 1;
+		return;
+	}
+	char **lines = malloc(sizeof(char *) * (variables.count + 1));
+	size_t numOfLines = 0;
+	for (size_t i = 0; lines != NULL && i < variables.capacity; i++) {
+		const variable *slot = &variables.slots[i];
+		if (slot->name == NULL || slot->exported == false) {
+			continue;
+		}
+		char *line = NULL;
+		size_t length = 0;
+		size_t capacity = 0;
+		if (strAppend(&line, &length, &capacity, "export ", 7) && strAppend(&line, &length, &capacity, slot->name, strlen(slot->name)) &&
+			(slot->value == NULL || (strAppend(&line, &length, &capacity, "=", 1) && strAppend(&line, &length, &capacity, slot->value, strlen(slot->value)))) &&
+			strAppend(&line, &length, &capacity, "\n", 1)) {
+			lines[numOfLines++] = line;
+		} else {
+			line = Free(line);
+		}
+	}
+	if (lines == NULL) {
+		perror("malloc");
+		exit_status = 1;
+	} else {
+		sortArrayOfStrings(lines, numOfLines);
+		for (size_t i = 0; i < numOfLines; i++) {
+			writeAll(stdOutFd, lines[i], strlen(lines[i]));
+		}
+		lines = freeArrayOfStrings(lines, numOfLines);
+	}
+	if (stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+}
+
+// function that opens the stdout redirection of a built-in command, like pwdCommand() does
+// returns STDOUT_FILENO if there is no redirection, or -1 if the file can not be opened
+int openBuiltInStdOut(char **tokens, size_t numOfTokens) {
+	for (size_t i = 0; i + 1 < numOfTokens; i++) {
+		if (strcmp(tokens[i], ">") == 0) {
+			statsAdd(STATS_OPEN, 1);
+			int fd = open(tokens[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0640);
+			reportRedirect(tokens[i + 1], false);
+			if (fd == -1) {
+				perror("open");
+			}
+			return fd;
+		}
+	}
+	return STDOUT_FILENO;
+}
+
+// function that frees the state that only lives for a single command
+void clearCommandState() {
+	lazyBrace = braceFree(lazyBrace);
+	commandAssignments = freeArrayOfStrings(commandAssignments, numOfCommandAssignments);
+	numOfCommandAssignments = 0;
+}
+
+// function that frees the shell variables, the interned strings and the cached envp
+void freeVariables() {
+	for (size_t i = 0; i < variables.capacity; i++) {
+		variables.slots[i].value = Free(variables.slots[i].value);
+	}
+	variables.slots = Free(variables.slots);
+	variables.capacity = 0;
+	variables.count = 0;
+	internedStrings.slots = freeArrayOfStrings(internedStrings.slots, internedStrings.capacity);
+	internedStrings.capacity = 0;
+	internedStrings.count = 0;
+	cachedEnvp = Free(cachedEnvp);
+	cachedEnvpStrings = Free(cachedEnvpStrings);
+}
+
+// function that sets the working directory that the shell starts in
+// $PWD is kept if it names the same directory as ".", so the symbolic links in it are kept too
+void initWorkingDirectory() {
+	const char *pwd = getVariable("PWD");
+	struct stat pwdStat;
+	struct stat dotStat;
+	bool samePwd = pwd != NULL && pwd[0] == '/' && stat(pwd, &pwdStat) == 0 && stat(".", &dotStat) == 0 &&
+		pwdStat.st_dev == dotStat.st_dev && pwdStat.st_ino == dotStat.st_ino;
+	if (setWorkingDirectory(samePwd ? pwd : NULL) == false) {
+		perror("getcwd");
+	}
+}
+
+// function that remembers the working directory after the shell has moved into it, and sets $PWD
+// if logicalPath is NULL, then the physical path from getcwd() is used
+// returns false if an error occurs, in which case the next call to workingDirectory() tries again
+bool setWorkingDirectory(const char *logicalPath) {
+	char *path = logicalPath == NULL ? getcwd(NULL, 0) : strdup(logicalPath);
+	statsAdd(STATS_OPEN, path == NULL ? 0 : 1);
+	int fd = path == NULL ? -1 : open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	struct stat st;
+	if (fd != -1 && fstat(fd, &st) == -1) {
+		close(fd);
+		fd = -1;
+	}
+	if (cwdFd != -1) {
+		close(cwdFd);
+	}
+	logicalCwd = Free(logicalCwd);
+	cwdFd = fd;
+	if (fd == -1) {
+		path = Free(path);
+		return false;
+	}
+	logicalCwd = path;
+	cwdDev = st.st_dev;
+	cwdIno = st.st_ino;
+	if (setVariable("PWD", 3, logicalCwd, true) == false) {
+		perror("malloc");
+	}
+	return true;
+}
+
+// function that returns the working directory without calling getcwd() unless the directory has moved
+// the logical path is checked to still lead to the directory of cwdFd by its device and inode, which notices
+// the directory or any directory above it being renamed, since a rename above it does not change the status of the directory itself
+// returns NULL if the directory was removed or an error occurs
+const char* workingDirectory() {
+	struct stat st;
+	statsAdd(STATS_STAT, 1);
+	if (logicalCwd == NULL || fstat(cwdFd, &st) == -1) {
+		return setWorkingDirectory(NULL) ? logicalCwd : NULL;
+	}
+
+	// a directory that was removed has no links left, and getcwd() would fail for it too
+	if (st.st_nlink == 0) {
+		errno = ENOENT;
+		return NULL;
+	}
+	statsAdd(STATS_STAT, 1);
+	if (stat(logicalCwd, &st) == 0 && st.st_dev == cwdDev && st.st_ino == cwdIno) {
+		return logicalCwd;
+	}
+
+	// otherwise the directory or a directory above it was renamed, so find its new path
+	return setWorkingDirectory(NULL) ? logicalCwd : NULL;
+}
+
+// function that joins a path to the logical directory base, removing "." and resolving ".." without following symbolic links
+// example: joinLogicalPath("/home/user/link", "../src/.") returns "/home/user/src"
+// returns NULL if an error occurs
+char* joinLogicalPath(const char *base, const char *path) {
+	char *result = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	if (strAppend(&result, &length, &capacity, path[0] == '/' ? "" : base, path[0] == '/' ? 0 : strlen(base)) == false) {
+		return NULL;
+	}
+	if (length > 0 && result[length - 1] == '/') {
+		result[--length] = '\0';
+	}
+
+	// add the components of path one at a time
+	for (const char *component = path; *component != '\0'; ) {
+		const char *end = strchr(component, '/');
+		size_t componentLength = end == NULL ? strlen(component) : (size_t) (end - component);
+		if (componentLength == 2 && strncmp(component, "..", 2) == 0) {
+			while (length > 0 && result[length - 1] != '/') {
+				length--;
+			}
+			if (length > 0) {
+				length--;
+			}
+			result[length] = '\0';
+		} else if (componentLength > 0 && !(componentLength == 1 && component[0] == '.')) {
+			if (!strAppend(&result, &length, &capacity, "/", 1) || !strAppend(&result, &length, &capacity, component, componentLength)) {
+				result = Free(result);
+				return NULL;
+			}
+		}
+		component += end == NULL ? componentLength : componentLength + 1;
+	}
+
+	// the root directory is the only path that ends with "/"
+	if (length == 0 && strAppend(&result, &length, &capacity, "/", 1) == false) {
+		result = Free(result);
+		return NULL;
+	}
+	return result;
+}
+
+// function that changes the working directory to path, and sets $PWD and $OLDPWD
+// the logical path is tried first, so "cd .." leaves a symbolic link the way cd came in
+// if it does not exist, then path is used as given
+// returns -1 if the directory can not be changed
+ssize_t changeDirectory(const char *path) {
+	const char *cwd = path[0] == '/' ? "" : workingDirectory();
+	char *logical = cwd == NULL ? NULL : joinLogicalPath(cwd, path);
+	if (logical == NULL || chdir(logical) == -1) {
+		logical = Free(logical);
+		if (chdir(path) == -1) {
+			perror("chdir");
+			return -1;
+		}
+	}
+
+	// the old directory becomes $OLDPWD, and the new one is remembered without calling getcwd()
+	if (logicalCwd != NULL && setVariable("OLDPWD", 6, logicalCwd, true) == false) {
+		perror("malloc");
+	}
+	if (setWorkingDirectory(logical) == false) {
+		perror("getcwd");
+	}
+	logical = Free(logical);
+	return 0;
+}
+
+// function that pushes the working directory onto the directory stack and changes to the given directory
+// "pushd" without a directory swaps the working directory with the top of the stack
+// the stack is printed like dirs does
+void pushdCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+
+	// if more than 1 argument is given, then print an error message to stderr and set exit status to 1
+	if (numOfArgs > 2) {
+		write(STDERR_FILENO, "pushd: too many arguments\n", 26);
+		exit_status = 1;
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+	if (numOfArgs == 1 && dirStackSize == 0) {
+		write(STDERR_FILENO, "pushd: no other directory\n", 26);
+		exit_status = 1;
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+
+	// remember the working directory before it changes
+	const char *cwd = workingDirectory();
+	char *previous = cwd == NULL ? NULL : strdup(cwd);
+	char **stack = previous == NULL ? NULL : realloc(dirStack, sizeof(char *) * (dirStackSize + 1));
+	if (stack == NULL) {
+		perror(cwd == NULL ? "getcwd" : "malloc");
+		exit_status = 1;
+		previous = Free(previous);
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+	dirStack = stack;
+
+	// change to the given directory, or to the top of the stack which is then replaced
+	if (changeDirectory(numOfArgs == 1 ? dirStack[dirStackSize - 1] : args[1]) == -1) {
+		exit_status = 1;
+		previous = Free(previous);
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+	if (numOfArgs == 1) {
+		dirStack[dirStackSize - 1] = Free(dirStack[dirStackSize - 1]);
+		dirStack[dirStackSize - 1] = previous;
+	} else {
+		dirStack[dirStackSize++] = previous;
+	}
+	args = freeArrayOfStrings(args, numOfArgs);
+
+	// print the stack
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	exit_status = stdOutFd == -1 || printDirectoryStack(stdOutFd) == -1 ? 1 : 0;
+	if (stdOutFd != -1 && stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+}
+
+// function that pops the top of the directory stack and changes to it
+// the stack is printed like dirs does
+void popdCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+	args = freeArrayOfStrings(args, numOfArgs);
+
+	// if any arguments are given, then print an error message to stderr and set exit status to 1
+	if (numOfArgs > 1) {
+		write(STDERR_FILENO, "popd: too many arguments\n", 25);
+		exit_status = 1;
+		return;
+	}
+	if (dirStackSize == 0) {
+		write(STDERR_FILENO, "popd: directory stack empty\n", 28);
+		exit_status = 1;
+		return;
+	}
+
+	// change to the top of the stack, and pop it only if that worked
+	if (changeDirectory(dirStack[dirStackSize - 1]) == -1) {
+		exit_status = 1;
+		return;
+	}
+	dirStackSize--;
+	dirStack[dirStackSize] = Free(dirStack[dirStackSize]);
+
+	// print the stack
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	exit_status = stdOutFd == -1 || printDirectoryStack(stdOutFd) == -1 ? 1 : 0;
+	if (stdOutFd != -1 && stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+}
+
+// function that prints the working directory followed by the directory stack from top to bottom
+void dirsCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+	args = freeArrayOfStrings(args, numOfArgs);
+
+	// if any arguments are given, then print an error message to stderr and set exit status to 1
+	if (numOfArgs > 1) {
+		write(STDERR_FILENO, "dirs: too many arguments\n", 25);
+		exit_status = 1;
+		return;
+	}
+
+	// print the stack
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	exit_status = stdOutFd == -1 || printDirectoryStack(stdOutFd) == -1 ? 1 : 0;
+	if (stdOutFd != -1 && stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+}
+
+// function that writes the working directory and the directory stack on one line, separated by spaces
+// the home directory at the start of a path is written as "~"
+// returns -1 if an error occurs
+ssize_t printDirectoryStack(int fd) {
+	const char *cwd = workingDirectory();
+	if (cwd == NULL) {
+		perror("getcwd");
+		return -1;
+	}
+	char *line = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	// without a home directory every path is printed in full
+	size_t homeDirLength = homeDir == NULL ? 0 : strlen(homeDir);
+	for (size_t i = 0; i <= dirStackSize; i++) {
+		const char *path = i == 0 ? cwd : dirStack[dirStackSize - i];
+		bool inHome = homeDir != NULL && strncmp(path, homeDir, homeDirLength) == 0 && (path[homeDirLength] == '/' || path[homeDirLength] == '\0');
+		if ((i > 0 && !strAppend(&line, &length, &capacity, " ", 1)) ||
+			(inHome && !strAppend(&line, &length, &capacity, "~", 1)) ||
+			!strAppend(&line, &length, &capacity, inHome ? path + homeDirLength : path, strlen(inHome ? path + homeDirLength : path))) {
+			perror("malloc");
+			line = Free(line);
+			return -1;
+		}
+	}
+	if (strAppend(&line, &length, &capacity, "\n", 1) == false) {
+		perror("malloc");
+		line = Free(line);
+		return -1;
+	}
+	ssize_t written = writeAll(fd, line, length);
+	line = Free(line);
+	return written;
+}
+
+// function that frees the working directory and the directory stack
+void freeWorkingDirectory() {
+	logicalCwd = Free(logicalCwd);
+	if (cwdFd != -1) {
+		close(cwdFd);
+		cwdFd = -1;
+	}
+	dirStack = freeArrayOfStrings(dirStack, dirStackSize);
+	dirStackSize = 0;
+}
+
+// function that tokenizes a command, keeping the "<*" and "<*0" operators as single tokens
+// returns NULL if the command has no tokens or an error occurs, in which case numOfTokens is 0
+char** tokenizeCommand(char *command, size_t *numOfTokens) {
+	// mark the "<*" and "<*0" operators so that the tokenizer keeps them as single special tokens
+	markStreamRedirections(command);
+
+	// tokenize the command with whitespace as the delimiter and special tokens
+	allocPhaseSet(ALLOC_TOKENIZE);
+	char **tokens = strTokenize(command, " \t\n\v\f\r", numOfTokens, "|><" STREAM_MARK STREAM_MARK_NUL);
+	allocPhaseSet(ALLOC_OTHER);
+	if (tokens == NULL) {
+		*numOfTokens = 0;
+		return NULL;
+	}
+
+	// replace the marks of the stream operators with the operators
+	for (size_t i = 0; i < *numOfTokens; i++) {
+		if (strcmp(tokens[i], STREAM_MARK) == 0 || strcmp(tokens[i], STREAM_MARK_NUL) == 0) {
+			char *operator = strdup(strcmp(tokens[i], STREAM_MARK) == 0 ? STREAM_REDIRECT : STREAM_REDIRECT_NUL);
+			if (operator == NULL) {
+				perror("strdup");
+				tokens = freeStrTokens(tokens, *numOfTokens);
+				*numOfTokens = 0;
+				return NULL;
+			}
+			tokens[i] = Free(tokens[i]);
+			tokens[i] = operator;
+		}
+	}
+	return tokens;
+}
+
+// function that returns the length of the function definition header "name() {" at the start of a command
+// the name is stored in nameStart and nameLength. returns 0 if the command does not start a function definition
+size_t functionHeaderLength(const char *command, size_t *nameStart, size_t *nameLength) {
+	size_t i = 0;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	*nameStart = i;
+	if (!isalpha((unsigned char) command[i]) && command[i] != '_') {
+		return 0;
+	}
+	while (isalnum((unsigned char) command[i]) || command[i] == '_') {
+		i++;
+	}
+	*nameLength = i - *nameStart;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	if (command[i] != '(' || command[i + 1] != ')') {
+		return 0;
+	}
+	i += 2;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	return command[i] == '{' ? i + 1 : 0;
+}
+
+// function that returns the length of the last line of a block without its terminator, like "}" or "done"
+// the terminator must end the line and follow a ";" or whitespace, or be alone on the line
+// returns -1 if the line does not close the block
+ssize_t blockEnd(const char *line, const char *terminator) {
+	size_t length = strlen(line);
+	size_t terminatorLength = strlen(terminator);
+	while (length > 0 && isspace((unsigned char) line[length - 1])) {
+		length--;
+	}
+	if (length < terminatorLength || strncmp(line + length - terminatorLength, terminator, terminatorLength) != 0) {
+		return -1;
+	}
+	length -= terminatorLength;
+	if (length > 0 && line[length - 1] != ';' && !isspace((unsigned char) line[length - 1])) {
+		return -1;
+	}
+	return (ssize_t) length;
+}
+
+// function that returns the length of the loop header "for name in words; do" at the start of a command
+// the header may also end after the words, in which case needsDo is set because "do" has to start the next line
+// the name and the words are stored as offsets into the command. returns 0 if the command does not start a loop
+size_t loopHeaderLength(const char *command, size_t *nameStart, size_t *nameLength, size_t *wordsStart, size_t *wordsLength, bool *needsDo) {
+	size_t i = 0;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	if (strncmp(command + i, "for", 3) != 0 || !isspace((unsigned char) command[i + 3])) {
+		return 0;
+	}
+	i += 3;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	*nameStart = i;
+	if (!isalpha((unsigned char) command[i]) && command[i] != '_') {
+		return 0;
+	}
+	while (isalnum((unsigned char) command[i]) || command[i] == '_') {
+		i++;
+	}
+	*nameLength = i - *nameStart;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	if (strncmp(command + i, "in", 2) != 0 || (!isspace((unsigned char) command[i + 2]) && command[i + 2] != ';' && command[i + 2] != '\0')) {
+		return 0;
+	}
+	i += 2;
+
+	// the words go up to the ";" before "do", or to the end of the line
+	*wordsStart = i;
+	*wordsLength = strcspn(command + i, ";");
+	i += *wordsLength;
+	*needsDo = command[i] == '\0';
+	if (*needsDo) {
+		return i;
+	}
+	i++;
+	while (isspace((unsigned char) command[i])) {
+		i++;
+	}
+	if (strncmp(command + i, "do", 2) != 0 || (!isspace((unsigned char) command[i + 2]) && command[i + 2] != '\0')) {
+		return 0;
+	}
+	return i + 2;
+}
+
+// function that reads a line of a block, which is a function definition or a loop
+// a block may be written on one line, like "name() { cmd1; cmd2; }" or "for f in *.c; do cmd1; cmd2; done",
+// or start with its header and continue with one command per line until a line that ends with "}" or "done"
+// returns true if the line was part of a block, in which case it is freed
+bool blockLine(char *command) {
+	// a new block starts with the header of a function or a loop, and remembers its name and words
+	size_t headerLength = 0;
+	if (block.name == NULL) {
+		size_t nameStart = 0;
+		size_t nameLength = 0;
+		size_t wordsStart = 0;
+		size_t wordsLength = 0;
+		bool needsDo = false;
+		if ((headerLength = functionHeaderLength(command, &nameStart, &nameLength)) > 0) {
+			block.type = FUNCTION_BLOCK;
+		} else if ((headerLength = loopHeaderLength(command, &nameStart, &nameLength, &wordsStart, &wordsLength, &needsDo)) > 0) {
+			block.type = LOOP_BLOCK;
+			block.words = strndup(command + wordsStart, wordsLength);
+		} else {
+			return false;
+		}
+		block.name = strndup(command + nameStart, nameLength);
+		block.needsDo = needsDo;
+		block.startLine = profile.line;
+		if (block.name == NULL || (block.type == LOOP_BLOCK && block.words == NULL)) {
+			perror("strndup");
+			exit_status = 1;
+			clearBlock();
+			command = Free(command);
+			return true;
+		}
+	}
+
+	// a loop whose header did not end with "do" needs it at the start of the next line that is not empty
+	const char *line = command + headerLength;
+	if (block.needsDo) {
+		while (isspace((unsigned char) *line)) {
+			line++;
+		}
+		if (*line == '\0') {
+			command = Free(command);
+			return true;
+		}
+		if (strncmp(line, "do", 2) != 0 || (!isspace((unsigned char) line[2]) && line[2] != '\0')) {
+			write(STDERR_FILENO, "mysh: expected do\n", 18);
+			exit_status = 1;
+			clearBlock();
+			command = Free(command);
+			return true;
+		}
+		line += 2;
+		block.needsDo = false;
+	}
+
+	// add the line to the body, up to the terminator if there is one
+	ssize_t end = blockEnd(line, block.type == FUNCTION_BLOCK ? "}" : "done");
+	size_t lineLength = end == -1 ? strlen(line) : (size_t) end;
+	if (!strAppend(&block.body, &block.length, &block.capacity, line, lineLength) || !strAppend(&block.body, &block.length, &block.capacity, "\n", 1)) {
+		perror("malloc");
+		end = -2;
+	}
+	command = Free(command);
+	if (end == -1) {
+		return true;
+	}
+
+	// the block is complete, so define the function or run the loop unless an error occurred
+	// the block is cleared first, so the commands of a loop start with no block open
+	pendingBlock complete = block;
+	memset(&block, 0, sizeof(pendingBlock));
+	profile.line = complete.startLine;
+	if (end == -2) {
+		exit_status = 1;
+	} else if (complete.type == FUNCTION_BLOCK) {
+		exit_status = defineFunction(complete.name, complete.body) ? 0 : 1;
+	} else {
+		runLoop(complete.name, complete.words, complete.body);
+	}
+	complete.name = Free(complete.name);
+	complete.words = Free(complete.words);
+	complete.body = Free(complete.body);
+	return true;
+}
+
+// function that frees a block that has not been closed
+void clearBlock() {
+	block.name = Free(block.name);
+	block.words = Free(block.words);
+	block.body = Free(block.body);
+	block.length = 0;
+	block.capacity = 0;
+	block.needsDo = false;
+}
+
+// function that parses a command of a function body or an alias into a stored command
+// the command is tokenized, "~/" is replaced and the syntax is checked once here
+// and every program name that is not a variable, a built-in command or a function is replaced with its path
+// returns false if the command is empty or an error occurs
+bool storeCommand(storedCommand *c, const char *text) {
+	c->names = NULL;
+	char *command = strdup(text);
+	if (command == NULL) {
+		perror("strdup");
+		return false;
+	}
+	c->tokens = tokenizeCommand(command, &c->numOfTokens);
+	command = Free(command);
+	if (c->tokens == NULL) {
+		return false;
+	}
+	if (replaceWithHomeDir(c->tokens, c->numOfTokens) == -1 || checkCommandSyntax(c->tokens, c->numOfTokens) == -1) {
+		c->tokens = freeStrTokens(c->tokens, c->numOfTokens);
+		return false;
+	}
+
+	// remember which steps of parseCommand() still have to run for every call
+	c->assignments = isAssignment(c->tokens[0]);
+	c->substitute = false;
+	c->expand = false;
+	c->resolve = false;
+	for (size_t i = 0; i < c->numOfTokens; i++) {
+		c->substitute = c->substitute || strchr(c->tokens[i], '$') != NULL;
+		c->expand = c->expand || strpbrk(c->tokens[i], "{*?[") != NULL;
+	}
+
+	// resolve the program names now, so calls do not search the directories again, and keep the names for refreshStoredCommand()
+	for (size_t i = 0; i < c->numOfTokens; i++) {
+		if (!isProgramName(c->tokens, i, 0) || isBuiltIn(c->tokens[i])) {
+			continue;
+		}
+		char *fullPath = c->assignments || strchr(c->tokens[i], '$') != NULL || strchr(c->tokens[i], '/') != NULL ||
+			findDefinition(&functions, c->tokens[i]) != NULL ? NULL : findProgramPath(c->tokens[i]);
+		if (fullPath != NULL && c->names == NULL && (c->names = calloc(c->numOfTokens, sizeof(char *))) == NULL) {
+			fullPath = Free(fullPath);
+		}
+		if (fullPath == NULL) {
+			c->resolve = true;
+			continue;
+		}
+		c->names[i] = c->tokens[i];
+		c->tokens[i] = fullPath;
+	}
+	return true;
+}
+
+// function that splits the body of a function or a loop into commands separated by ";" or newlines, and stores each of them
+// returns false if an error occurs, in which case nothing is stored
+bool storeCommands(const char *body, storedCommand **commands, size_t *numOfCommands) {
+	*commands = NULL;
+	*numOfCommands = 0;
+	bool ok = true;
+	for (const char *start = body; ok && *start != '\0'; ) {
+		size_t length = strcspn(start, ";\n");
+		char *text = strndup(start, length);
+		size_t nameStart = 0;
+		size_t nameLength = 0;
+		size_t wordsStart = 0;
+		size_t wordsLength = 0;
+		bool needsDo = false;
+		if (text == NULL) {
+			perror("strndup");
+			ok = false;
+		} else if (functionHeaderLength(text, &nameStart, &nameLength) > 0 || loopHeaderLength(text, &nameStart, &nameLength, &wordsStart, &wordsLength, &needsDo) > 0) {
+			write(STDERR_FILENO, "mysh: functions and loops can not be nested\n", 44);
+			ok = false;
+		} else {
+			storedCommand *grown = realloc(*commands, sizeof(storedCommand) * (*numOfCommands + 1));
+			if (grown == NULL) {
+				perror("realloc");
+				ok = false;
+			} else {
+				*commands = grown;
+				if (storeCommand(&(*commands)[*numOfCommands], text)) {
+					(*numOfCommands)++;
+				} else {
+					// an empty command is skipped, while a syntax error has already been printed
+					size_t i = 0;
+					while (isspace((unsigned char) text[i])) {
+						i++;
+					}
+					ok = text[i] == '\0';
+				}
+			}
+		}
+		text = Free(text);
+		start += start[length] == '\0' ? length : length + 1;
+	}
+	if (ok == false) {
+		freeStoredCommands(*commands, *numOfCommands);
+		*commands = NULL;
+		*numOfCommands = 0;
+	}
+	return ok;
+}
+
+// function that defines a function whose body is the given text, with commands separated by ";" or newlines
+// returns false if an error occurs, in which case any previous definition is kept
+bool defineFunction(const char *name, const char *body) {
+	storedCommand *commands = NULL;
+	size_t numOfCommands = 0;
+	if (storeCommands(body, &commands, &numOfCommands) == false) {
+		return false;
+	}
+	if (numOfCommands == 0) {
+		write(STDERR_FILENO, "mysh: function body is empty\n", 29);
+		return false;
+	}
+	if (setDefinition(&functions, name, body, commands, numOfCommands) == false) {
+		freeStoredCommands(commands, numOfCommands);
+		return false;
+	}
+	return true;
+}
+
+// function that returns the slot of the definition with the given name, or the empty slot where it would be added
+// returns NULL if the table has no slots yet
+definition* definitionSlot(definitionTable *table, const char *name, size_t hash) {
+	if (table->capacity == 0) {
+		return NULL;
+	}
+	size_t mask = table->capacity - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		definition *slot = &table->slots[i];
+		if (slot->name == NULL || (slot->hash == hash && strcmp(slot->name, name) == 0)) {
+			return slot;
+		}
+	}
+}
+
+// function that returns the function or alias with the given name, or NULL if it is not defined
+definition* findDefinition(definitionTable *table, const char *name) {
+	if (table->count == 0) {
+		return NULL;
+	}
+	definition *slot = definitionSlot(table, name, strHash(name, strlen(name)));
+	return slot == NULL || slot->source == NULL ? NULL : slot;
+}
+
+// function that sets the stored commands of a function or alias, replacing the ones it had
+// a removed alias keeps its slot with a NULL source, so the table never needs tombstones
+// takes ownership of commands and returns false if an error occurs
+bool setDefinition(definitionTable *table, const char *name, const char *source, storedCommand *commands, size_t numOfCommands) {
+	// grow the table before it is half full, moving every definition to its slot in the larger table
+	if (2 * (table->count + 1) > table->capacity) {
+		size_t capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+		definition *slots = calloc(capacity, sizeof(definition));
+		if (slots == NULL) {
+			perror("calloc");
+			return false;
+		}
+		for (size_t i = 0; i < table->capacity; i++) {
+			if (table->slots[i].name == NULL) {
+				continue;
+			}
+			size_t j = table->slots[i].hash & (capacity - 1);
+			while (slots[j].name != NULL) {
+				j = (j + 1) & (capacity - 1);
+			}
+			slots[j] = table->slots[i];
+		}
+		table->slots = Free(table->slots);
+		table->slots = slots;
+		table->capacity = capacity;
+	}
+
+	char *sourceCopy = source == NULL ? NULL : strdup(source);
+	if (source != NULL && sourceCopy == NULL) {
+		perror("strdup");
+		return false;
+	}
+	size_t hash = strHash(name, strlen(name));
+	definition *slot = definitionSlot(table, name, hash);
+	if (slot->name == NULL) {
+		slot->name = intern(name, strlen(name));
+		if (slot->name == NULL) {
+			perror("malloc");
+			sourceCopy = Free(sourceCopy);
+			return false;
+		}
+		slot->hash = hash;
+		table->count++;
+	}
+	if (!retireStoredCommands(slot->commands, slot->numOfCommands)) {
+		sourceCopy = Free(sourceCopy);
+		return false;
+	}
+	slot->source = Free(slot->source);
+	slot->commands = commands;
+	slot->numOfCommands = numOfCommands;
+	slot->source = sourceCopy;
+	return true;
+}
+
+// function that frees the stored commands that a definition no longer uses, or keeps them until the outermost function call returns
+// if a function is running, since it may be running these very commands, like when "f() { source redefine-f.sh; echo after; }" is called
+// returns false if an error occurs, in which case the commands are neither freed nor kept
+bool retireStoredCommands(storedCommand *commands, size_t numOfCommands) {
+	if (functionDepth == 0 || commands == NULL) {
+		freeStoredCommands(commands, numOfCommands);
+		return true;
+	}
+	retiredCommands *r = malloc(sizeof(retiredCommands));
+	if (r == NULL) {
+		perror("malloc");
+		return false;
+	}
+	r->commands = commands;
+	r->numOfCommands = numOfCommands;
+	r->next = retired;
+	retired = r;
+	return true;
+}
+
+// function that frees the stored commands that were kept by retireStoredCommands()
+void freeRetiredCommands() {
+	while (retired != NULL) {
+		retiredCommands *next = retired->next;
+		freeStoredCommands(retired->commands, retired->numOfCommands);
+		retired = Free(retired);
+		retired = next;
+	}
+}
+
+// function that frees an array of stored commands
+void freeStoredCommands(storedCommand *commands, size_t numOfCommands) {
+	for (size_t i = 0; i < numOfCommands; i++) {
+		if (commands[i].names != NULL) {
+			commands[i].names = freeArrayOfStrings(commands[i].names, commands[i].numOfTokens);
+		}
+		commands[i].tokens = freeStrTokens(commands[i].tokens, commands[i].numOfTokens);
+	}
+	commands = Free(commands);
+}
+
+// function that returns the tokens of a stored command for a single run, with the variables and arguments substituted
+// a token that is exactly "$@" becomes one token for each argument, and tokens that become empty are removed
+// returns NULL if an error occurs
+char** instantiateCommand(const storedCommand *c, size_t *numOfTokens) {
+	// count the tokens that "$@" adds, so the array is allocated once
+	size_t capacity = c->numOfTokens + 1;
+	for (size_t i = 0; c->substitute && i < c->numOfTokens; i++) {
+		if (strcmp(c->tokens[i], "$@") == 0) {
+			capacity += numOfPositionalArgs;
+		}
+	}
+	char **tokens = malloc(sizeof(char *) * capacity);
+	if (tokens == NULL) {
+		perror("malloc");
+		return NULL;
+	}
+
+	*numOfTokens = 0;
+	for (size_t i = 0; i < c->numOfTokens; i++) {
+		if (c->substitute && strcmp(c->tokens[i], "$@") == 0) {
+			for (size_t j = 1; j <= numOfPositionalArgs; j++) {
+				if ((tokens[*numOfTokens] = strdup(positionalArgs[j])) == NULL) {
+					perror("strdup");
+					return freeStrTokens(tokens, *numOfTokens);
+				}
+				(*numOfTokens)++;
+			}
+			continue;
+		}
+		char *token = c->substitute && strchr(c->tokens[i], '$') != NULL ? expandVariableReferences(c->tokens[i]) : strdup(c->tokens[i]);
+		if (token == NULL) {
+			perror("malloc");
+			return freeStrTokens(tokens, *numOfTokens);
+		}
+		if (token[0] == '\0') {
+			token = Free(token);
+			continue;
+		}
+		tokens[(*numOfTokens)++] = token;
+	}
+	tokens[*numOfTokens] = NULL;
+	return tokens;
+}
+
+// function that checks the program paths that a stored command found when it was stored, before the command runs
+// a name that has been defined as a function since then is put back, so it is called as one, and a path that is no longer
+// an executable file is searched for again. like the remembered paths of other shells, a program that is added to an earlier
+// search directory is not noticed while the old path still works
+void refreshStoredCommand(storedCommand *c) {
+	for (size_t i = 0; c->names != NULL && i < c->numOfTokens; i++) {
+		if (c->names[i] == NULL) {
+			continue;
+		}
+		bool isFunction = findDefinition(&functions, c->names[i]) != NULL;
+		if (!isFunction && isExecutableFile(c->tokens[i])) {
+			continue;
+		}
+		char *fullPath = isFunction ? NULL : findProgramPath(c->names[i]);
+		c->tokens[i] = Free(c->tokens[i]);
+		if (fullPath != NULL) {
+			c->tokens[i] = fullPath;
+			continue;
+		}
+
+		// the name is resolved on every run from now on, as a function or a program
+		c->tokens[i] = c->names[i];
+		c->names[i] = NULL;
+		c->resolve = true;
+	}
+}
+
+// function that runs one stored command of a function body
+// only the steps of parseCommand() that depend on the arguments run here, the rest were done when the function was defined
+void runStoredCommand(storedCommand *c) {
+	size_t numOfTokens = 0;
+	profileCommand();
+	long long traceStart = traceNow();
+	refreshStoredCommand(c);
+	char **tokens = instantiateCommand(c, &numOfTokens);
+	if (tokens == NULL || numOfTokens == 0) {
+		exit_status = tokens == NULL ? 1 : 0;
+		tokens = Free(tokens);
+		return;
+	}
+	traceCommandTokens(tokens, numOfTokens);
+	traceSpan("expand", "instantiateCommand", traceStart);
+	statsAdd(STATS_COMMANDS, 1);
+	reportRecord record;
+	reportBegin(&record, NULL, tokens, numOfTokens);
+
+	// assignments in the body replace the assignments of the call while the command runs
+	char **callAssignments = commandAssignments;
+	size_t numOfCallAssignments = numOfCommandAssignments;
+	if (c->assignments) {
+		commandAssignments = NULL;
+		numOfCommandAssignments = 0;
+		ssize_t result = takeAssignments(tokens, &numOfTokens);
+		if (result == -1 || numOfTokens == 0) {
+			exit_status = result == -1 ? 1 : 0;
+			tokens = freeStrTokens(tokens, numOfTokens);
+		}
+	}
+
+	// expand braces and wildcards only if the command has them
+	if (tokens != NULL && c->expand) {
+		tokens = braceExpand(tokens, &numOfTokens);
+		tokens = tokens == NULL ? NULL : wildcardFilenames(tokens, &numOfTokens);
+		exit_status = tokens == NULL ? 1 : exit_status;
+	}
+	profileLap(PROFILE_EXPAND);
+
+	// a program name that was not known when the function was defined may be a function or have to be searched for now
+	// a function is only called when it is the whole command, like in parseCommand()
+	if (tokens != NULL) {
+		definition *f = c->resolve ? findDefinition(&functions, tokens[0]) : NULL;
+		for (size_t i = 0; f != NULL && i < numOfTokens; i++) {
+			if (strcmp(tokens[i], "|") == 0) {
+				f = NULL;
+			}
+		}
+		if (f != NULL) {
+			functionCall(f, tokens, numOfTokens);
+		} else if (c->resolve == false || replaceWithProgramPath(tokens, numOfTokens) != -1) {
+			executeCommand(tokens, numOfTokens);
+		}
+		profileLap(PROFILE_SPAWN);
+		tokens = freeStrTokens(tokens, numOfTokens);
+	}
+
+	// free the state of this command, and give the call its assignments back
+	lazyBrace = braceFree(lazyBrace);
+	if (c->assignments) {
+		commandAssignments = freeArrayOfStrings(commandAssignments, numOfCommandAssignments);
+		commandAssignments = callAssignments;
+		numOfCommandAssignments = numOfCallAssignments;
+	}
+	reportEnd(&record);
+}
+
+// function that calls a function, with the arguments of the call as $1, $2, ...
+// "<" and ">" redirect the stdin and stdout of every command in the body
+// the body may redefine the function or grow the table of functions, so the commands are taken out of f before it runs,
+// and the commands that it replaces are kept until the outermost call returns
+void functionCall(const definition *f, char **tokens, size_t numOfTokens) {
+	if (functionDepth == MAX_FUNCTION_DEPTH) {
+		write(STDERR_FILENO, "mysh: maximum function depth exceeded\n", 38);
+		exit_status = 1;
+		return;
+	}
+
+	// extract the arguments, and generate a brace expression that would otherwise be generated while a program runs
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	for (size_t i = 0; args != NULL && lazyBrace != NULL && i < numOfArgs; i++) {
+		if (strcmp(args[i], LAZY_BRACE_MARK) == 0) {
+			args = braceMaterialize(args, &numOfArgs, i, lazyBrace);
+			lazyBrace = braceFree(lazyBrace);
+		}
+	}
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+
+	// point stdin and stdout at the redirections, keeping the descriptors of the shell to put them back afterwards
+	streamFeeder *outerFeeders = streamFeeders;
+	int savedFd[2] = {-1, -1};
+	bool redirected = true;
+	for (size_t i = 0; i + 1 < numOfTokens; i++) {
+		if (!isRedirection(tokens[i])) {
+			continue;
+		}
+		int target = isStdInRedirection(tokens[i]) ? STDIN_FILENO : STDOUT_FILENO;
+		statsAdd(STATS_OPEN, target == STDIN_FILENO ? 0 : 1);
+		int fd = target == STDIN_FILENO ? openStdInRedirection(tokens[i], tokens[i + 1]) : open(tokens[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0640);
+		if (target == STDOUT_FILENO) {
+			reportRedirect(tokens[i + 1], false);
+		}
+		if (fd == -1 || (savedFd[target] == -1 && (savedFd[target] = fcntl(target, F_DUPFD_CLOEXEC, 10)) == -1) || dup2(fd, target) == -1) {
+			perror("open");
+			exit_status = 1;
+			redirected = false;
+		}
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+
+	// run the body with the arguments of this call, and put the arguments of the caller back afterwards
+	if (redirected) {
+		char **callerArgs = positionalArgs;
+		size_t numOfCallerArgs = numOfPositionalArgs;
+		positionalArgs = args;
+		numOfPositionalArgs = numOfArgs - 1;
+		const char *name = f->name;
+		storedCommand *commands = f->commands;
+		size_t numOfCommands = f->numOfCommands;
+		functionDepth++;
+		profilePush(name);
+		exit_status = 0;
+		for (size_t i = 0; i < numOfCommands; i++) {
+			runStoredCommand(&commands[i]);
+		}
+		profilePop();
+		functionDepth--;
+		if (functionDepth == 0) {
+			freeRetiredCommands();
+		}
+		positionalArgs = callerArgs;
+		numOfPositionalArgs = numOfCallerArgs;
+	}
+	for (int target = STDIN_FILENO; target <= STDOUT_FILENO; target++) {
+		if (savedFd[target] != -1) {
+			dup2(savedFd[target], target);
+			close(savedFd[target]);
+		}
+	}
+	joinStreamFeeders(outerFeeders);
+	args = freeArrayOfStrings(args, numOfArgs);
+}
+
+// function that replaces the program names that are aliases with the tokens of the alias
+// every token after the program name is kept, and the alias itself is not expanded again
+// returns NULL if an error occurs, in which case the tokens are freed
+char** expandAliases(char **tokens, size_t *numOfTokens) {
+	for (size_t i = 0; i < *numOfTokens; i++) {
+		if (i > 0 && strcmp(tokens[i - 1], "|") != 0) {
+			continue;
+		}
+		definition *a = findDefinition(&aliases, tokens[i]);
+		if (a == NULL) {
+			continue;
+		}
+
+		// make room for the tokens of the alias in place of the program name
+		storedCommand *c = &a->commands[0];
+		refreshStoredCommand(c);
+		char **grown = realloc(tokens, sizeof(char *) * (*numOfTokens + c->numOfTokens));
+		if (grown == NULL) {
+			perror("realloc");
+			return freeStrTokens(tokens, *numOfTokens);
+		}
+		tokens = grown;
+		tokens[i] = Free(tokens[i]);
+		memmove(tokens + i + c->numOfTokens, tokens + i + 1, sizeof(char *) * (*numOfTokens - i - 1));
+		for (size_t j = 0; j < c->numOfTokens; j++) {
+			tokens[i + j] = strdup(c->tokens[j]);
+		}
+		*numOfTokens += c->numOfTokens - 1;
+		tokens[*numOfTokens] = NULL;
+		for (size_t j = 0; j < c->numOfTokens; j++) {
+			if (tokens[i + j] == NULL) {
+				perror("strdup");
+				for (size_t k = 0; k < *numOfTokens; k++) {
+					tokens[k] = Free(tokens[k]);
+				}
+				tokens = Free(tokens);
+				return NULL;
+			}
+		}
+		i += c->numOfTokens - 1;
+	}
+	return tokens;
+}
+
+// function that defines or prints aliases
+// "alias name=value ..." makes name stand for the rest of the command, "alias name" prints one alias,
+// and "alias" alone prints every alias in sorted order. "unalias name ..." removes aliases
+void aliasCommand(char **tokens, size_t numOfTokens) {
+	// remove the aliases that are given
+	exit_status = 0;
+	if (strcasecmp(tokens[0], "unalias") == 0) {
+		for (size_t i = 1; i < numOfTokens; i++) {
+			if (findDefinition(&aliases, tokens[i]) == NULL) {
+				write(STDERR_FILENO, "unalias: not found: ", 20);
+				write(STDERR_FILENO, tokens[i], strlen(tokens[i]));
+				write(STDERR_FILENO, "\n", 1);
+				exit_status = 1;
+				continue;
+			}
+			setDefinition(&aliases, tokens[i], NULL, NULL, 0);
+		}
+		return;
+	}
+
+	// the value of an alias is every token after the "=", because the shell has no quotes to group them
+	const char *equals = numOfTokens > 1 ? strchr(tokens[1], '=') : NULL;
+	if (equals != NULL) {
+		char *name = strndup(tokens[1], (size_t) (equals - tokens[1]));
+		char *value = NULL;
+		size_t length = 0;
+		size_t capacity = 0;
+		bool ok = name != NULL && strAppend(&value, &length, &capacity, equals + 1, strlen(equals + 1));
+		for (size_t i = 2; ok && i < numOfTokens; i++) {
+			ok = strAppend(&value, &length, &capacity, " ", 1) && strAppend(&value, &length, &capacity, tokens[i], strlen(tokens[i]));
+		}
+		storedCommand *c = ok ? malloc(sizeof(storedCommand)) : NULL;
+		if (c == NULL) {
+			perror("malloc");
+			exit_status = 1;
+		} else if (name[0] == '\0' || strchr(name, '/') != NULL || storeCommand(c, value) == false) {
+			write(STDERR_FILENO, "alias: invalid alias\n", 21);
+			exit_status = 1;
+			c = Free(c);
+		} else if (setDefinition(&aliases, name, value, c, 1) == false) {
+			freeStoredCommands(c, 1);
+			exit_status = 1;
+		}
+		name = Free(name);
+		value = Free(value);
+		return;
+	}
+
+	// print the aliases, sorted so the output does not depend on the hash table
+	int stdOutFd = openBuiltInStdOut(tokens, numOfTokens);
+	if (stdOutFd == -1) {
+		exit_status = 1;
+		return;
+	}
+	char **lines = malloc(sizeof(char *) * (aliases.count + 1));
+	size_t numOfLines = 0;
+	for (size_t i = 0; lines != NULL && i < aliases.capacity; i++) {
+		const definition *slot = &aliases.slots[i];
+		if (slot->name == NULL || slot->source == NULL || (numOfTokens > 1 && !isRedirection(tokens[1]) && strcmp(slot->name, tokens[1]) != 0)) {
+			continue;
+		}
+		char *line = NULL;
+		size_t length = 0;
+		size_t capacity = 0;
+		if (strAppend(&line, &length, &capacity, "alias ", 6) && strAppend(&line, &length, &capacity, slot->name, strlen(slot->name)) &&
+			strAppend(&line, &length, &capacity, "='", 2) && strAppend(&line, &length, &capacity, slot->source, strlen(slot->source)) &&
+			strAppend(&line, &length, &capacity, "'\n", 2)) {
+			lines[numOfLines++] = line;
+		} else {
+			line = Free(line);
+		}
+	}
+	if (lines == NULL) {
+		perror("malloc");
+		exit_status = 1;
+	} else {
+		if (numOfLines == 0 && numOfTokens > 1 && !isRedirection(tokens[1])) {
+			write(STDERR_FILENO, "alias: not found: ", 18);
+			write(STDERR_FILENO, tokens[1], strlen(tokens[1]));
+			write(STDERR_FILENO, "\n", 1);
+			exit_status = 1;
+		}
+		sortArrayOfStrings(lines, numOfLines);
+		for (size_t i = 0; i < numOfLines; i++) {
+			writeAll(stdOutFd, lines[i], strlen(lines[i]));
+		}
+		lines = freeArrayOfStrings(lines, numOfLines);
+	}
+	if (stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+}
+
+// function that frees every function and alias, and a function definition or loop that was never closed
+void freeDefinitions() {
+	definitionTable *tables[] = {&functions, &aliases};
+	for (size_t t = 0; t < 2; t++) {
+		for (size_t i = 0; i < tables[t]->capacity; i++) {
+			freeStoredCommands(tables[t]->slots[i].commands, tables[t]->slots[i].numOfCommands);
+			tables[t]->slots[i].source = Free(tables[t]->slots[i].source);
+		}
+		tables[t]->slots = Free(tables[t]->slots);
+		tables[t]->capacity = 0;
+		tables[t]->count = 0;
+	}
+	freeRetiredCommands();
+	clearBlock();
+}
+
+// function that runs a loop, running the body once for every word with the loop variable set to the word
+// the words are expanded like the arguments of a program, so wildcards are matched by the walker and braces are generated
+// a brace expression with more than BRACE_LAZY_WORDS words is generated one word per iteration, so it is never held in memory
+// the body was parsed once by storeCommands(), and only the variables are substituted in every iteration
+void runLoop(const char *name, const char *words, const char *body) {
+	storedCommand *commands = NULL;
+	size_t numOfCommands = 0;
+	if (storeCommands(body, &commands, &numOfCommands) == false) {
+		exit_status = 1;
+		return;
+	}
+
+	// expand the words behind a "for" token, which stands in for the program name so the words are treated as arguments
+	size_t numOfTokens = 0;
+	char *command = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char **tokens = NULL;
+	if (strAppend(&command, &length, &capacity, "for ", 4) && strAppend(&command, &length, &capacity, words, strlen(words))) {
+		tokens = tokenizeCommand(command, &numOfTokens);
+	}
+	command = Free(command);
+	if (tokens != NULL && replaceWithHomeDir(tokens, numOfTokens) == -1) {
+		tokens = freeStrTokens(tokens, numOfTokens);
+	}
+	tokens = tokens == NULL ? NULL : braceExpand(tokens, &numOfTokens);
+	ssize_t result = tokens == NULL ? -1 : expandVariables(tokens, numOfTokens);
+	if (result == -1) {
+		tokens = Free(tokens);
+	}
+	numOfTokens = result == -1 ? 0 : (size_t) result;
+	tokens = tokens == NULL ? NULL : wildcardFilenames(tokens, &numOfTokens);
+	// the loop owns the generator of a lazy brace expression, because every command of the body frees lazyBrace
+	braceGenerator *generator = lazyBrace;
+	lazyBrace = NULL;
+	if (tokens == NULL) {
+		exit_status = 1;
+		braceFree(generator);
+		generator = Free(generator);
+		freeStoredCommands(commands, numOfCommands);
+		return;
+	}
+
+	// run the body for every word, and for every generated word in place of the mark of a lazy brace expression
+	exit_status = 0;
+	char *generated = NULL;
+	const char *last = NULL;
+	bool assigned = false;
+	for (size_t i = 1; i < numOfTokens; i++) {
+		bool isLazy = generator != NULL && strcmp(tokens[i], LAZY_BRACE_MARK) == 0;
+		while (true) {
+			if (isLazy) {
+				char *next = braceNext(generator);
+				if (next == NULL) {
+					break;
+				}
+				generated = Free(generated);
+				generated = next;
+			}
+			loopVariable = name;
+			loopValue = isLazy ? generated : tokens[i];
+			last = loopValue;
+			for (size_t j = 0; j < numOfCommands; j++) {
+				runStoredCommand(&commands[j]);
+			}
+			assigned = loopVariable == NULL;
+			if (!isLazy) {
+				break;
+			}
+		}
+	}
+	loopVariable = NULL;
+	loopValue = NULL;
+
+	// the loop variable keeps the last word after the loop, like in other shells, unless the last iteration set it
+	// it is stored once here instead of in every iteration
+	if (numOfTokens > 1 && last != NULL && !assigned && setVariable(name, strlen(name), last, false) == false) {
+		perror("malloc");
+	}
+	generated = Free(generated);
+	braceFree(generator);
+	generator = Free(generator);
+	tokens = freeStrTokens(tokens, numOfTokens);
+	freeStoredCommands(commands, numOfCommands);
+}
+
+// function that reads a whole script into a buffer that ends with a NUL byte, and sets length
+// returns NULL if an error occurs, which is printed
+char* readScript(const char *scriptPath, size_t *length) {
+	statsAdd(STATS_OPEN, 1);
+	int fd = open(scriptPath, O_RDONLY | O_CLOEXEC);
+	char *script = NULL;
+	size_t capacity = 0;
+	char chunk[65536];
+	ssize_t bytesRead = 0;
+	*length = 0;
+	bool ok = fd != -1 && strAppend(&script, length, &capacity, "", 0);
+	while (ok && (bytesRead = read(fd, chunk, sizeof(chunk))) > 0) {
+		statsAdd(STATS_READ, 1);
+		ok = strAppend(&script, length, &capacity, chunk, (size_t) bytesRead);
+	}
+	if (fd == -1 || bytesRead == -1 || ok == false) {
+		perror(scriptPath);
+		script = Free(script);
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	return script;
+}
+
+// function that returns the path of the compiled form of a script, which replaces a ".sh" extension with ".myshc"
+// example: "jobs/nightly.sh" becomes "jobs/nightly.myshc", and "run" becomes "run.myshc"
+// returns NULL if an error occurs
+char* compiledScriptPath(const char *scriptPath) {
+	size_t length = strlen(scriptPath);
+	if (length > 3 && strcmp(scriptPath + length - 3, ".sh") == 0) {
+		length -= 3;
+	}
+	char *path = malloc(length + strlen(COMPILED_EXTENSION) + 1);
+	if (path == NULL) {
+		perror("malloc");
+		return NULL;
+	}
+	memcpy(path, scriptPath, length);
+	strcpy(path + length, COMPILED_EXTENSION);
+	return path;
+}
+
+// function that fills the stamps of a compiled script with the size and mtime of the script and the mtimes of the search directories
+// a directory that does not exist is stamped with 0, so creating it later makes the compiled script stale
+// returns false if the script can not be read
+bool compiledStamps(const char *scriptPath, compiledHeader *header) {
+	struct stat st;
+	statsAdd(STATS_STAT, 1 + NUM_SEARCH_DIRS);
+	if (stat(scriptPath, &st) == -1) {
+		return false;
+	}
+	header->scriptSize = (uint64_t) st.st_size;
+	header->scriptMtimeSec = (uint64_t) st.st_mtim.tv_sec;
+	header->scriptMtimeNsec = (uint64_t) st.st_mtim.tv_nsec;
+	for (size_t i = 0; i < NUM_SEARCH_DIRS; i++) {
+		bool found = stat(searchDirs[i], &st) == 0;
+		header->dirMtimeSec[i] = found ? (uint64_t) st.st_mtim.tv_sec : 0;
+		header->dirMtimeNsec[i] = found ? (uint64_t) st.st_mtim.tv_nsec : 0;
+	}
+	return true;
+}
+
+// function that appends a string to a compiled script as its length, its bytes and a NUL byte
+// the NUL byte lets the string be used in place once the file is mapped
+// returns false if an error occurs
+bool compiledAppendString(char **buffer, size_t *length, size_t *capacity, const char *str, size_t strLength) {
+	uint32_t encodedLength = (uint32_t) strLength;
+	return strAppend(buffer, length, capacity, (const char *) &encodedLength, sizeof(uint32_t)) &&
+		strAppend(buffer, length, capacity, str, strLength) && strAppend(buffer, length, capacity, "", 1);
+}
+
+// function that returns the string at offset in a mapped compiled script and moves offset past it
+// returns NULL if the string does not fit in the file, so a truncated file is never read past its end
+const char* compiledReadString(const char *data, size_t size, size_t *offset, uint32_t *strLength) {
+	uint32_t length = 0;
+	if (size - *offset < sizeof(uint32_t)) {
+		return NULL;
+	}
+	memcpy(&length, data + *offset, sizeof(uint32_t));
+	if (size - *offset - sizeof(uint32_t) < (size_t) length + 1 || data[*offset + sizeof(uint32_t) + length] != '\0') {
+		return NULL;
+	}
+	const char *str = data + *offset + sizeof(uint32_t);
+	*offset += sizeof(uint32_t) + length + 1;
+	if (strLength != NULL) {
+		*strLength = length;
+	}
+	return str;
+}
+
+// function that compiles a script into a file that batch mode and source run without tokenizing it again
+// every line becomes a record: the tokens of a command, or the text of a line that belongs to a function or a loop
+// the names of the programs are found now and stored with their paths, and the file is stamped so it can be checked later
+// the file is written next to a temporary name and renamed, so a script that is running never sees it half written
+// returns false if an error occurs
+bool compileScript(const char *scriptPath) {
+	compiledHeader header;
+	memset(&header, 0, sizeof(compiledHeader));
+	memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+	if (compiledStamps(scriptPath, &header) == false) {
+		perror(scriptPath);
+		return false;
+	}
+
+	// read the whole script, keeping the stamps from before it was read
+	size_t scriptLength = 0;
+	char *script = readScript(scriptPath, &scriptLength);
+	bool ok = script != NULL;
+	int fd = -1;
+
+	// compile one line at a time, following the blocks like blockLine() does so their lines are kept as text
+	char *records = NULL;
+	size_t recordsLength = 0;
+	size_t recordsCapacity = 0;
+	char **programs = NULL;
+	size_t numOfPrograms = 0;
+	blockType openBlock = 0;
+	for (size_t start = 0; ok && start < scriptLength; header.numOfRecords++) {
+		size_t lineLength = strcspn(script + start, "\n");
+		char *line = strndup(script + start, lineLength);
+		start += lineLength + 1;
+		uint64_t lineEnd = start > scriptLength ? scriptLength : start;
+		if (line == NULL) {
+			perror("strndup");
+			ok = false;
+			break;
+		}
+
+		// a line inside a block, or one that starts a block, is stored as text
+		size_t nameStart = 0;
+		size_t nameLength = 0;
+		size_t wordsStart = 0;
+		size_t wordsLength = 0;
+		bool needsDo = false;
+		size_t headerLength = 0;
+		if (openBlock == 0 && (headerLength = functionHeaderLength(line, &nameStart, &nameLength)) > 0) {
+			openBlock = FUNCTION_BLOCK;
+		} else if (openBlock == 0 && (headerLength = loopHeaderLength(line, &nameStart, &nameLength, &wordsStart, &wordsLength, &needsDo)) > 0) {
+			openBlock = LOOP_BLOCK;
+		}
+		if (openBlock != 0) {
+			uint32_t type = COMPILED_LINE;
+			ok = strAppend(&records, &recordsLength, &recordsCapacity, (const char *) &type, sizeof(uint32_t)) &&
+				strAppend(&records, &recordsLength, &recordsCapacity, (const char *) &lineEnd, sizeof(uint64_t)) &&
+				compiledAppendString(&records, &recordsLength, &recordsCapacity, line, lineLength);
+			if (!needsDo && blockEnd(line + headerLength, openBlock == FUNCTION_BLOCK ? "}" : "done") != -1) {
+				openBlock = 0;
+			}
+			line = Free(line);
+			continue;
+		}
+
+		// any other line is stored as its tokens, which are empty for an empty line
+		size_t numOfTokens = 0;
+		char **tokens = tokenizeCommand(line, &numOfTokens);
+		line = Free(line);
+		uint32_t type = COMPILED_TOKENS;
+		uint32_t count = (uint32_t) numOfTokens;
+		ok = strAppend(&records, &recordsLength, &recordsCapacity, (const char *) &type, sizeof(uint32_t)) &&
+			strAppend(&records, &recordsLength, &recordsCapacity, (const char *) &lineEnd, sizeof(uint64_t)) &&
+			strAppend(&records, &recordsLength, &recordsCapacity, (const char *) &count, sizeof(uint32_t));
+		for (size_t i = 0; ok && i < numOfTokens; i++) {
+			ok = compiledAppendString(&records, &recordsLength, &recordsCapacity, tokens[i], strlen(tokens[i]));
+		}
+
+		// remember the program names, skipping the assignments before the first one
+		size_t first = 0;
+		while (first < numOfTokens && isAssignment(tokens[first])) {
+			first++;
+		}
+		for (size_t i = first; ok && i < numOfTokens; i++) {
+			if (!isProgramName(tokens, i, first) || strchr(tokens[i], '$') != NULL || strchr(tokens[i], '/') != NULL || isBuiltIn(tokens[i])) {
+				continue;
+			}
+			bool known = false;
+			for (size_t j = 0; !known && j < numOfPrograms; j++) {
+				known = strcmp(programs[j], tokens[i]) == 0;
+			}
+			char **grown = known ? programs : realloc(programs, sizeof(char *) * (numOfPrograms + 1));
+			if (grown == NULL || (!known && (grown[numOfPrograms] = strdup(tokens[i])) == NULL)) {
+				perror("malloc");
+				ok = false;
+				programs = grown == NULL ? programs : grown;
+				break;
+			}
+			programs = grown;
+			numOfPrograms += known ? 0 : 1;
+		}
+		tokens = freeStrTokens(tokens, numOfTokens);
+	}
+	script = Free(script);
+
+	// add the table of program paths after the records, leaving out the programs that are not found
+	header.recordsOffset = sizeof(compiledHeader);
+	header.programsOffset = header.recordsOffset + recordsLength;
+	for (size_t i = 0; ok && i < numOfPrograms; i++) {
+		char *fullPath = findProgramPath(programs[i]);
+		if (fullPath != NULL) {
+			ok = compiledAppendString(&records, &recordsLength, &recordsCapacity, programs[i], strlen(programs[i])) &&
+				compiledAppendString(&records, &recordsLength, &recordsCapacity, fullPath, strlen(fullPath));
+			header.numOfPrograms++;
+		}
+		fullPath = Free(fullPath);
+	}
+	programs = freeArrayOfStrings(programs, numOfPrograms);
+
+	// write the header and the records to a temporary file and rename it over the compiled script
+	char *path = ok ? compiledScriptPath(scriptPath) : NULL;
+	char *temporaryPath = NULL;
+	size_t temporaryLength = 0;
+	size_t temporaryCapacity = 0;
+	char pid[32];
+	snprintf(pid, sizeof(pid), ".%ld", (long) getpid());
+	ok = path != NULL && strAppend(&temporaryPath, &temporaryLength, &temporaryCapacity, path, strlen(path)) &&
+		strAppend(&temporaryPath, &temporaryLength, &temporaryCapacity, pid, strlen(pid));
+	fd = ok ? open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640) : -1;
+	if (ok && (fd == -1 || writeAll(fd, (const char *) &header, sizeof(compiledHeader)) == -1 || writeAll(fd, records, recordsLength) == -1 ||
+		close(fd) == -1 || rename(temporaryPath, path) == -1)) {
+		perror(path);
+		if (fd != -1) {
+			unlink(temporaryPath);
+		}
+		ok = false;
+	}
+	records = Free(records);
+	path = Free(path);
+	temporaryPath = Free(temporaryPath);
+	return ok;
+}
+
+// function that maps the compiled form of a script, compiling it again if the script or a search directory has changed
+// returns the mapping and sets size, or returns NULL if the script has no compiled form or it can not be used
+const char* mapCompiledScript(const char *scriptPath, size_t *size) {
+	char *path = compiledScriptPath(scriptPath);
+	if (path == NULL) {
+		return NULL;
+	}
+
+	// a script is only run from its compiled form after it was compiled with --compile
+	for (int attempt = 0; attempt < 2; attempt++) {
+		statsAdd(STATS_OPEN, 1);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1) {
+			break;
+		}
+		struct stat st;
+		const char *data = fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(compiledHeader) ? MAP_FAILED :
+			mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		// the compiled script is valid if it has the magic and the same stamps as the script and the directories now
+		compiledHeader stamps;
+		memset(&stamps, 0, sizeof(compiledHeader));
+		memcpy(stamps.magic, COMPILED_MAGIC, sizeof(stamps.magic));
+		if (data != MAP_FAILED && compiledStamps(scriptPath, &stamps)) {
+			compiledHeader header;
+			memcpy(&header, data, sizeof(compiledHeader));
+			stamps.numOfRecords = header.numOfRecords;
+			stamps.numOfPrograms = header.numOfPrograms;
+			stamps.recordsOffset = header.recordsOffset;
+			stamps.programsOffset = header.programsOffset;
+			if (memcmp(&stamps, &header, sizeof(compiledHeader)) == 0 && header.programsOffset <= (uint64_t) st.st_size) {
+				path = Free(path);
+				*size = (size_t) st.st_size;
+				return data;
+			}
+		}
+		if (data != MAP_FAILED) {
+			munmap((void *) data, (size_t) st.st_size);
+		}
+
+		// the compiled script is stale, so compile it again and map the new one
+		if (attempt == 1 || compileScript(scriptPath) == false) {
+			break;
+		}
+	}
+	path = Free(path);
+	return NULL;
+}
+
+// function that runs a script from its compiled form
+// the program paths are looked up in the table of the file while it runs, and every record is run like a line of the script
+// if followInput, then stdin is the script, and it is moved past the line of each record before the record runs, like inputLoop() does.
+// the records of the lines that a program read from stdin are skipped, and if it stopped in the middle of a line, then the rest of
+// the script can only run from its text, so this returns false with stdin left where the program stopped
+// returns false if the script has no usable compiled form, in which case nothing was run
+bool runCompiledScript(const char *scriptPath, bool followInput) {
+	size_t size = 0;
+	const char *data = mapCompiledScript(scriptPath, &size);
+	if (data == NULL) {
+		return false;
+	}
+	compiledHeader header;
+	memcpy(&header, data, sizeof(compiledHeader));
+
+	// build the table of program paths, which points into the mapping
+	compiledProgramTable table = {NULL, 0};
+	size_t offset = (size_t) header.programsOffset;
+	size_t capacity = 16;
+	while (capacity < 2 * header.numOfPrograms) {
+		capacity *= 2;
+	}
+	table.slots = calloc(capacity, sizeof(compiledProgram));
+	if (table.slots == NULL) {
+		perror("calloc");
+		munmap((void *) data, size);
+		return false;
+	}
+	table.capacity = capacity;
+	for (uint64_t i = 0; i < header.numOfPrograms; i++) {
+		uint32_t nameLength = 0;
+		const char *name = compiledReadString(data, size, &offset, &nameLength);
+		const char *fullPath = name == NULL ? NULL : compiledReadString(data, size, &offset, NULL);
+		if (fullPath == NULL) {
+			break;
+		}
+		size_t j = strHash(name, nameLength) & (capacity - 1);
+		while (table.slots[j].name != NULL) {
+			j = (j + 1) & (capacity - 1);
+		}
+		table.slots[j].name = name;
+		table.slots[j].path = fullPath;
+	}
+	compiledProgramTable callerTable = compiledPrograms;
+	compiledPrograms = table;
+
+	// run every record, as tokens or as a line of a block
+	offset = (size_t) header.recordsOffset;
+	off_t lineStart = 0;
+	bool finished = true;
+	for (uint64_t i = 0; i < header.numOfRecords && offset < (size_t) header.programsOffset; i++) {
+		uint32_t type = 0;
+		uint32_t count = 0;
+		uint64_t lineEnd = 0;
+		if (size - offset < sizeof(uint32_t) + sizeof(uint64_t)) {
+			break;
+		}
+		memcpy(&type, data + offset, sizeof(uint32_t));
+		memcpy(&lineEnd, data + offset + sizeof(uint32_t), sizeof(uint64_t));
+		offset += sizeof(uint32_t) + sizeof(uint64_t);
+
+		// a program that read stdin took the lines up to where it stopped, so their records are skipped,
+		// and if it stopped in the middle of a line, then the rest of the script is left to the text input loops
+		if (followInput) {
+			off_t inputOffset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+			if ((off_t) lineEnd <= inputOffset) {
+				offset = compiledSkipRecord(data, size, offset, type);
+				lineStart = (off_t) lineEnd;
+				continue;
+			}
+			if (inputOffset != lineStart) {
+				finished = false;
+				break;
+			}
+			lseek(STDIN_FILENO, (off_t) lineEnd, SEEK_SET);
+			lineStart = (off_t) lineEnd;
+		}
+		if (type == COMPILED_LINE) {
+			uint32_t lineLength = 0;
+			const char *line = compiledReadString(data, size, &offset, &lineLength);
+			if (line == NULL) {
+				break;
+			}
+			char *command = strndup(line, lineLength);
+			if (command == NULL) {
+				perror("strndup");
+				exit_status = 1;
+				continue;
+			}
+			parseCommand(command);
+			continue;
+		}
+		if (size - offset < sizeof(uint32_t)) {
+			break;
+		}
+		memcpy(&count, data + offset, sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+		if (count == 0) {
+			exit_status = 0;
+			continue;
+		}
+
+		// copy the tokens, because running a command frees them
+		char **tokens = malloc(sizeof(char *) * ((size_t) count + 1));
+		size_t numOfTokens = 0;
+		while (tokens != NULL && numOfTokens < count) {
+			uint32_t tokenLength = 0;
+			const char *token = compiledReadString(data, size, &offset, &tokenLength);
+			if (token == NULL || (tokens[numOfTokens] = strndup(token, tokenLength)) == NULL) {
+				tokens = freeStrTokens(tokens, numOfTokens);
+				break;
+			}
+			numOfTokens++;
+		}
+		if (tokens == NULL) {
+			write(STDERR_FILENO, "mysh: compiled script is damaged\n", 33);
+			exit_status = 1;
+			break;
+		}
+		tokens[numOfTokens] = NULL;
+
+		// a block that is still open gets the tokens as a line, in case the file and the blocks disagree
+		if (block.name != NULL) {
+			char *command = NULL;
+			size_t length = 0;
+			size_t lineCapacity = 0;
+			for (size_t j = 0; j < numOfTokens; j++) {
+				if (!strAppend(&command, &length, &lineCapacity, j == 0 ? "" : " ", j == 0 ? 0 : 1) || !strAppend(&command, &length, &lineCapacity, tokens[j], strlen(tokens[j]))) {
+					command = Free(command);
+					break;
+				}
+			}
+			tokens = freeStrTokens(tokens, numOfTokens);
+			if (command != NULL) {
+				parseCommand(command);
+			}
+			continue;
+		}
+
+		// the line was tokenized when the script was compiled
+		lastParseNanos = 0;
+		runTokens(tokens, numOfTokens);
+		allocPhaseSet(ALLOC_OTHER);
+	}
+	compiledPrograms = callerTable;
+	table.slots = Free(table.slots);
+	munmap((void *) data, size);
+	return finished;
+}
+
+// function that returns the offset just past the rest of a record of a mapped compiled script, which starts at offset after its type and line end
+// returns size if the record does not fit in the file, which ends the records
+size_t compiledSkipRecord(const char *data, size_t size, size_t offset, uint32_t type) {
+	uint32_t count = 1;
+	if (type == COMPILED_TOKENS) {
+		if (size - offset < sizeof(uint32_t)) {
+			return size;
+		}
+		memcpy(&count, data + offset, sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (compiledReadString(data, size, &offset, NULL) == NULL) {
+			return size;
+		}
+	}
+	return offset;
+}
+
+// function that returns the path that the running compiled script stored for a program name, or NULL if it has none
+const char* compiledProgramPath(const char *program) {
+	if (compiledPrograms.capacity == 0) {
+		return NULL;
+	}
+	size_t mask = compiledPrograms.capacity - 1;
+	for (size_t i = strHash(program, strlen(program)) & mask; compiledPrograms.slots[i].name != NULL; i = (i + 1) & mask) {
+		if (strcmp(compiledPrograms.slots[i].name, program) == 0) {
+			return compiledPrograms.slots[i].path;
+		}
+	}
+	return NULL;
+}
+
+// function that runs the commands of a script in the current shell, from its compiled form if it has one
+// "source file" and ". file" both call this
+void sourceCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+	if (numOfArgs != 2) {
+		write(STDERR_FILENO, "source: expected one file\n", 26);
+		exit_status = 1;
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+	if (sourceDepth == MAX_SOURCE_DEPTH) {
+		write(STDERR_FILENO, "source: maximum depth exceeded\n", 31);
+		exit_status = 1;
+		args = freeArrayOfStrings(args, numOfArgs);
+		return;
+	}
+
+	// run the compiled form, or otherwise read the script and run one line at a time
+	sourceDepth++;
+	profilePush(args[1]);
+	exit_status = 0;
+	if (runCompiledScript(args[1], false) == false) {
+		size_t length = 0;
+		char *script = readScript(args[1], &length);
+		if (script == NULL) {
+			exit_status = 1;
+		} else {
+			for (size_t start = 0; start < length; ) {
+				size_t lineLength = strcspn(script + start, "\n");
+				char *command = strndup(script + start, lineLength);
+				start += lineLength + 1;
+				if (command == NULL) {
+					perror("strndup");
+					exit_status = 1;
+					break;
+				}
+				parseCommand(command);
+			}
+		}
+		script = Free(script);
+	}
+	profilePop();
+	sourceDepth--;
+	args = freeArrayOfStrings(args, numOfArgs);
+}
+
+// function that starts the front end of batch mode, which reads the script from offset with pread() so that the offset of stdin stays where the shell is
+// a front-end thread is only started if there is more than one CPU, since otherwise it can only run when the shell and its programs do not
+// the search directories are watched with inotify, so that the program paths found ahead are discarded when a program is added or removed
+// returns false if the front end can not be started
+bool frontEndStart(off_t offset) {
+	memset(&front, 0, sizeof(frontEnd));
+	front.watchFd = -1;
+	front.generation = 1;
+	front.chunk = malloc(sizeof(char) * FRONT_END_CHUNK);
+	if (front.chunk == NULL) {
+		return false;
+	}
+	frontEndSeek(offset);
+	front.running = true;
+
+	// the environment variable MYSH_BATCH_SERIAL prepares every line in the shell, like a single CPU does
+	// and MYSH_BATCH_THREADED starts the front-end thread even with a single CPU
+	if (getenv("MYSH_BATCH_SERIAL") != NULL || (getenv("MYSH_BATCH_THREADED") == NULL && sysconf(_SC_NPROCESSORS_ONLN) < 2)) {
+		return true;
+	}
+
+	// if a search directory can not be watched, then the front-end thread only tokenizes the lines
+	front.watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	for (size_t i = 0; front.watchFd != -1 && i < NUM_SEARCH_DIRS; i++) {
+		if (inotify_add_watch(front.watchFd, searchDirs[i], IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) == -1) {
+			close(front.watchFd);
+			front.watchFd = -1;
+		}
+	}
+
+	// if the thread can not be started, then the shell prepares the lines itself
+	pthread_mutex_init(&front.lock, NULL);
+	pthread_cond_init(&front.ready, NULL);
+	pthread_cond_init(&front.space, NULL);
+	front.threaded = pthread_create(&front.thread, NULL, frontEndThread, NULL) == 0;
+	if (!front.threaded) {
+		pthread_cond_destroy(&front.ready);
+		pthread_cond_destroy(&front.space);
+		pthread_mutex_destroy(&front.lock);
+		if (front.watchFd != -1) {
+			close(front.watchFd);
+			front.watchFd = -1;
+		}
+	}
+	return true;
+}
+
+// function that runs in the front-end thread, reading and preparing the lines of the script into the queue
+// once the queue is full it waits until the shell has taken half of it, so it does not wake up for every line
+// after the end of the script, it waits until the shell restarts or stops it
+void* frontEndThread(void *arg) {
+	(void) arg;
+	traceThreadName("front end");
+	size_t generation = front.generation;
+	bool atEnd = false;
+
+	pthread_mutex_lock(&front.lock);
+	while (!front.stop) {
+		// after a restart, start over where the shell is
+		if (generation != front.generation) {
+			generation = front.generation;
+			frontEndSeek(front.offset);
+			atEnd = false;
+		}
+		if (atEnd || front.count == FRONT_END_LINES) {
+			pthread_cond_wait(&front.space, &front.lock);
+			continue;
+		}
+		pthread_mutex_unlock(&front.lock);
+
+		preparedLine p;
+		frontEndRead(&p);
+
+		// queue the line unless the shell has discarded the lines of this generation in the meantime
+		pthread_mutex_lock(&front.lock);
+		if (generation != front.generation || front.stop) {
+			freePreparedLine(&p);
+			continue;
+		}
+		front.lines[(front.head + front.count) % FRONT_END_LINES] = p;
+		front.count++;
+		atEnd = p.line == NULL;
+		pthread_cond_signal(&front.ready);
+	}
+	pthread_mutex_unlock(&front.lock);
+	return NULL;
+}
+
+// function that makes the front end read the script from offset, dropping what is left of its chunk
+void frontEndSeek(off_t offset) {
+	front.chunkStart = 0;
+	front.chunkLength = 0;
+	front.readOffset = offset;
+}
+
+// function that reads the next line of the script, up to a newline or the end of the script, and prepares it
+// at the end of the script, the line is NULL. if the script can not be read, then error is set to errno
+void frontEndRead(preparedLine *p) {
+	memset(p, 0, sizeof(preparedLine));
+	char *line = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	while (true) {
+		char *start = front.chunk + front.chunkStart;
+		char *newline = memchr(start, '\n', front.chunkLength - front.chunkStart);
+		size_t take = newline == NULL ? front.chunkLength - front.chunkStart : (size_t) (newline - start);
+		if (strAppend(&line, &length, &capacity, start, take) == false) {
+			p->error = ENOMEM;
+			break;
+		}
+		front.chunkStart += newline == NULL ? take : take + 1;
+		if (newline != NULL) {
+			break;
+		}
+		statsAdd(STATS_READ, 1);
+		ssize_t numRead = pread(STDIN_FILENO, front.chunk, FRONT_END_CHUNK, front.readOffset);
+		if (numRead == -1) {
+			p->error = errno;
+			break;
+		}
+		front.chunkStart = 0;
+		front.chunkLength = (size_t) numRead;
+		front.readOffset += numRead;
+		if (numRead == 0) {
+			break;
+		}
+	}
+	p->end = front.readOffset - (off_t) (front.chunkLength - front.chunkStart);
+
+	// the end of the script is reached when nothing is left to read, otherwise the line is prepared even if it is empty
+	if (p->error != 0 || (length == 0 && front.chunkLength == 0)) {
+		line = Free(line);
+		return;
+	}
+	prepareLine(p, line == NULL ? strdup("") : line);
+}
+
+// function that prepares a line without touching the state of the shell, so the front-end thread can run it
+// the line is tokenized unless it starts a function or a loop, and the program names that are plain words are found in the search directories
+// aliases, functions and expansions are left to runTokens(), which only looks up the paths of the names that are still programs when it gets to them
+void prepareLine(preparedLine *p, char *line) {
+	p->line = line;
+	if (line == NULL) {
+		p->error = ENOMEM;
+		return;
+	}
+	size_t nameStart = 0;
+	size_t nameLength = 0;
+	size_t wordsStart = 0;
+	size_t wordsLength = 0;
+	bool needsDo = false;
+	p->header = functionHeaderLength(line, &nameStart, &nameLength) > 0 ||
+		loopHeaderLength(line, &nameStart, &nameLength, &wordsStart, &wordsLength, &needsDo) > 0;
+	if (p->header) {
+		return;
+	}
+
+	// the tokenizer marks the stream operators in the string it is given, so it gets a copy
+	struct timespec parseStart;
+	clock_gettime(CLOCK_MONOTONIC, &parseStart);
+	char *copy = strdup(line);
+	if (copy == NULL) {
+		return;
+	}
+	traceCommand(line);
+	long long traceStart = traceNow();
+	p->tokens = tokenizeCommand(copy, &p->numOfTokens);
+	copy = Free(copy);
+	p->parseNanos = elapsedNanos(&parseStart);
+	traceSpan("parse", "tokenizeCommand", traceStart);
+	PROBE3(parse, line, p->numOfTokens, p->parseNanos);
+	if (p->tokens == NULL || front.watchFd == -1) {
+		return;
+	}
+	p->programs = malloc(sizeof(char *) * p->numOfTokens);
+	p->paths = malloc(sizeof(char *) * p->numOfTokens);
+	if (p->programs == NULL || p->paths == NULL) {
+		p->programs = Free(p->programs);
+		p->paths = Free(p->paths);
+		return;
+	}
+
+	// the program names are the first token after the assignments and the tokens that follow a pipe
+	for (size_t i = 0; i < p->numOfTokens; i++) {
+		if (!isProgramName(p->tokens, i, 0)) {
+			continue;
+		}
+		while (i == 0 && i + 1 < p->numOfTokens && isAssignment(p->tokens[i])) {
+			i++;
+		}
+		const char *program = p->tokens[i];
+		bool found = false;
+		for (size_t j = 0; j < p->numOfPrograms; j++) {
+			found = found || strcmp(p->programs[j], program) == 0;
+		}
+		if (found || strpbrk(program, "/$~{*?[=|<>") != NULL || isBuiltIn(program)) {
+			continue;
+		}
+		traceStart = traceNow();
+		char *path = searchProgramPath(program);
+		traceProgramSpan("resolve", "searchProgramPath", traceStart, -1, -1, -1, -1, program);
+		char *name = path == NULL ? NULL : strdup(program);
+		if (name == NULL) {
+			path = Free(path);
+			continue;
+		}
+		p->programs[p->numOfPrograms] = name;
+		p->paths[p->numOfPrograms] = path;
+		p->numOfPrograms++;
+	}
+}
+
+// function that takes the next prepared line, waiting for the front-end thread if the queue is empty
+// the thread is woken up when half of the queue has been taken. without a thread, the line is prepared here
+void frontEndNext(preparedLine *p) {
+	if (!front.threaded) {
+		frontEndRead(p);
+		return;
+	}
+	pthread_mutex_lock(&front.lock);
+	while (front.count == 0) {
+		pthread_cond_wait(&front.ready, &front.lock);
+	}
+	*p = front.lines[front.head];
+	front.head = (front.head + 1) % FRONT_END_LINES;
+	front.count--;
+	if (front.count == FRONT_END_LINES / 2) {
+		pthread_cond_signal(&front.space);
+	}
+	pthread_mutex_unlock(&front.lock);
+}
+
+// function that discards the prepared lines and makes the front end start over at offset
+void frontEndRestart(off_t offset) {
+	if (!front.threaded) {
+		frontEndSeek(offset);
+		return;
+	}
+	pthread_mutex_lock(&front.lock);
+	for (; front.count > 0; front.count--) {
+		freePreparedLine(&front.lines[front.head]);
+		front.head = (front.head + 1) % FRONT_END_LINES;
+	}
+	front.head = 0;
+	front.offset = offset;
+	front.generation++;
+	pthread_cond_signal(&front.space);
+	pthread_mutex_unlock(&front.lock);
+}
+
+// function that stops the front-end thread and frees the lines it has prepared, if the front end was started
+void frontEndStop() {
+	if (!front.running) {
+		return;
+	}
+	front.running = false;
+	if (front.threaded) {
+		pthread_mutex_lock(&front.lock);
+		front.stop = true;
+		pthread_cond_signal(&front.space);
+		pthread_mutex_unlock(&front.lock);
+		pthread_join(front.thread, NULL);
+		for (; front.count > 0; front.count--) {
+			freePreparedLine(&front.lines[front.head]);
+			front.head = (front.head + 1) % FRONT_END_LINES;
+		}
+		pthread_cond_destroy(&front.ready);
+		pthread_cond_destroy(&front.space);
+		pthread_mutex_destroy(&front.lock);
+		front.threaded = false;
+	}
+	freePreparedLine(&front.current);
+	front.chunk = Free(front.chunk);
+	if (front.watchFd != -1) {
+		close(front.watchFd);
+		front.watchFd = -1;
+	}
+}
+
+// function that frees a prepared line
+void freePreparedLine(preparedLine *p) {
+	p->line = Free(p->line);
+	if (p->tokens != NULL) {
+		p->tokens = freeStrTokens(p->tokens, p->numOfTokens);
+	}
+	if (p->programs != NULL) {
+		p->programs = freeArrayOfStrings(p->programs, p->numOfPrograms);
+		p->paths = freeArrayOfStrings(p->paths, p->numOfPrograms);
+	}
+	p->numOfTokens = 0;
+	p->numOfPrograms = 0;
+}
+
+// function that returns whether a program was added to or removed from a search directory since the last call
+// the events are only counted, so they are read until none are left
+bool searchDirsChanged() {
+	if (front.watchFd == -1) {
+		return false;
+	}
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	while (read(front.watchFd, events, sizeof(events)) > 0) {
+		changed = true;
+	}
+	return changed;
+}
+
+// function that returns the path that the front-end thread found for a program name of the line that is running
+// returns NULL if the front end did not find it
+const char* preparedProgramPath(const char *program) {
+	for (size_t i = 0; i < front.current.numOfPrograms; i++) {
+		if (strcmp(front.current.programs[i], program) == 0) {
+			return front.current.paths[i];
+		}
+	}
+	return NULL;
+}
+
+// input loop for batch mode, which runs the lines that the front end has prepared
+// stdin is moved to the end of each line before it runs, so a program that reads stdin gets the rest of the script like before,
+// and if it reads some of it, then the lines that were prepared ahead are discarded and the front end starts over after what it read
+// returns if the front end can not be started, like when the script is a pipe, in which case inputLoop() reads the script
+void pipelinedInputLoop() {
+	off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+	if (offset == -1 || frontEndStart(offset) == false) {
+		return;
+	}
+	preparedLine *p = &front.current;
+	while (true) {
+		profileStartLine(offset);
+		frontEndNext(p);
+
+		// if the script could not be read, then print error and exit
+		if (p->error != 0) {
+			errno = p->error;
+			perror("read");
+			frontEndStop();
+			exit(EXIT_FAILURE);
+		}
+
+		// at the end of the script, exit unless lines were added to the script since the front end read its end
+		if (p->line == NULL) {
+			struct stat st;
+			if (fstat(STDIN_FILENO, &st) == 0 && st.st_size > p->end) {
+				frontEndRestart(p->end);
+				continue;
+			}
+			lseek(STDIN_FILENO, p->end, SEEK_SET);
+			exitCommand();
+		}
+		lseek(STDIN_FILENO, p->end, SEEK_SET);
+		profileLineText(p->line);
+
+		// a line of a function or a loop is read by blockLine(), and the other lines run from their tokens
+		if (p->header || block.name != NULL) {
+			char *line = p->line;
+			p->line = NULL;
+			if (blockLine(line) == false) {
+				parseCommand(line);
+			}
+		} else if (p->tokens == NULL) {
+			exit_status = 0;
+		} else {
+			char **tokens = p->tokens;
+			p->tokens = NULL;
+			reportRecord record;
+			reportBegin(&record, p->line, NULL, 0);
+			p->line = Free(p->line);
+			lastParseNanos = p->parseNanos;
+			runTokens(tokens, p->numOfTokens);
+			allocPhaseSet(ALLOC_OTHER);
+			reportEnd(&record);
+		}
+
+		// a program that read stdin, or a change to the search directories, makes the prepared lines wrong
+		offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+		if (offset != p->end || searchDirsChanged()) {
+			frontEndRestart(offset);
+		}
+		freePreparedLine(p);
+	}
+}
+
+// function that returns whether the token at index is a program name, which is the first token (after the assignments, which end at first),
+// a token that follows a pipe, or the token that follows "time" at the start of the command
+bool isProgramName(char **tokens, size_t index, size_t first) {
+	return index == first || strcmp(tokens[index - 1], "|") == 0 || (index == first + 1 && strcasecmp(tokens[first], "time") == 0);
+}
+
+// function that returns the number of nanoseconds since a time of CLOCK_MONOTONIC
+long long elapsedNanos(const struct timespec *since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long) (now.tv_sec - since->tv_sec) * 1000000000LL + (now.tv_nsec - since->tv_nsec);
+}
+
+// function that ends a step of a timed command, adding the time since the last step ended to nanos
+// if nanos is NULL, then the time since the last step is not counted, like the time that an earlier command of a function ran
+void timingLap(long long *nanos) {
+	if (!timing.active) {
+		return;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (nanos != NULL) {
+		*nanos += (long long) (now.tv_sec - timing.lap.tv_sec) * 1000000000LL + (now.tv_nsec - timing.lap.tv_nsec);
+	}
+	timing.lap = now;
+}
+
+// function that runs a command that starts with "time", and prints how long each of its programs and each step of the shell took to stderr
+// if expand is true, then the rest of the command runs through runTokens(), otherwise it has been expanded and is only executed
+// the tokens are not freed. a "time" inside a timed command, like in a function that is timed, does not print a breakdown of its own
+void timeCommand(char **tokens, size_t numOfTokens, bool expand) {
+	bool outer = !timing.active;
+	struct timespec start;
+	struct rusage shellBefore;
+	if (outer) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		getrusage(RUSAGE_SELF, &shellBefore);
+		timing.active = true;
+		timing.recordStages = true;
+		timing.lap = start;
+		timing.parseNanos = expand ? lastParseNanos : 0;
+		timing.expandNanos = 0;
+		timing.globNanos = 0;
+		timing.resolveNanos = 0;
+		timing.numOfStages = 0;
+	}
+
+	// run the rest of the command. "time" on its own only measures the shell
+	exit_status = 0;
+	runRestOfCommand(tokens, numOfTokens, 1, expand);
+
+	if (outer) {
+		timingReport(&start, &shellBefore);
+		timing.active = false;
+		freeTiming();
+	}
+}
+
+// function that adds a program that a timed command started to its stages
+void timingStarted(pid_t pid, const char *programPath, const struct timespec *started, long long execNanos) {
+	if (timing.numOfStages == timing.capacity) {
+		size_t capacity = timing.capacity == 0 ? 4 : timing.capacity * 2;
+		timedStage *stages = realloc(timing.stages, sizeof(timedStage) * capacity);
+		if (stages == NULL) {
+			perror("realloc");
+			return;
+		}
+		timing.stages = stages;
+		timing.capacity = capacity;
+	}
+	timedStage *stage = &timing.stages[timing.numOfStages];
+	memset(stage, 0, sizeof(timedStage));
+	stage->pid = pid;
+	stage->program = strdup(programPath);
+	stage->started = *started;
+	stage->execNanos = execNanos;
+	stage->realNanos = -1;
+	timing.numOfStages++;
+}
+
+// function that waits for the child process pid, or for any child process if pid is -1, like waitpid()
+// and keeps its resource usage if it is a stage of a timed command
+// returns the pid of the child process, or -1 if an error occurs
+pid_t waitChild(pid_t pid, int *status) {
+	struct rusage usage;
+	profileLap(PROFILE_SPAWN);
+	struct timespec probeStart = {0, 0};
+	if (PROBE_ENABLED(wait)) {
+		clock_gettime(CLOCK_MONOTONIC, &probeStart);
+	}
+	pid = wait4(pid, status, 0, &usage);
+	profileLap(PROFILE_WAIT);
+	if (pid > 0 && PROBE_ENABLED(wait)) {
+		PROBE3(wait, pid, *status, elapsedNanos(&probeStart));
+	}
+	if (pid > 0) {
+		traceChildReaped(pid, *status);
+		profileChildCpu(&usage);
+		reportChildReaped(pid, *status, &usage);
+		monitorChildReaped(pid);
+	}
+	for (size_t i = 0; pid > 0 && timing.active && i < timing.numOfStages; i++) {
+		if (timing.stages[i].pid == pid) {
+			timing.stages[i].realNanos = elapsedNanos(&timing.stages[i].started);
+			timing.stages[i].usage = usage;
+		}
+	}
+	return pid;
+}
+
+// function that prints the breakdown of a timed command to stderr: a line for each program that it started,
+// a line for the steps of the shell and its own CPU time, and a line with the totals
+void timingReport(const struct timespec *start, const struct rusage *shellBefore) {
+	long long realNanos = timing.parseNanos + elapsedNanos(start);
+	struct rusage shellAfter;
+	getrusage(RUSAGE_SELF, &shellAfter);
+	long long shellUser = (shellAfter.ru_utime.tv_sec - shellBefore->ru_utime.tv_sec) * 1000000LL + (shellAfter.ru_utime.tv_usec - shellBefore->ru_utime.tv_usec);
+	long long shellSys = (shellAfter.ru_stime.tv_sec - shellBefore->ru_stime.tv_sec) * 1000000LL + (shellAfter.ru_stime.tv_usec - shellBefore->ru_stime.tv_usec);
+	long long totalUser = shellUser;
+	long long totalSys = shellSys;
+
+	char *report = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char line[512];
+	bool ok = true;
+	for (size_t i = 0; ok && i < timing.numOfStages; i++) {
+		const timedStage *stage = &timing.stages[i];
+		long long user = stage->usage.ru_utime.tv_sec * 1000000LL + stage->usage.ru_utime.tv_usec;
+		long long sys = stage->usage.ru_stime.tv_sec * 1000000LL + stage->usage.ru_stime.tv_usec;
+		totalUser += user;
+		totalSys += sys;
+		int n = snprintf(line, sizeof(line), "time: %zu %s: real %.6fs user %.6fs sys %.6fs maxrss %ldKB faults %ld+%ld ctxsw %ld+%ld exec %.6fs\n",
+			i + 1, stage->program == NULL ? "?" : stage->program, stage->realNanos / 1e9, user / 1e6, sys / 1e6, stage->usage.ru_maxrss,
+			stage->usage.ru_majflt, stage->usage.ru_minflt, stage->usage.ru_nvcsw, stage->usage.ru_nivcsw, stage->execNanos / 1e9);
+		ok = strAppend(&report, &length, &capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+	}
+	int n = snprintf(line, sizeof(line), "time: shell: parse %.6fs expand %.6fs glob %.6fs resolve %.6fs user %.6fs sys %.6fs\n",
+		timing.parseNanos / 1e9, timing.expandNanos / 1e9, timing.globNanos / 1e9, timing.resolveNanos / 1e9, shellUser / 1e6, shellSys / 1e6);
+	ok = ok && strAppend(&report, &length, &capacity, line, (size_t) n);
+	n = snprintf(line, sizeof(line), "time: total: real %.6fs user %.6fs sys %.6fs\n", realNanos / 1e9, totalUser / 1e6, totalSys / 1e6);
+	ok = ok && strAppend(&report, &length, &capacity, line, (size_t) n);
+	if (!ok || writeAll(STDERR_FILENO, report, length) == -1) {
+		perror(ok ? "write" : "malloc");
+	}
+	report = Free(report);
+}
+
+// function that frees the stages of a timed command
+void freeTiming() {
+	for (size_t i = 0; i < timing.numOfStages; i++) {
+		timing.stages[i].program = Free(timing.stages[i].program);
+	}
+	timing.stages = Free(timing.stages);
+	timing.numOfStages = 0;
+	timing.capacity = 0;
+}
+
+// function that runs a command many times and prints statistics of its wall time
+// "bench [-n runs] [-w warmups] [-j] command" runs the command warmups times without measuring it and then runs times,
+// each time through runTokens() like a line of a script, so the expansion, globbing, resolving and spawning are measured as they are used
+// the statistics are printed to stdout as text, or as a line of JSON with -j. runs defaults to 10 and warmups to 1
+void benchCommand(char **tokens, size_t numOfTokens) {
+	// read the options, which end at the first token that is not one
+	long runs = 10;
+	long warmups = 1;
+	bool json = false;
+	size_t first = 1;
+	bool usage = false;
+	while (!usage && first < numOfTokens && tokens[first][0] == '-') {
+		if (strcmp(tokens[first], "-j") == 0) {
+			json = true;
+			first++;
+			continue;
+		}
+		char *end = NULL;
+		long value = first + 1 < numOfTokens ? strtol(tokens[first + 1], &end, 10) : -1;
+		usage = end == NULL || *end != '\0' || value < 0;
+		if (strcmp(tokens[first], "-n") == 0) {
+			runs = value;
+		} else if (strcmp(tokens[first], "-w") == 0) {
+			warmups = value;
+		} else {
+			usage = true;
+		}
+		first += 2;
+	}
+	if (usage || first >= numOfTokens || runs < 1 || runs > BENCH_MAX_RUNS || warmups > BENCH_MAX_RUNS) {
+		write(STDERR_FILENO, "bench: usage: bench [-n runs] [-w warmups] [-j] command\n", 56);
+		exit_status = 1;
+		return;
+	}
+	if (timing.active) {
+		write(STDERR_FILENO, "bench: can not run inside time or bench\n", 40);
+		exit_status = 1;
+		return;
+	}
+
+	// run the command, keeping the wall time and the time of the shell of every measured run
+	// runs and warmups are at most BENCH_MAX_RUNS, so neither the size of wall nor warmups + runs can overflow
+	long long *wall = malloc(sizeof(long long) * (size_t) runs);
+	if (wall == NULL) {
+		perror("malloc");
+		exit_status = 1;
+		return;
+	}
+	long long parseNanos = lastParseNanos;
+	long long expandNanos = 0;
+	long long globNanos = 0;
+	long long resolveNanos = 0;
+	long failed = 0;
+	for (long i = 0; i < warmups + runs; i++) {
+		char **copy = malloc(sizeof(char *) * (numOfTokens - first + 1));
+		size_t numOfCopies = 0;
+		while (copy != NULL && first + numOfCopies < numOfTokens && (copy[numOfCopies] = strdup(tokens[first + numOfCopies])) != NULL) {
+			numOfCopies++;
+		}
+		if (copy == NULL || first + numOfCopies < numOfTokens) {
+			perror("malloc");
+			copy = copy == NULL ? NULL : freeStrTokens(copy, numOfCopies);
+			failed = -1;
+			break;
+		}
+		copy[numOfCopies] = NULL;
+
+		timing.active = true;
+		timing.recordStages = false;
+		timing.expandNanos = 0;
+		timing.globNanos = 0;
+		timing.resolveNanos = 0;
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		runTokens(copy, numOfCopies);
+		long long nanos = elapsedNanos(&start);
+		timing.active = false;
+		if (i < warmups) {
+			continue;
+		}
+		wall[i - warmups] = nanos + parseNanos;
+		expandNanos += timing.expandNanos;
+		globNanos += timing.globNanos;
+		resolveNanos += timing.resolveNanos;
+		failed += exit_status != 0 ? 1 : 0;
+	}
+	if (failed == -1) {
+		wall = Free(wall);
+		exit_status = 1;
+		return;
+	}
+
+	// the percentiles are the nearest rank in the sorted times
+	qsort(wall, (size_t) runs, sizeof(long long), compareNanos);
+	double sum = 0;
+	for (long i = 0; i < runs; i++) {
+		sum += (double) wall[i];
+	}
+	double mean = sum / runs;
+	double squares = 0;
+	for (long i = 0; i < runs; i++) {
+		squares += ((double) wall[i] - mean) * ((double) wall[i] - mean);
+	}
+	double stddev = sqrt(squares / runs);
+	double median = wall[(runs + 1) / 2 - 1];
+	double p90 = wall[(runs * 90 + 99) / 100 - 1];
+	double p99 = wall[(runs * 99 + 99) / 100 - 1];
+	double shell = parseNanos + (double) (expandNanos + globNanos + resolveNanos) / runs;
+	double share = mean > 0 ? shell / mean : 0;
+
+	// print the statistics in seconds
+	char *command = strCombineTokens(tokens + first, numOfTokens - first, " ");
+	char *report = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char line[512];
+	bool ok = command != NULL;
+	if (ok && json) {
+		ok = strAppend(&report, &length, &capacity, "{\"command\":", 11) && strAppendJson(&report, &length, &capacity, command);
+		int n = snprintf(line, sizeof(line), ",\"runs\":%ld,\"warmups\":%ld,\"failed\":%ld,\"min\":%.9f,\"median\":%.9f,\"p90\":%.9f,\"p99\":%.9f,\"max\":%.9f,\"mean\":%.9f,\"stddev\":%.9f,"
+			"\"shell\":{\"parse\":%.9f,\"expand\":%.9f,\"glob\":%.9f,\"resolve\":%.9f,\"share\":%.6f}}\n",
+			runs, warmups, failed, wall[0] / 1e9, median / 1e9, p90 / 1e9, p99 / 1e9, wall[runs - 1] / 1e9, mean / 1e9, stddev / 1e9,
+			parseNanos / 1e9, expandNanos / 1e9 / runs, globNanos / 1e9 / runs, resolveNanos / 1e9 / runs, share);
+		ok = ok && strAppend(&report, &length, &capacity, line, (size_t) n);
+	} else if (ok) {
+		int n = snprintf(line, sizeof(line), "bench: %ld runs after %ld warm-up: ", runs, warmups);
+		ok = strAppend(&report, &length, &capacity, line, (size_t) n) && strAppend(&report, &length, &capacity, command, strlen(command));
+		n = snprintf(line, sizeof(line), "\nbench: min %.6fs median %.6fs p90 %.6fs p99 %.6fs max %.6fs mean %.6fs stddev %.6fs\n"
+			"bench: shell %.2f%% per run: parse %.6fs expand %.6fs glob %.6fs resolve %.6fs, %ld failed\n",
+			wall[0] / 1e9, median / 1e9, p90 / 1e9, p99 / 1e9, wall[runs - 1] / 1e9, mean / 1e9, stddev / 1e9,
+			share * 100, parseNanos / 1e9, expandNanos / 1e9 / runs, globNanos / 1e9 / runs, resolveNanos / 1e9 / runs, failed);
+		ok = ok && strAppend(&report, &length, &capacity, line, (size_t) n);
+	}
+	if (!ok || writeAll(STDOUT_FILENO, report, length) == -1) {
+		perror(ok ? "write" : "malloc");
+	}
+	exit_status = !ok || failed > 0 ? 1 : 0;
+	report = Free(report);
+	command = Free(command);
+	wall = Free(wall);
+}
+
+// function that compares two times in nanoseconds for qsort()
+int compareNanos(const void *a, const void *b) {
+	long long x = *(const long long *) a;
+	long long y = *(const long long *) b;
+	return x < y ? -1 : x > y;
+}
+
+// function that takes the options that start with "--" out of the arguments of the shell, so that checkArgs() only sees the script
+// "--trace=file.json" records spans of the shell and writes them to file.json as trace-event JSON when the shell exits
+// "--profile" prints where the time of each script line went when the shell exits, and "--profile=file" also writes it to file as collapsed stacks
+// "--report=fd" or "--report=file" logs every command as a line of JSON to the descriptor fd or to file
+// "--self-profile" samples the stack of the shell itself and writes it to mysh.stacks as collapsed stacks when the shell exits, or to file with "--self-profile=file"
+// "--compile" is left where it is, since it is followed by the script it compiles
+void takeOptions(int *argc, char **argv) {
+	int kept = 1;
+	for (int i = 1; i < *argc; i++) {
+		if (strncmp(argv[i], "--trace=", 8) == 0) {
+			traceOpen(argv[i] + 8);
+		} else if (strncmp(argv[i], "--report=", 9) == 0) {
+			reportOpen(argv[i] + 9);
+		} else if (strcmp(argv[i], "--profile") == 0 || strncmp(argv[i], "--profile=", 10) == 0) {
+			profileOpen(argv[i][9] == '=' ? argv[i] + 10 : NULL);
+		} else if (strcmp(argv[i], "--self-profile") == 0 || strncmp(argv[i], "--self-profile=", 15) == 0) {
+			selfProfileOpen(argv[i][14] == '=' ? argv[i] + 15 : "mysh.stacks");
+		} else {
+			argv[kept++] = argv[i];
+		}
+	}
+	argv[kept] = NULL;
+	*argc = kept;
+}
+
+// function that starts recording the trace of the shell, which is written to path when the shell exits
+// the file is opened now, so that a path that can not be written is reported before anything runs
+void traceOpen(const char *path) {
+	if (trace.fd != -1) {
+		close(trace.fd);
+	}
+	trace.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+	if (trace.fd == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	if (!trace.enabled && pthread_key_create(&trace.key, NULL) != 0) {
+		write(STDERR_FILENO, "trace: can not create a thread key\n", 35);
+		exit(EXIT_FAILURE);
+	}
+	trace.enabled = true;
+	trace.shellPid = getpid();
+	clock_gettime(CLOCK_MONOTONIC, &trace.origin);
+}
+
+// function that returns the number of nanoseconds since the trace started, or 0 if the shell is not traced
+long long traceNow() {
+	return trace.enabled ? elapsedNanos(&trace.origin) : 0;
+}
+
+// function that returns the ring buffer of the calling thread, which is allocated the first time the thread records a span
+// the buffers are kept in a list until the shell exits, so the spans of a thread that has ended are written too
+// returns NULL if the buffer can not be allocated, in which case the span is not recorded
+traceBuffer* traceLocalBuffer() {
+	traceBuffer *b = pthread_getspecific(trace.key);
+	if (b != NULL) {
+		return b;
+	}
+	b = calloc(1, sizeof(traceBuffer));
+	traceEvent *events = b == NULL ? NULL : malloc(sizeof(traceEvent) * TRACE_RING_EVENTS);
+	if (events == NULL) {
+		b = Free(b);
+		return NULL;
+	}
+	b->events = events;
+	b->tid = (pid_t) syscall(SYS_gettid);
+	b->threadName = b->tid == trace.shellPid ? "shell" : "thread";
+	pthread_setspecific(trace.key, b);
+	pthread_mutex_lock(&trace.lock);
+	b->nextBuffer = trace.buffers;
+	trace.buffers = b;
+	pthread_mutex_unlock(&trace.lock);
+	return b;
+}
+
+// function that names the track of the calling thread in the trace
+void traceThreadName(const char *name) {
+	traceBuffer *b = trace.enabled ? traceLocalBuffer() : NULL;
+	if (b != NULL) {
+		b->threadName = name;
+	}
+}
+
+// function that records a span from start until now in the buffer of the calling thread, with the line that the thread is working on
+// returns the span so that the caller can add the details of a program, or NULL if the shell is not traced
+traceEvent* traceRecord(const char *category, const char *name, long long start) {
+	traceBuffer *b = trace.enabled ? traceLocalBuffer() : NULL;
+	if (b == NULL) {
+		return NULL;
+	}
+	traceEvent *e = &b->events[b->next];
+	b->next = (b->next + 1) % TRACE_RING_EVENTS;
+	if (b->count < TRACE_RING_EVENTS) {
+		b->count++;
+	} else {
+		b->dropped++;
+	}
+	e->category = category;
+	e->name = name;
+	e->start = start;
+	e->duration = traceNow() - start;
+	e->track = b->tid;
+	e->pid = -1;
+	e->stage = -1;
+	e->stdInFd = -1;
+	e->stdOutFd = -1;
+	e->status = -1;
+	strcpy(e->command, b->command);
+	e->program[0] = '\0';
+	return e;
+}
+
+// function that records a span of the shell from start until now
+void traceSpan(const char *category, const char *name, long long start) {
+	traceRecord(category, name, start);
+}
+
+// function that records a span about a program from start until now, with its pid, its stage in the pipeline and its descriptors
+void traceProgramSpan(const char *category, const char *name, long long start, pid_t pid, int stage, int stdInFd, int stdOutFd, const char *program) {
+	traceEvent *e = traceRecord(category, name, start);
+	if (e == NULL) {
+		return;
+	}
+	e->pid = pid;
+	e->stage = stage;
+	e->stdInFd = stdInFd;
+	e->stdOutFd = stdOutFd;
+	snprintf(e->program, TRACE_PROGRAM_SIZE, "%s", program == NULL ? "" : program);
+}
+
+// function that ends a step of the shell like timingLap(), recording a span from the end of the last step until now
+// if name is NULL, then only the start of the next step is set
+void traceLap(const char *category, const char *name) {
+	traceBuffer *b = trace.enabled ? traceLocalBuffer() : NULL;
+	if (b == NULL) {
+		return;
+	}
+	traceEvent *e = name == NULL ? NULL : traceRecord(category, name, b->lap);
+	b->lap = e == NULL ? traceNow() : e->start + e->duration;
+}
+
+// function that sets the line that the calling thread is working on, which the spans it records carry
+void traceCommand(const char *line) {
+	traceBuffer *b = trace.enabled ? traceLocalBuffer() : NULL;
+	if (b != NULL) {
+		snprintf(b->command, TRACE_DETAIL_SIZE, "%s", line);
+	}
+}
+
+// function that sets the line that the calling thread is working on from its tokens, separated by spaces
+void traceCommandTokens(char **tokens, size_t numOfTokens) {
+	traceBuffer *b = trace.enabled ? traceLocalBuffer() : NULL;
+	if (b == NULL) {
+		return;
+	}
+	b->command[0] = '\0';
+	size_t length = 0;
+	for (size_t i = 0; i < numOfTokens && length + 1 < TRACE_DETAIL_SIZE; i++) {
+		int n = snprintf(b->command + length, TRACE_DETAIL_SIZE - length, i == 0 ? "%s" : " %s", tokens[i]);
+		length += n < 0 ? TRACE_DETAIL_SIZE : (size_t) n;
+	}
+}
+
+// function that remembers a program that the shell has forked, until waitChild() reaps it
+void traceChildStarted(pid_t pid, long long start, int stage, int stdInFd, int stdOutFd, const char *program) {
+	if (!trace.enabled) {
+		return;
+	}
+	if (trace.numOfChildren == trace.capacity) {
+		size_t capacity = trace.capacity == 0 ? 4 : trace.capacity * 2;
+		traceChild *children = realloc(trace.children, sizeof(traceChild) * capacity);
+		if (children == NULL) {
+			return;
+		}
+		trace.children = children;
+		trace.capacity = capacity;
+	}
+	traceBuffer *b = traceLocalBuffer();
+	traceChild *child = &trace.children[trace.numOfChildren++];
+	child->pid = pid;
+	child->start = start;
+	child->stage = stage;
+	child->stdInFd = stdInFd;
+	child->stdOutFd = stdOutFd;
+	snprintf(child->command, TRACE_DETAIL_SIZE, "%s", b == NULL ? "" : b->command);
+	snprintf(child->program, TRACE_PROGRAM_SIZE, "%s", program);
+}
+
+// function that records the lifetime of a child that has been reaped, from fork() until now, on a track of its own
+void traceChildReaped(pid_t pid, int status) {
+	for (size_t i = 0; trace.enabled && i < trace.numOfChildren; i++) {
+		traceChild *child = &trace.children[i];
+		if (child->pid != pid) {
+			continue;
+		}
+		traceEvent *e = traceRecord("child", NULL, child->start);
+		if (e != NULL) {
+			e->track = pid;
+			e->pid = pid;
+			e->stage = child->stage;
+			e->stdInFd = child->stdInFd;
+			e->stdOutFd = child->stdOutFd;
+			e->status = status;
+			strcpy(e->command, child->command);
+			strcpy(e->program, child->program);
+		}
+		trace.children[i] = trace.children[--trace.numOfChildren];
+		return;
+	}
+}
+
+// function that writes the spans of every thread to the trace file as trace-event JSON, which chrome://tracing and Perfetto open, and frees the trace
+// the spans of each thread are written from the oldest to the newest, and the tracks of the threads are named
+// a forked child never gets here, since it either runs execve() or exits with _exit()
+void traceWrite() {
+	if (!trace.enabled || getpid() != trace.shellPid) {
+		return;
+	}
+	char *json = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char line[256];
+	int n = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"mysh\"}}",
+		(long) trace.shellPid, (long) trace.shellPid);
+	bool ok = strAppend(&json, &length, &capacity, line, (size_t) n);
+	for (traceBuffer *b = trace.buffers; ok && b != NULL; b = b->nextBuffer) {
+		n = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\",\"dropped\":%zu}}",
+			(long) trace.shellPid, (long) b->tid, b->threadName, b->dropped);
+		ok = strAppend(&json, &length, &capacity, line, (size_t) n);
+		for (size_t i = 0; ok && i < b->count; i++) {
+			ok = traceAppendEvent(&json, &length, &capacity, &b->events[(b->next + TRACE_RING_EVENTS - b->count + i) % TRACE_RING_EVENTS]);
+
+			// the JSON is written in pieces, so a long trace does not have to fit in memory twice
+			if (ok && length >= FRONT_END_CHUNK) {
+				ok = writeAll(trace.fd, json, length) != -1;
+				length = 0;
+			}
+		}
+	}
+	ok = ok && strAppend(&json, &length, &capacity, "\n]}\n", 4) && writeAll(trace.fd, json, length) != -1;
+	if (!ok) {
+		perror("trace");
+	}
+	json = Free(json);
+
+	// free the buffers of the threads and the children that were not reaped
+	close(trace.fd);
+	trace.fd = -1;
+	while (trace.buffers != NULL) {
+		traceBuffer *b = trace.buffers;
+		trace.buffers = b->nextBuffer;
+		b->events = Free(b->events);
+		b = Free(b);
+	}
+	trace.children = Free(trace.children);
+	trace.numOfChildren = 0;
+	trace.capacity = 0;
+	pthread_key_delete(trace.key);
+	trace.enabled = false;
+}
+
+// function that appends a span to a buffer as a line of trace-event JSON, starting with a comma since the process name comes first
+// the times are in microseconds, as the format wants. the lifetime of a child also names its track after its pid and program
+// returns false if an error occurs
+bool traceAppendEvent(char **buffer, size_t *length, size_t *capacity, const traceEvent *e) {
+	const char *program = strrchr(e->program, '/') == NULL ? e->program : strrchr(e->program, '/') + 1;
+	char line[256];
+	int n = 0;
+	if (e->name == NULL) {
+		n = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"pid %ld\"}}",
+			(long) trace.shellPid, (long) e->track, (long) e->pid);
+		if (!strAppend(buffer, length, capacity, line, (size_t) n)) {
+			return false;
+		}
+	}
+	bool ok = strAppend(buffer, length, capacity, ",\n{\"name\":", 10) && strAppendJson(buffer, length, capacity, e->name == NULL ? program : e->name);
+	n = snprintf(line, sizeof(line), ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{\"command\":",
+		e->category, e->start / 1e3, e->duration / 1e3, (long) trace.shellPid, (long) e->track);
+	ok = ok && strAppend(buffer, length, capacity, line, (size_t) n) && strAppendJson(buffer, length, capacity, e->command);
+	if (ok && e->program[0] != '\0') {
+		ok = strAppend(buffer, length, capacity, ",\"program\":", 11) && strAppendJson(buffer, length, capacity, e->program);
+	}
+
+	// only the details that the span has are added
+	n = 0;
+	if (e->pid != -1) {
+		n += snprintf(line + n, sizeof(line) - n, ",\"pid\":%ld", (long) e->pid);
+	}
+	if (e->stage != -1) {
+		n += snprintf(line + n, sizeof(line) - n, ",\"stage\":%d", e->stage);
+	}
+	if (e->stdInFd != -1) {
+		n += snprintf(line + n, sizeof(line) - n, ",\"stdin\":%d", e->stdInFd);
+	}
+	if (e->stdOutFd != -1) {
+		n += snprintf(line + n, sizeof(line) - n, ",\"stdout\":%d", e->stdOutFd);
+	}
+	if (e->status != -1) {
+		n += snprintf(line + n, sizeof(line) - n, WIFEXITED(e->status) ? ",\"exit\":%d" : ",\"signal\":%d",
+			WIFEXITED(e->status) ? WEXITSTATUS(e->status) : WTERMSIG(e->status));
+	}
+	n += snprintf(line + n, sizeof(line) - n, "}}");
+	return ok && strAppend(buffer, length, capacity, line, (size_t) n);
+}
+
+// function that adds n to a counter of the shell, atomically since the walker and front-end threads count too
+void statsAdd(statsCounter counter, uint64_t n) {
+	__atomic_fetch_add(&stats.counters[counter], n, __ATOMIC_RELAXED);
+}
+
+// function that returns the bucket of a latency histogram that a number of nanoseconds falls into
+// a value below 8 is its own bucket, and otherwise its highest bit picks the power of 2 and the next 3 bits pick one of its 8 buckets
+size_t statsBucket(long long nanos) {
+	uint64_t value = nanos < 0 ? 0 : (uint64_t) nanos;
+	if (value < STATS_SUB_BUCKETS) {
+		return (size_t) value;
+	}
+	size_t highBit = 63 - (size_t) __builtin_clzll(value);
+	return (highBit - 2) * STATS_SUB_BUCKETS + (size_t) ((value >> (highBit - 3)) & (STATS_SUB_BUCKETS - 1));
+}
+
+// function that returns the smallest number of nanoseconds that falls into a bucket of a latency histogram
+long long statsBucketStart(size_t index) {
+	if (index < STATS_SUB_BUCKETS) {
+		return (long long) index;
+	}
+	size_t highBit = index / STATS_SUB_BUCKETS + 2;
+	return (long long) ((uint64_t) (STATS_SUB_BUCKETS + index % STATS_SUB_BUCKETS) << (highBit - 3));
+}
+
+// function that adds a latency to a histogram
+void statsRecord(statsHistogram *h, long long nanos) {
+	h->buckets[statsBucket(nanos)]++;
+	h->count++;
+	h->sum += nanos;
+	if (nanos > h->max) {
+		h->max = nanos;
+	}
+}
+
+// function that returns the latency below which the given fraction of a histogram falls, as the end of the bucket that reaches it
+// the end is never more than the maximum, so the percentiles of a histogram with one value are that value. returns 0 for an empty histogram
+long long statsPercentile(const statsHistogram *h, double fraction) {
+	uint64_t rank = (uint64_t) ceil(fraction * (double) h->count);
+	uint64_t seen = 0;
+	for (size_t i = 0; h->count > 0 && i < STATS_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank && seen > 0) {
+			long long end = i + 1 < STATS_BUCKETS ? statsBucketStart(i + 1) - 1 : h->max;
+			return end < h->max ? end : h->max;
+		}
+	}
+	return 0;
+}
+
+// function that appends a line with the count, mean, percentiles and maximum of a histogram to a buffer
+// if withBuckets is true, then a line is added for every bucket that has a latency in it
+// returns false if an error occurs
+bool statsAppendHistogram(char **buffer, size_t *length, size_t *capacity, const char *name, const statsHistogram *h, bool withBuckets) {
+	char line[256];
+	int n = snprintf(line, sizeof(line), "stats: %s: count %llu mean %.6fs p50 %.6fs p90 %.6fs p99 %.6fs max %.6fs\n", name, (unsigned long long) h->count,
+		h->count == 0 ? 0.0 : h->sum / 1e9 / h->count, statsPercentile(h, 0.5) / 1e9, statsPercentile(h, 0.9) / 1e9, statsPercentile(h, 0.99) / 1e9, h->max / 1e9);
+	bool ok = strAppend(buffer, length, capacity, line, (size_t) n);
+	for (size_t i = 0; ok && withBuckets && i < STATS_BUCKETS; i++) {
+		if (h->buckets[i] == 0) {
+			continue;
+		}
+		n = snprintf(line, sizeof(line), "stats: %s: [%.6fs, %.6fs) %llu\n", name, statsBucketStart(i) / 1e9,
+			i + 1 < STATS_BUCKETS ? statsBucketStart(i + 1) / 1e9 : h->max / 1e9, (unsigned long long) h->buckets[i]);
+		ok = strAppend(buffer, length, capacity, line, (size_t) n);
+	}
+	return ok;
+}
+
+// function that returns a new allocated report of the counters, the peak resident set size of the shell and of its children,
+// and the latency histograms, a line each. returns NULL if an error occurs
+char* statsReport(bool withBuckets, size_t *length) {
+	char *report = NULL;
+	size_t capacity = 0;
+	char line[128];
+	bool ok = true;
+	*length = 0;
+	for (size_t i = 0; ok && i < NUM_STATS_COUNTERS; i++) {
+		int n = snprintf(line, sizeof(line), "stats: %s %llu\n", statsCounterNames[i], (unsigned long long) __atomic_load_n(&stats.counters[i], __ATOMIC_RELAXED));
+		ok = strAppend(&report, length, &capacity, line, (size_t) n);
+	}
+	struct rusage self;
+	struct rusage children;
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+	int n = snprintf(line, sizeof(line), "stats: peak rss %ldKB children %ldKB\n", self.ru_maxrss, children.ru_maxrss);
+	ok = ok && strAppend(&report, length, &capacity, line, (size_t) n);
+	ok = ok && statsAppendHistogram(&report, length, &capacity, "fork to exec", &stats.forkToExec, withBuckets);
+	ok = ok && statsAppendHistogram(&report, length, &capacity, "exec to exit", &stats.execToExit, withBuckets);
+	if (!ok) {
+		report = Free(report);
+	}
+	return report;
+}
+
+// function that prints the counters and latency histograms of the shell to stdout
+// "stats -b" also prints the buckets of the histograms, and "stats -r" sets everything back to 0 after printing it
+void statsCommand(char **tokens, size_t numOfTokens) {
+	// extract program args
+	size_t numOfArgs = 0;
+	char **args = getProgramArgs(tokens, numOfTokens, &numOfArgs);
+	if (args == NULL) {
+		exit_status = 1;
+		return;
+	}
+
+	// read the options, and if any other argument is given, then print an error message to stderr and set exit status to 1
+	bool withBuckets = false;
+	bool reset = false;
+	for (size_t i = 1; i < numOfArgs; i++) {
+		if (strcmp(args[i], "-b") == 0) {
+			withBuckets = true;
+		} else if (strcmp(args[i], "-r") == 0) {
+			reset = true;
+		} else {
+			write(STDERR_FILENO, "stats: usage: stats [-b] [-r]\n", 30);
+			exit_status = 1;
+			args = freeArrayOfStrings(args, numOfArgs);
+			return;
+		}
+	}
+	args = freeArrayOfStrings(args, numOfArgs);
+
+	// print the report
+	size_t length = 0;
+	char *report = statsReport(withBuckets, &length);
+	int stdOutFd = report == NULL ? -1 : openBuiltInStdOut(tokens, numOfTokens);
+	if (report == NULL) {
+		perror("malloc");
+	}
+	exit_status = stdOutFd == -1 || writeAll(stdOutFd, report, length) == -1 ? 1 : 0;
+	if (stdOutFd != -1 && stdOutFd != STDOUT_FILENO && close(stdOutFd) == -1) {
+		perror("close");
+		exit_status = 1;
+	}
+	report = Free(report);
+	// the counters are reset atomically, since the other threads may be adding to them, and only the shell records the histograms
+	if (reset) {
+		for (size_t i = 0; i < NUM_STATS_COUNTERS; i++) {
+			__atomic_store_n(&stats.counters[i], 0, __ATOMIC_RELAXED);
+		}
+		memset(&stats.forkToExec, 0, sizeof(statsHistogram));
+		memset(&stats.execToExit, 0, sizeof(statsHistogram));
+	}
+}
+
+// function that prints the counters and latency histograms of the shell to stderr when it exits, if MYSH_STATS is set
+// so that a script does not have to end with "stats" to be measured, and its own output on stdout is left alone
+void statsDump() {
+	if (getVariable("MYSH_STATS") == NULL) {
+		return;
+	}
+	size_t length = 0;
+	char *report = statsReport(false, &length);
+	if (report == NULL || writeAll(STDERR_FILENO, report, length) == -1) {
+		perror(report == NULL ? "malloc" : "write");
+	}
+	report = Free(report);
+}
+
+// function that starts the profile of the script lines, which is printed to stderr when the shell exits
+// if stacksPath is not NULL, then the profile is also written to it as collapsed stacks, which it is opened for now
+void profileOpen(const char *stacksPath) {
+	if (profile.stacksFd != -1) {
+		close(profile.stacksFd);
+		profile.stacksFd = -1;
+	}
+	if (stacksPath != NULL) {
+		profile.stacksFd = open(stacksPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+		if (profile.stacksFd == -1) {
+			perror("open");
+			exit(EXIT_FAILURE);
+		}
+	}
+	profile.enabled = true;
+	clock_gettime(CLOCK_MONOTONIC, &profile.start);
+	profile.lap = profile.start;
+}
+
+// function that makes the line that starts at offset start of the script the line that the profile charges its time to
+// the line is numbered by counting the newlines since the last line, so the lines that a program read from the script are counted too
+// if start is -1, like when the script is a pipe, then the line is the one after the last line
+void profileStartLine(off_t start) {
+	if (!profile.enabled) {
+		return;
+	}
+	profileLap(PROFILE_SPAWN);
+	if (start == -1) {
+		profile.offsetLine++;
+	} else {
+		if (profile.offsetLine == 0 || start < profile.offset) {
+			profile.offsetLine = 1;
+			profile.offset = 0;
+		}
+		char buffer[4096];
+		while (profile.offset < start) {
+			size_t want = (size_t) (start - profile.offset) < sizeof(buffer) ? (size_t) (start - profile.offset) : sizeof(buffer);
+			ssize_t numRead = pread(STDIN_FILENO, buffer, want, profile.offset);
+			if (numRead <= 0) {
+				break;
+			}
+			for (ssize_t i = 0; i < numRead; i++) {
+				profile.offsetLine += buffer[i] == '\n';
+			}
+			profile.offset += numRead;
+		}
+		profile.offset = start;
+	}
+	profile.line = profile.offsetLine;
+
+	// the lines are kept by their number, so there is room for every line up to this one
+	if (profile.line >= profile.numOfLines) {
+		size_t numOfLines = profile.numOfLines == 0 ? 64 : profile.numOfLines * 2;
+		while (numOfLines <= profile.line) {
+			numOfLines *= 2;
+		}
+		profileLine *lines = realloc(profile.lines, sizeof(profileLine) * numOfLines);
+		if (lines == NULL) {
+			perror("realloc");
+			profile.line = 0;
+			return;
+		}
+		memset(lines + profile.numOfLines, 0, sizeof(profileLine) * (numOfLines - profile.numOfLines));
+		profile.lines = lines;
+		profile.numOfLines = numOfLines;
+	}
+}
+
+// function that keeps the start of the line that the profile charges its time to for the report, the first time the line is read
+void profileLineText(const char *text) {
+	if (!profile.enabled || profile.line >= profile.numOfLines || profile.lines[profile.line].text != NULL) {
+		return;
+	}
+	profile.lines[profile.line].text = strndup(text, 40);
+}
+
+// function that ends a step of the profiled line, adding the time since the last step ended to the step
+// the time is also added to the stack of the functions and sourced scripts that the shell is in
+void profileLap(profilePhase phase) {
+	if (!profile.enabled) {
+		return;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long nanos = (long long) (now.tv_sec - profile.lap.tv_sec) * 1000000000LL + (now.tv_nsec - profile.lap.tv_nsec);
+	profile.lap = now;
+	if (profile.line < profile.numOfLines) {
+		profile.lines[profile.line].nanos[phase] += nanos;
+	}
+	if (profile.depth > 0 && profile.framesLength > 0) {
+		profileStack *stack = profileFindStack(profile.line, profile.frames, profile.framesLength, strHash(profile.frames, profile.framesLength));
+		if (stack != NULL) {
+			stack->nanos[phase] += nanos;
+		}
+	}
+}
+
+// function that counts a command of the profiled line, whose parse step ends here
+void profileCommand() {
+	if (!profile.enabled) {
+		return;
+	}
+	profileLap(PROFILE_PARSE);
+	if (profile.line < profile.numOfLines) {
+		profile.lines[profile.line].runs++;
+	}
+}
+
+// function that adds the CPU time of a program that has been reaped to the profiled line
+void profileChildCpu(const struct rusage *usage) {
+	if (!profile.enabled || profile.line >= profile.numOfLines) {
+		return;
+	}
+	profile.lines[profile.line].childCpuMicros += usage->ru_utime.tv_sec * 1000000LL + usage->ru_utime.tv_usec +
+		usage->ru_stime.tv_sec * 1000000LL + usage->ru_stime.tv_usec;
+}
+
+// function that enters a function or a sourced script, which becomes the innermost frame of the stack of the profiled line
+void profilePush(const char *frame) {
+	if (!profile.enabled) {
+		return;
+	}
+	profileLap(PROFILE_SPAWN);
+	if (profile.depth < MAX_PROFILE_DEPTH) {
+		profile.depths[profile.depth] = profile.framesLength;
+		if ((profile.framesLength > 0 && !strAppend(&profile.frames, &profile.framesLength, &profile.framesCapacity, ";", 1)) ||
+			!strAppend(&profile.frames, &profile.framesLength, &profile.framesCapacity, frame, strlen(frame))) {
+			perror("malloc");
+		}
+	}
+	profile.depth++;
+}
+
+// function that leaves the innermost frame of the stack of the profiled line
+void profilePop() {
+	if (!profile.enabled || profile.depth == 0) {
+		return;
+	}
+	profileLap(PROFILE_SPAWN);
+	profile.depth--;
+	if (profile.depth < MAX_PROFILE_DEPTH && profile.frames != NULL) {
+		profile.framesLength = profile.depths[profile.depth];
+		profile.frames[profile.framesLength] = '\0';
+	}
+}
+
+// function that returns the stack of a line with the given frames, which is added if it is new
+// the stacks are an open-addressing hash table probed linearly like variableTable
+// returns NULL if an error occurs
+profileStack* profileFindStack(size_t line, const char *frames, size_t length, size_t hash) {
+	hash ^= line * 0x9e3779b97f4a7c15ULL;
+
+	// grow the table before it is half full, moving every stack to its slot in the larger table
+	if (2 * (profile.numOfStacks + 1) > profile.stacksCapacity) {
+		size_t capacity = profile.stacksCapacity == 0 ? 64 : profile.stacksCapacity * 2;
+		profileStack *stacks = calloc(capacity, sizeof(profileStack));
+		if (stacks == NULL) {
+			return NULL;
+		}
+		for (size_t i = 0; i < profile.stacksCapacity; i++) {
+			if (profile.stacks[i].frames == NULL) {
+				continue;
+			}
+			size_t j = profile.stacks[i].hash & (capacity - 1);
+			while (stacks[j].frames != NULL) {
+				j = (j + 1) & (capacity - 1);
+			}
+			stacks[j] = profile.stacks[i];
+		}
+		profile.stacks = Free(profile.stacks);
+		profile.stacks = stacks;
+		profile.stacksCapacity = capacity;
+	}
+
+	// probe from the slot of the hash until the stack or an empty slot is found
+	size_t mask = profile.stacksCapacity - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		profileStack *slot = &profile.stacks[i];
+		if (slot->frames == NULL) {
+			slot->frames = strndup(frames, length);
+			if (slot->frames == NULL) {
+				return NULL;
+			}
+			slot->line = line;
+			slot->hash = hash;
+			profile.numOfStacks++;
+			return slot;
+		}
+		if (slot->hash == hash && slot->line == line && strncmp(slot->frames, frames, length) == 0 && slot->frames[length] == '\0') {
+			return slot;
+		}
+	}
+}
+
+// function that compares two profiled lines for qsort(), so that the line that took the most time comes first
+// lines that took the same time stay in the order of their numbers
+int compareProfileLines(const void *a, const void *b) {
+	const profileLine *x = *(const profileLine * const *) a;
+	const profileLine *y = *(const profileLine * const *) b;
+	long long xTotal = 0;
+	long long yTotal = 0;
+	for (size_t i = 0; i < NUM_PROFILE_PHASES; i++) {
+		xTotal += x->nanos[i];
+		yTotal += y->nanos[i];
+	}
+	if (xTotal != yTotal) {
+		return xTotal < yTotal ? 1 : -1;
+	}
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// function that prints the profile to stderr when the shell exits: a line with the totals,
+// and a line for each script line that was read, from the line that took the most time to the least
+// a block is charged to its header, and the lines that a program read from the script are not listed
+// if "--profile=file" was given, then the profile is also written to file as collapsed stacks like "script:12;f;wait 1500",
+// which flamegraph tools read. the value of a stack is in microseconds, and does not include the time of the stacks inside it
+void profileWrite() {
+	if (!profile.enabled) {
+		return;
+	}
+	profileLap(PROFILE_SPAWN);
+	long long realNanos = elapsedNanos(&profile.start);
+
+	// sort the lines that were read, and add up the steps of every line including the end of the script
+	const profileLine **sorted = malloc(sizeof(profileLine *) * (profile.numOfLines + 1));
+	size_t numOfSorted = 0;
+	long long totals[NUM_PROFILE_PHASES] = {0};
+	long long childCpuMicros = 0;
+	uint64_t runs = 0;
+	for (size_t i = 0; sorted != NULL && i < profile.numOfLines; i++) {
+		const profileLine *l = &profile.lines[i];
+		long long total = 0;
+		for (size_t j = 0; j < NUM_PROFILE_PHASES; j++) {
+			totals[j] += l->nanos[j];
+			total += l->nanos[j];
+		}
+		childCpuMicros += l->childCpuMicros;
+		runs += l->runs;
+		if (l->text != NULL || l->runs > 0) {
+			sorted[numOfSorted++] = l;
+		}
+	}
+	if (sorted != NULL) {
+		qsort(sorted, numOfSorted, sizeof(profileLine *), compareProfileLines);
+	}
+
+	// print the totals, the shell time being the steps other than waiting for programs
+	char *report = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	char line[512];
+	long long shellNanos = totals[PROFILE_PARSE] + totals[PROFILE_EXPAND] + totals[PROFILE_SPAWN];
+	int n = snprintf(line, sizeof(line), "profile: %s: real %.6fs, %llu commands on %zu lines, shell %.6fs (%.1f%%), wait %.6fs, child cpu %.6fs\n",
+		profile.script, realNanos / 1e9, (unsigned long long) runs, numOfSorted, shellNanos / 1e9, realNanos > 0 ? 100.0 * shellNanos / realNanos : 0.0,
+		totals[PROFILE_WAIT] / 1e9, childCpuMicros / 1e6);
+	bool ok = sorted != NULL && strAppend(&report, &length, &capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+	n = snprintf(line, sizeof(line), "profile: %6s %8s %10s %10s %10s %10s %10s %10s  %s\n", "line", "runs", "total", "parse", "expand", "spawn", "wait", "child cpu", "command");
+	ok = ok && strAppend(&report, &length, &capacity, line, (size_t) n);
+	for (size_t i = 0; ok && i < numOfSorted; i++) {
+		const profileLine *l = sorted[i];
+		long long total = l->nanos[PROFILE_PARSE] + l->nanos[PROFILE_EXPAND] + l->nanos[PROFILE_SPAWN] + l->nanos[PROFILE_WAIT];
+		n = snprintf(line, sizeof(line), "profile: %6zu %8llu %9.6fs %9.6fs %9.6fs %9.6fs %9.6fs %9.6fs  %s\n", (size_t) (l - profile.lines),
+			(unsigned long long) l->runs, total / 1e9, l->nanos[PROFILE_PARSE] / 1e9, l->nanos[PROFILE_EXPAND] / 1e9, l->nanos[PROFILE_SPAWN] / 1e9,
+			l->nanos[PROFILE_WAIT] / 1e9, l->childCpuMicros / 1e6, l->text == NULL ? "" : l->text);
+		ok = strAppend(&report, &length, &capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+	}
+	if (!ok || writeAll(STDERR_FILENO, report, length) == -1) {
+		perror(ok ? "write" : "malloc");
+	}
+	report = Free(report);
+	sorted = Free(sorted);
+	capacity = 0;
+
+	// write the collapsed stacks, taking the time of the stacks of a line out of the line so that each stack only has its own time
+	length = 0;
+	ok = true;
+	for (size_t i = 0; profile.stacksFd != -1 && ok && i < profile.stacksCapacity; i++) {
+		const profileStack *stack = &profile.stacks[i];
+		for (size_t j = 0; stack->frames != NULL && ok && j < NUM_PROFILE_PHASES; j++) {
+			profile.lines[stack->line].nanos[j] -= stack->nanos[j];
+			if (stack->nanos[j] >= 1000) {
+				n = snprintf(line, sizeof(line), "%s:%zu;%s;%s %lld\n", profile.script, stack->line, stack->frames, profilePhaseNames[j], stack->nanos[j] / 1000);
+				ok = strAppend(&report, &length, &capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+			}
+		}
+	}
+	for (size_t i = 0; profile.stacksFd != -1 && ok && i < profile.numOfLines; i++) {
+		for (size_t j = 0; ok && j < NUM_PROFILE_PHASES; j++) {
+			if (profile.lines[i].nanos[j] >= 1000) {
+				n = snprintf(line, sizeof(line), "%s:%zu;%s %lld\n", profile.script, i, profilePhaseNames[j], profile.lines[i].nanos[j] / 1000);
+				ok = strAppend(&report, &length, &capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+			}
+		}
+	}
+	if (profile.stacksFd != -1 && (!ok || writeAll(profile.stacksFd, report, length) == -1)) {
+		perror(ok ? "write" : "malloc");
+	}
+	report = Free(report);
+
+	// free the profile
+	if (profile.stacksFd != -1) {
+		close(profile.stacksFd);
+		profile.stacksFd = -1;
+	}
+	for (size_t i = 0; i < profile.numOfLines; i++) {
+		profile.lines[i].text = Free(profile.lines[i].text);
+	}
+	for (size_t i = 0; i < profile.stacksCapacity; i++) {
+		profile.stacks[i].frames = Free(profile.stacks[i].frames);
+	}
+	profile.lines = Free(profile.lines);
+	profile.stacks = Free(profile.stacks);
+	profile.frames = Free(profile.frames);
+	profile.enabled = false;
+}
+
+// function that starts the log of the commands, which is written to the descriptor target if it is a number, or otherwise to the file target
+// a descriptor above stderr is closed on exec, so that the programs of the shell do not keep the log open
+void reportOpen(const char *target) {
+	reportClose();
+	bool isFd = target[0] != '\0' && strspn(target, "0123456789") == strlen(target);
+	if (isFd) {
+		reportLog.fd = atoi(target);
+		reportLog.ownsFd = false;
+		if (fcntl(reportLog.fd, F_GETFD) == -1 || (reportLog.fd > STDERR_FILENO && fcntl(reportLog.fd, F_SETFD, FD_CLOEXEC) == -1)) {
+			perror("report");
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		reportLog.fd = open(target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+		reportLog.ownsFd = true;
+		if (reportLog.fd == -1) {
+			perror("open");
+			exit(EXIT_FAILURE);
+		}
+	}
+	reportLog.enabled = true;
+}
+
+// function that starts logging a command, which becomes the innermost command that is running until reportEnd() is called for it
+// the command is line, or otherwise its tokens separated by spaces, like a command of a function or a loop after it has been expanded
+void reportBegin(reportRecord *record, const char *line, char **tokens, size_t numOfTokens) {
+	if (!reportLog.enabled) {
+		return;
+	}
+	memset(record, 0, sizeof(reportRecord));
+	size_t length = 0;
+	size_t capacity = 0;
+	if (line != NULL) {
+		record->command = strdup(line);
+	}
+	for (size_t i = 0; line == NULL && i < numOfTokens; i++) {
+		if ((i > 0 && !strAppend(&record->command, &length, &capacity, " ", 1)) || !strAppend(&record->command, &length, &capacity, tokens[i], strlen(tokens[i]))) {
+			record->command = Free(record->command);
+			break;
+		}
+	}
+	clock_gettime(CLOCK_REALTIME, &record->start);
+	record->parent = reportLog.current;
+	record->depth = record->parent == NULL ? 0 : record->parent->depth + 1;
+	reportLog.current = record;
+}
+
+// function that adds a program that the shell has forked to the innermost command that is running
+void reportChildStarted(pid_t pid, const char *program) {
+	reportRecord *record = reportLog.current;
+	if (!reportLog.enabled || record == NULL) {
+		return;
+	}
+	if (record->numOfStages == record->capacity) {
+		size_t capacity = record->capacity == 0 ? 4 : record->capacity * 2;
+		reportStage *stages = realloc(record->stages, sizeof(reportStage) * capacity);
+		if (stages == NULL) {
+			perror("realloc");
+			return;
+		}
+		record->stages = stages;
+		record->capacity = capacity;
+	}
+	reportStage *stage = &record->stages[record->numOfStages++];
+	stage->pid = pid;
+	stage->program = strdup(program);
+	stage->status = -1;
+}
+
+// function that keeps the status of a program that has been reaped in the command that started it,
+// and adds its resource usage to that command and to the commands that it runs inside
+void reportChildReaped(pid_t pid, int status, const struct rusage *usage) {
+	if (!reportLog.enabled) {
+		return;
+	}
+	reportRecord *record = reportLog.current;
+	reportStage *stage = NULL;
+	while (record != NULL && stage == NULL) {
+		for (size_t i = 0; i < record->numOfStages && stage == NULL; i++) {
+			stage = record->stages[i].pid == pid ? &record->stages[i] : NULL;
+		}
+		record = stage == NULL ? record->parent : record;
+	}
+	if (stage == NULL) {
+		return;
+	}
+	stage->status = status;
+	for (; record != NULL; record = record->parent) {
+		record->userMicros += usage->ru_utime.tv_sec * 1000000LL + usage->ru_utime.tv_usec;
+		record->sysMicros += usage->ru_stime.tv_sec * 1000000LL + usage->ru_stime.tv_usec;
+		record->maxrss = usage->ru_maxrss > record->maxrss ? usage->ru_maxrss : record->maxrss;
+	}
+}
+
+// function that adds a redirection of the innermost command that is running to its bytes
+// a file that stdin is read from counts its size now, and a file that stdout is written to counts its size when the command ends
+void reportRedirect(const char *path, bool isInput) {
+	reportRecord *record = reportLog.current;
+	if (!reportLog.enabled || record == NULL) {
+		return;
+	}
+	if (isInput) {
+		struct stat st;
+		record->bytesIn += stat(path, &st) == 0 ? (long long) st.st_size : 0;
+		return;
+	}
+	char **outputs = realloc(record->outputs, sizeof(char *) * (record->numOfOutputs + 1));
+	if (outputs == NULL) {
+		perror("realloc");
+		return;
+	}
+	record->outputs = outputs;
+	record->outputs[record->numOfOutputs] = strdup(path);
+	if (record->outputs[record->numOfOutputs] != NULL) {
+		record->numOfOutputs++;
+	}
+}
+
+// function that ends a logged command, appending it to the log as a line of JSON like
+// {"command":"ls | wc -l","depth":0,"start":1700000000.000001,"end":1700000000.002001,"exit":0,
+// "stages":[{"program":"/usr/bin/ls","pid":10,"status":0,"signal":0},...],"bytesIn":0,"bytesOut":0,"user":0.001,"sys":0.001,"maxrss":2048}
+// where start and end are seconds since the epoch, and the status of a program is null if it was killed by a signal or not reaped yet
+// the log is written once it is full, and after every command if it goes to stdout or stderr, so that it stays in order with their output
+void reportEnd(reportRecord *record) {
+	if (!reportLog.enabled || reportLog.current != record) {
+		return;
+	}
+	reportLog.current = record->parent;
+	struct timespec end;
+	clock_gettime(CLOCK_REALTIME, &end);
+	long long bytesOut = 0;
+	for (size_t i = 0; i < record->numOfOutputs; i++) {
+		struct stat st;
+		bytesOut += stat(record->outputs[i], &st) == 0 ? (long long) st.st_size : 0;
+	}
+
+	// append the command and its stages to the log
+	char line[256];
+	int n = snprintf(line, sizeof(line), ",\"depth\":%zu,\"start\":%lld.%06ld,\"end\":%lld.%06ld,\"exit\":%zd,\"stages\":[", record->depth,
+		(long long) record->start.tv_sec, record->start.tv_nsec / 1000, (long long) end.tv_sec, end.tv_nsec / 1000, exit_status);
+	bool ok = strAppend(&reportLog.buffer, &reportLog.length, &reportLog.capacity, "{\"command\":", 11) &&
+		strAppendJson(&reportLog.buffer, &reportLog.length, &reportLog.capacity, record->command == NULL ? "" : record->command) &&
+		strAppend(&reportLog.buffer, &reportLog.length, &reportLog.capacity, line, (size_t) n);
+	for (size_t i = 0; ok && i < record->numOfStages; i++) {
+		const reportStage *stage = &record->stages[i];
+		ok = strAppend(&reportLog.buffer, &reportLog.length, &reportLog.capacity, i == 0 ? "{\"program\":" : ",{\"program\":", i == 0 ? 11 : 12) &&
+			strAppendJson(&reportLog.buffer, &reportLog.length, &reportLog.capacity, stage->program == NULL ? "" : stage->program);
+		if (stage->status != -1 && WIFEXITED(stage->status)) {
+			n = snprintf(line, sizeof(line), ",\"pid\":%d,\"status\":%d,\"signal\":0}", (int) stage->pid, WEXITSTATUS(stage->status));
+		} else {
+			n = snprintf(line, sizeof(line), ",\"pid\":%d,\"status\":null,\"signal\":%d}", (int) stage->pid,
+				stage->status != -1 && WIFSIGNALED(stage->status) ? WTERMSIG(stage->status) : 0);
+		}
+		ok = ok && strAppend(&reportLog.buffer, &reportLog.length, &reportLog.capacity, line, (size_t) n);
+	}
+	n = snprintf(line, sizeof(line), "],\"bytesIn\":%lld,\"bytesOut\":%lld,\"user\":%.6f,\"sys\":%.6f,\"maxrss\":%ld}\n",
+		record->bytesIn, bytesOut, record->userMicros / 1e6, record->sysMicros / 1e6, record->maxrss);
+	ok = ok && strAppend(&reportLog.buffer, &reportLog.length, &reportLog.capacity, line, (size_t) n);
+	if (!ok) {
+		perror("malloc");
+	}
+
+	// free the record
+	record->command = Free(record->command);
+	for (size_t i = 0; i < record->numOfStages; i++) {
+		record->stages[i].program = Free(record->stages[i].program);
+	}
+	record->stages = Free(record->stages);
+	record->outputs = freeArrayOfStrings(record->outputs, record->numOfOutputs);
+	if (reportLog.length >= REPORT_BUFFER_SIZE || reportLog.fd <= STDERR_FILENO) {
+		reportFlush();
+	}
+}
+
+// function that writes the lines of the log that have been collected
+void reportFlush() {
+	if (!reportLog.enabled || reportLog.length == 0) {
+		return;
+	}
+	if (writeAll(reportLog.fd, reportLog.buffer, reportLog.length) == -1) {
+		perror("report");
+	}
+	reportLog.length = 0;
+}
+
+// function that ends the log, logging the commands that are still running first, and writes the rest of it
+void reportClose() {
+	while (reportLog.enabled && reportLog.current != NULL) {
+		reportEnd(reportLog.current);
+	}
+	reportFlush();
+	if (reportLog.ownsFd && reportLog.fd != -1) {
+		close(reportLog.fd);
+	}
+	reportLog.buffer = Free(reportLog.buffer);
+	reportLog.capacity = 0;
+	reportLog.fd = -1;
+	reportLog.ownsFd = false;
+	reportLog.enabled = false;
+}
+
+// function that runs the tokens of a command from first on, like "time" and "monitor" run the command that follows them
+// if expand is true, then a copy of them runs through runTokens(), otherwise they have been expanded and are only executed
+void runRestOfCommand(char **tokens, size_t numOfTokens, size_t first, bool expand) {
+	if (first >= numOfTokens) {
+		return;
+	}
+	if (!expand) {
+		executeCommand(tokens + first, numOfTokens - first);
+		return;
+	}
+	size_t numOfRest = numOfTokens - first;
+	char **rest = malloc(sizeof(char *) * (numOfRest + 1));
+	for (size_t i = 0; rest != NULL && i < numOfRest; i++) {
+		rest[i] = strdup(tokens[first + i]);
+		if (rest[i] == NULL) {
+			rest = freeStrTokens(rest, i);
+		}
+	}
+	if (rest == NULL) {
+		perror("malloc");
+		exit_status = 1;
+		return;
+	}
+	rest[numOfRest] = NULL;
+	runTokens(rest, numOfRest);
+}
+
+// function that runs a command that starts with "monitor", and prints a sample of each of its programs to stderr every interval while it runs
+// "monitor [-i seconds] command" samples every second by default. a sample shows the pid, stage, state, CPU%, resident set size,
+// bytes read and written, the bytes waiting in the pipe of its stdin and how full it is, and what it is blocked in
+// if stderr is a terminal, then each sample replaces the last one like top does. the tokens are not freed
+void monitorCommand(char **tokens, size_t numOfTokens, bool expand) {
+	// read the interval, and if it is not a positive number or no command follows, then print the usage
+	size_t first = 1;
+	double interval = 1.0;
+	if (numOfTokens > 2 && strcmp(tokens[1], "-i") == 0) {
+		char *end = NULL;
+		interval = strtod(tokens[2], &end);
+		first = *end != '\0' || !(interval >= 0.01) ? numOfTokens : 3;
+	}
+	if (first >= numOfTokens) {
+		write(STDERR_FILENO, "monitor: usage: monitor [-i seconds] command\n", 45);
+		exit_status = 1;
+		return;
+	}
+
+	// a "monitor" inside a monitored command, like in a function that is monitored, only runs the command
+	if (monitor.active) {
+		runRestOfCommand(tokens, numOfTokens, first, expand);
+		return;
+	}
+
+	// start the thread that samples the programs, and run the command without it if it can not be started
+	pthread_t thread;
+	monitor.active = true;
+	monitor.stop = false;
+	monitor.interval = interval;
+	clock_gettime(CLOCK_MONOTONIC, &monitor.start);
+	bool sampling = pthread_create(&thread, NULL, monitorThread, NULL) == 0;
+	if (!sampling) {
+		write(STDERR_FILENO, "monitor: can not start a thread\n", 32);
+	}
+	exit_status = 0;
+	runRestOfCommand(tokens, numOfTokens, first, expand);
+
+	// stop the thread, and forget the programs that were not reaped
+	if (sampling) {
+		pthread_mutex_lock(&monitor.lock);
+		monitor.stop = true;
+		pthread_cond_signal(&monitor.wake);
+		pthread_mutex_unlock(&monitor.lock);
+		pthread_join(thread, NULL);
+	}
+	monitor.active = false;
+	monitor.children = Free(monitor.children);
+	monitor.numOfChildren = 0;
+	monitor.capacity = 0;
+}
+
+// function that adds a program that the shell has forked to the programs that the monitor samples, if a command is monitored
+void monitorChildStarted(pid_t pid, int stage, const char *program) {
+	if (!monitor.active) {
+		return;
+	}
+	pthread_mutex_lock(&monitor.lock);
+	if (monitor.numOfChildren == monitor.capacity) {
+		size_t capacity = monitor.capacity == 0 ? 4 : monitor.capacity * 2;
+		monitorChild *children = realloc(monitor.children, sizeof(monitorChild) * capacity);
+		if (children == NULL) {
+			pthread_mutex_unlock(&monitor.lock);
+			perror("realloc");
+			return;
+		}
+		monitor.children = children;
+		monitor.capacity = capacity;
+	}
+	monitorChild *child = &monitor.children[monitor.numOfChildren++];
+	child->pid = pid;
+	child->stage = stage;
+	snprintf(child->program, sizeof(child->program), "%s", program);
+	child->ticks = 0;
+	clock_gettime(CLOCK_MONOTONIC, &child->sampled);
+	pthread_mutex_unlock(&monitor.lock);
+}
+
+// function that removes a program that has been reaped from the programs that the monitor samples, keeping the others in the order they started
+void monitorChildReaped(pid_t pid) {
+	if (!monitor.active) {
+		return;
+	}
+	pthread_mutex_lock(&monitor.lock);
+	for (size_t i = 0; i < monitor.numOfChildren; i++) {
+		if (monitor.children[i].pid == pid) {
+			memmove(&monitor.children[i], &monitor.children[i + 1], sizeof(monitorChild) * (monitor.numOfChildren - i - 1));
+			monitor.numOfChildren--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&monitor.lock);
+}
+
+// function that the monitor thread runs: every interval, it copies the list of programs, samples each of them from /proc without holding the lock,
+// prints the samples to stderr, and keeps the CPU time of each program for its next CPU%
+void* monitorThread(void *arg) {
+	(void) arg;
+	bool isTerminal = isatty(STDERR_FILENO);
+	pthread_mutex_lock(&monitor.lock);
+	while (!monitor.stop) {
+		// wait for the interval, or until the command is done
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		long long nanos = deadline.tv_nsec + (long long) (monitor.interval * 1e9);
+		deadline.tv_sec += (time_t) (nanos / 1000000000LL);
+		deadline.tv_nsec = (long) (nanos % 1000000000LL);
+		int waited = 0;
+		while (!monitor.stop && waited != ETIMEDOUT) {
+			waited = pthread_cond_timedwait(&monitor.wake, &monitor.lock, &deadline);
+		}
+		if (monitor.stop) {
+			break;
+		}
+		size_t numOfChildren = monitor.numOfChildren;
+		monitorChild *children = numOfChildren == 0 ? NULL : malloc(sizeof(monitorChild) * numOfChildren);
+		if (children != NULL) {
+			memcpy(children, monitor.children, sizeof(monitorChild) * numOfChildren);
+		}
+		pthread_mutex_unlock(&monitor.lock);
+
+		// sample the programs
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		char *buffer = NULL;
+		size_t length = 0;
+		size_t capacity = 0;
+		char line[256];
+		int n = snprintf(line, sizeof(line), "%smonitor: %.2fs\nmonitor: %7s %5s %-10s %6s %9s %10s %10s %8s %4s  %-18s %s\n", isTerminal ? "\033[H\033[J" : "",
+			elapsedNanos(&monitor.start) / 1e9, "pid", "stage", "state", "cpu%", "rss", "read", "write", "stdin", "fill", "wchan", "program");
+		bool ok = strAppend(&buffer, &length, &capacity, line, (size_t) n);
+		for (size_t i = 0; ok && children != NULL && i < numOfChildren; i++) {
+			ok = monitorAppendChild(&buffer, &length, &capacity, &children[i], &now);
+		}
+		if (!ok || writeAll(STDERR_FILENO, buffer, length) == -1) {
+			perror(ok ? "write" : "malloc");
+		}
+		buffer = Free(buffer);
+
+		// keep the CPU time of the programs that have not been reaped for the next sample
+		pthread_mutex_lock(&monitor.lock);
+		for (size_t i = 0; children != NULL && i < numOfChildren; i++) {
+			for (size_t j = 0; j < monitor.numOfChildren; j++) {
+				if (monitor.children[j].pid == children[i].pid) {
+					monitor.children[j].ticks = children[i].ticks;
+					monitor.children[j].sampled = children[i].sampled;
+				}
+			}
+		}
+		children = Free(children);
+	}
+	pthread_mutex_unlock(&monitor.lock);
+	return NULL;
+}
+
+// function that reads the file name of /proc/pid into buffer, which has MONITOR_FILE_SIZE bytes and ends with a NUL byte
+// returns the number of bytes read, or -1 if the file can not be read, like when the program has been reaped
+ssize_t readProcFile(pid_t pid, const char *name, char *buffer) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/%s", (int) pid, name);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return -1;
+	}
+	ssize_t numRead = read(fd, buffer, MONITOR_FILE_SIZE - 1);
+	close(fd);
+	buffer[numRead == -1 ? 0 : numRead] = '\0';
+	return numRead;
+}
+
+// function that returns the value of the line that starts with name in a /proc file like "VmRSS:\t  1552 kB", after the spaces that follow name
+// returns NULL if the file has no such line
+const char* procField(const char *text, const char *name) {
+	size_t nameLength = strlen(name);
+	for (const char *line = text; line != NULL && *line != '\0'; line = strchr(line, '\n'), line = line == NULL ? NULL : line + 1) {
+		if (strncmp(line, name, nameLength) == 0) {
+			line += nameLength;
+			while (*line == ' ' || *line == '\t') {
+				line++;
+			}
+			return line;
+		}
+	}
+	return NULL;
+}
+
+// function that appends a line with a sample of a program to a buffer, reading its stat, status, io and wchan in /proc
+// and the bytes waiting in the pipe of its stdin with FIONREAD. the CPU% is the CPU time since the last sample of the program
+// a program that has been reaped is left out. returns false if an error occurs
+bool monitorAppendChild(char **buffer, size_t *length, size_t *capacity, monitorChild *child, const struct timespec *now) {
+	char stat[MONITOR_FILE_SIZE];
+	char status[MONITOR_FILE_SIZE];
+	char io[MONITOR_FILE_SIZE];
+	char wchan[MONITOR_FILE_SIZE];
+	const char *fields = readProcFile(child->pid, "stat", stat) > 0 ? strrchr(stat, ')') : NULL;
+	unsigned long long utime = 0;
+	unsigned long long stime = 0;
+	char state = '?';
+	if (fields == NULL || sscanf(fields + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &state, &utime, &stime) != 3) {
+		return true;
+	}
+
+	// the CPU% is the CPU time since the last sample over the time since then
+	long long ticks = (long long) (utime + stime);
+	double seconds = (now->tv_sec - child->sampled.tv_sec) + (now->tv_nsec - child->sampled.tv_nsec) / 1e9;
+	double cpu = seconds > 0 ? 100.0 * (ticks - child->ticks) / sysconf(_SC_CLK_TCK) / seconds : 0.0;
+	child->ticks = ticks;
+	child->sampled = *now;
+
+	// the name of the state, the resident set size and the bytes read and written, which are all the programs read and wrote, pipes included
+	char stateName[16] = "?";
+	const char *value = readProcFile(child->pid, "status", status) > 0 ? procField(status, "State:") : NULL;
+	const char *parenthesis = value == NULL ? NULL : strchr(value, '(');
+	if (parenthesis != NULL) {
+		snprintf(stateName, sizeof(stateName), "%.*s", (int) strcspn(parenthesis + 1, ")"), parenthesis + 1);
+	}
+	value = procField(status, "VmRSS:");
+	long rss = value == NULL ? 0 : strtol(value, NULL, 10);
+	bool hasIo = readProcFile(child->pid, "io", io) > 0;
+	value = hasIo ? procField(io, "rchar:") : NULL;
+	unsigned long long readBytes = value == NULL ? 0 : strtoull(value, NULL, 10);
+	value = hasIo ? procField(io, "wchar:") : NULL;
+	unsigned long long writeBytes = value == NULL ? 0 : strtoull(value, NULL, 10);
+	if (readProcFile(child->pid, "wchan", wchan) <= 0 || strcmp(wchan, "0") == 0) {
+		strcpy(wchan, "-");
+	}
+
+	// if stdin is a pipe, then it is opened through /proc to ask how many bytes wait in it and how many it can hold
+	char path[64];
+	char link[64];
+	char pipeBytes[16] = "-";
+	char pipeFill[16] = "-";
+	snprintf(path, sizeof(path), "/proc/%d/fd/0", (int) child->pid);
+	ssize_t linkLength = readlink(path, link, sizeof(link) - 1);
+	if (linkLength > 5 && strncmp(link, "pipe:", 5) == 0) {
+		int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		int queued = 0;
+		int size = fd == -1 ? -1 : fcntl(fd, F_GETPIPE_SZ);
+		if (fd != -1 && ioctl(fd, FIONREAD, &queued) == 0) {
+			snprintf(pipeBytes, sizeof(pipeBytes), "%d", queued);
+			if (size > 0) {
+				snprintf(pipeFill, sizeof(pipeFill), "%d%%", (int) (100LL * queued / size));
+			}
+		}
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+
+	char line[512];
+	char stage[16] = "-";
+	if (child->stage != -1) {
+		snprintf(stage, sizeof(stage), "%d", child->stage + 1);
+	}
+	int n = snprintf(line, sizeof(line), "monitor: %7d %5s %-10s %6.1f %7ldKB %10llu %10llu %8s %4s  %-18s %s\n", (int) child->pid, stage, stateName,
+		cpu, rss, readBytes, writeBytes, pipeBytes, pipeFill, wchan, child->program);
+	return strAppend(buffer, length, capacity, line, n < (int) sizeof(line) ? (size_t) n : sizeof(line) - 1);
+}
+
+// function that starts sampling the stack of the shell every SELF_PROFILE_MICROS of CPU time that it uses, for "--self-profile"
+// the samples are written to path when the shell exits, which it is opened for now
+// the timer counts the CPU time of every thread of the shell but not of its children, which do not inherit it
+void selfProfileOpen(const char *path) {
+	if (selfProfile.enabled) {
+		return;
+	}
+	selfProfile.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+	selfProfile.samples = calloc(SELF_PROFILE_SAMPLES, sizeof(selfProfileSample));
+	if (selfProfile.fd == -1 || selfProfile.samples == NULL) {
+		perror(selfProfile.fd == -1 ? "open" : "calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	// SA_RESTART restarts the system calls that a sample interrupts, like wait4() and read(), and SA_SIGINFO passes the registers
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = selfProfileSignal;
+	action.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	struct itimerval timer = {{0, SELF_PROFILE_MICROS}, {0, SELF_PROFILE_MICROS}};
+	if (sigaction(SIGPROF, &action, NULL) == -1 || setitimer(ITIMER_PROF, &timer, NULL) == -1) {
+		perror("setitimer");
+		exit(EXIT_FAILURE);
+	}
+	selfProfile.enabled = true;
+}
+
+// function that handles SIGPROF by storing the stack of the thread that was running in the next free sample
+// the stack starts at the interrupted instruction and follows the frame pointers, each read with process_vm_readv(), so a frame pointer
+// that leads nowhere ends the walk with EFAULT instead of a crash. it only makes system calls, which are async-signal-safe,
+// and keeps errno for the code it interrupted. the frames are named by selfProfileWrite() after the timer has stopped
+void selfProfileSignal(int signal, siginfo_t *info, void *context) {
+	(void) signal;
+	(void) info;
+	int savedErrno = errno;
+	size_t index = __atomic_fetch_add(&selfProfile.numOfSamples, 1, __ATOMIC_RELAXED);
+	uintptr_t pc = 0;
+	uintptr_t fp = 0;
+	if (index < SELF_PROFILE_SAMPLES && selfProfileRegisters(context, &pc, &fp)) {
+		selfProfileSample *sample = &selfProfile.samples[index];
+		int depth = 0;
+		sample->frames[depth++] = (void *) pc;
+
+		// every frame starts with the frame pointer of its caller and the address that it returns to, and the callers are higher on the stack
+		uintptr_t words[2];
+		while (depth < SELF_PROFILE_DEPTH && fp != 0 && fp % sizeof(uintptr_t) == 0 && selfProfileRead(fp, words) && words[1] != 0) {
+			sample->frames[depth++] = (void *) words[1];
+			if (words[0] <= fp || words[0] - fp > SELF_PROFILE_MAX_FRAME) {
+				break;
+			}
+			fp = words[0];
+		}
+		__atomic_store_n(&sample->depth, depth, __ATOMIC_RELEASE);
+	}
+	errno = savedErrno;
+}
+
+// function that gets the program counter and the frame pointer of the interrupted code from the context of a signal handler
+// returns false on a machine whose registers are not known here, so its samples stay empty
+bool selfProfileRegisters(const void *context, uintptr_t *pc, uintptr_t *fp) {
+	const ucontext_t *uc = context;
+#if defined(__x86_64__)
+	*pc = (uintptr_t) uc->uc_mcontext.gregs[REG_RIP];
+	*fp = (uintptr_t) uc->uc_mcontext.gregs[REG_RBP];
+	return true;
+#elif defined(__aarch64__)
+	*pc = (uintptr_t) uc->uc_mcontext.pc;
+	*fp = (uintptr_t) uc->uc_mcontext.regs[29];
+	return true;
+#else
+	(void) uc;
+	(void) pc;
+	(void) fp;
+	return false;
+#endif
+}
+
+// function that reads the 2 words at address of the shell's own memory with process_vm_readv(), which fails with EFAULT
+// instead of raising SIGSEGV if the address is not mapped. returns false if they could not be read
+bool selfProfileRead(uintptr_t address, uintptr_t words[2]) {
+	struct iovec local = {words, 2 * sizeof(uintptr_t)};
+	struct iovec remote = {(void *) address, 2 * sizeof(uintptr_t)};
+	return syscall(SYS_process_vm_readv, (long) getpid(), &local, 1UL, &remote, 1UL, 0UL) == (long) (2 * sizeof(uintptr_t));
+}
+
+// function that returns the name of a frame from a symbol of backtrace_symbols() like "./mysh(runTokens+0x4b) [0x5612a0]"
+// a frame without a function name, like one in a library without symbols, is named after its file, like "libc.so.6"
+// the symbol is changed in place, and ";" is replaced since it separates the frames of a collapsed stack
+char* selfProfileFrameName(char *symbol) {
+	char *parenthesis = strchr(symbol, '(');
+	char *end = parenthesis == NULL ? NULL : strpbrk(parenthesis + 1, "+)");
+	char *name = NULL;
+	if (end != NULL && end > parenthesis + 1) {
+		name = parenthesis + 1;
+		*end = '\0';
+	} else {
+		if (parenthesis != NULL) {
+			*parenthesis = '\0';
+		} else {
+			symbol[strcspn(symbol, " ")] = '\0';
+		}
+		char *slash = strrchr(symbol, '/');
+		name = slash == NULL ? symbol : slash + 1;
+	}
+	for (char *c = name; *c != '\0'; c++) {
+		if (*c == ';' || *c == ' ') {
+			*c = '_';
+		}
+	}
+	return name;
+}
+
+// function that stops sampling the shell and writes the samples to the file of "--self-profile" as collapsed stacks
+// each line is the frames of a stack from the outermost to the one that was running, separated by ";", and the number of its samples
+// which flamegraph.pl and speedscope read as they are. the samples that did not fit are printed to stderr
+void selfProfileWrite() {
+	if (!selfProfile.enabled) {
+		return;
+	}
+	selfProfile.enabled = false;
+	struct itimerval timer = {{0, 0}, {0, 0}};
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+
+	// every sample starts with the instruction that was interrupted, and the rest are the return addresses of its callers
+	size_t numOfSamples = __atomic_load_n(&selfProfile.numOfSamples, __ATOMIC_RELAXED);
+	size_t kept = numOfSamples < SELF_PROFILE_SAMPLES ? numOfSamples : SELF_PROFILE_SAMPLES;
+	char **stacks = malloc(sizeof(char *) * (kept + 1));
+	size_t numOfStacks = 0;
+	bool ok = stacks != NULL;
+	for (size_t i = 0; ok && i < kept; i++) {
+		selfProfileSample *sample = &selfProfile.samples[i];
+		int depth = __atomic_load_n(&sample->depth, __ATOMIC_ACQUIRE);
+		char **symbols = depth == 0 ? NULL : backtrace_symbols(sample->frames, depth);
+		char *stack = NULL;
+		size_t length = 0;
+		size_t capacity = 0;
+		for (int j = depth - 1; symbols != NULL && ok && j >= 0; j--) {
+			const char *name = selfProfileFrameName(symbols[j]);
+			ok = (length == 0 || strAppend(&stack, &length, &capacity, ";", 1)) && strAppend(&stack, &length, &capacity, name, strlen(name));
+		}
+		ok = ok && (symbols != NULL || depth == 0);
+		symbols = Free(symbols);
+		if (stack != NULL) {
+			stacks[numOfStacks++] = stack;
+		}
+	}
+
+	// sort the stacks so that the samples of the same stack are next to each other, and write each stack once with its count
+	char *output = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	sortArrayOfStrings(stacks, numOfStacks);
+	for (size_t i = 0; ok && i < numOfStacks; ) {
+		size_t j = i + 1;
+		while (j < numOfStacks && strcmp(stacks[j], stacks[i]) == 0) {
+			j++;
+		}
+		char count[32];
+		int n = snprintf(count, sizeof(count), " %zu\n", j - i);
+		ok = strAppend(&output, &length, &capacity, stacks[i], strlen(stacks[i])) && strAppend(&output, &length, &capacity, count, (size_t) n);
+		i = j;
+	}
+	if (!ok) {
+		perror("malloc");
+	} else if (length > 0 && writeAll(selfProfile.fd, output, length) == -1) {
+		perror("write");
+	}
+	if (numOfSamples > kept) {
+		char line[128];
+		int n = snprintf(line, sizeof(line), "self-profile: %zu of %zu samples did not fit and were dropped\n", numOfSamples - kept, numOfSamples);
+		write(STDERR_FILENO, line, (size_t) n);
+	}
+	output = Free(output);
+	stacks = freeArrayOfStrings(stacks, numOfStacks);
+	selfProfile.samples = Free(selfProfile.samples);
+	close(selfProfile.fd);
+	selfProfile.fd = -1;
 }
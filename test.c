@@ -364,6 +364,53 @@ void program_B_3() {
 	printf("Test Case B_3_BAT passed\n");
 }
 
+// Test Case B_4: a program that reads stdin gets the rest of the input file, and mysh continues after what it read
+void program_B_4() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/B/4/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/B/4/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/B/4/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/B/4/outBAT.txt"
+	// stderr is redirected to stdout
+    system("./mysh testSuite/B/4/myscript.sh > testSuite/B/4/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case B_4_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case B_4_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case B_4_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case B_4_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case B_4_BAT passed\n");
+}
+
 // Test Case C_1 tests:
 // if mysh prints a greeting before the first prompt in Interaction Mode
 // Before reading a command, mysh will write a prompt to stdout to indicate that it is ready to read input (“mysh> ”)
@@ -1882,6 +1929,1068 @@ void program_E_1_INT() {
 	printf("Test Case E_1_INT passed\n");
 }
 
+// Test Case E_2_BAT: In batch mode,
+// a path segment that is exactly ** matches zero or more directories (excluding files and subdirectories
+// that begin with a period), and the matches are listed in sorted order.
+void program_E_2_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/2/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/2/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/2/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/2/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/2/myscript.sh > testSuite/E/2/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_2_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_2_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_2_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_2_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_2_BAT passed\n");
+}
+
+// Test Case E_3_BAT: cmd <* pattern streams the matches of the pattern into stdin, one per line
+void program_E_3_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/3/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/3/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/3/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/3/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/3/myscript.sh > testSuite/E/3/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_3_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_3_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_3_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_3_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_3_BAT passed\n");
+}
+
+// Test Case E_4_BAT: ? and [...] match single characters, and a segment may contain several *
+void program_E_4_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/4/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/4/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/4/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/4/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/4/myscript.sh > testSuite/E/4/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_4_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_4_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_4_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_4_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_4_BAT passed\n");
+}
+
+// Test Case E_5_BAT: {a,b} and {1..N} generate words without reading any directory
+void program_E_5_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/5/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/5/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/5/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/5/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/5/myscript.sh > testSuite/E/5/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_5_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_5_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_5_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_5_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_5_BAT passed\n");
+}
+
+// Test Case E_6_BAT: shell variables, export, prefix assignments and $?
+// the variables are expanded before wildcards, and exported variables reach programs through execve
+void program_E_6_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/6/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/6/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/6/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/6/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/6/myscript.sh > testSuite/E/6/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_6_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_6_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_6_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_6_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_6_BAT passed\n");
+}
+
+// Test Case E_7_BAT: logical working directory, $PWD, $OLDPWD, cd -, pushd, popd and dirs
+// the working directory is remembered by cd, so pwd does not call getcwd()
+void program_E_7_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/7/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/7/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/7/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/7/outBAT.txt"
+	// stderr is redirected to stdout
+	// the directories are printed in full, so HOME is set outside of them and the path of the repository is replaced with ROOT
+	system("HOME=/nonexistent ./mysh testSuite/E/7/myscript.sh 2>&1 | sed \"s|$PWD|ROOT|g\" > testSuite/E/7/outBAT.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_7_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_7_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_7_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_7_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_7_BAT passed\n");
+}
+
+// Test Case E_8_BAT: functions with arguments, calls between functions, and aliases
+// function bodies are parsed once when they are defined
+void program_E_8_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/8/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/8/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/8/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/8/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/8/myscript.sh > testSuite/E/8/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_8_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_8_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_8_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_8_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_8_BAT passed\n");
+}
+
+// Test Case E_9_BAT: for loops over wildcards, braces and words, written on one or several lines
+// the body is parsed once and only the loop variable is substituted in every iteration
+void program_E_9_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/9/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/9/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/9/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/9/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/9/myscript.sh > testSuite/E/9/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_9_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_9_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_9_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_9_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_9_BAT passed\n");
+}
+
+// Test Case E_10_BAT: source and . run a script in this shell, and --compile writes its compiled form
+// batch mode and source run the compiled form, which gives the same output as the script
+void program_E_10_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/10/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/10/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/10/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/10/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/10/myscript.sh > testSuite/E/10/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_10_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_10_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_10_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_10_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_10_BAT passed\n");
+}
+
+// Test Case E_11_BAT: time prints a line for each program and for the steps of the shell to stderr
+// every number of the output is replaced with N, because the times change on every run
+void program_E_11_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/11/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/11/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/11/myscript.sh"
+	// stderr is redirected to stdout, and every number is replaced with N before it is written to "testSuite/E/11/outBAT.txt"
+	system("./mysh testSuite/E/11/myscript.sh 2>&1 | sed -E 's/[0-9]+(\\.[0-9]+)?/N/g' > testSuite/E/11/outBAT.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_11_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_11_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_11_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_11_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_11_BAT passed\n");
+}
+
+// Test Case E_12_BAT: bench prints latency percentiles of a command, as text or as a JSON line
+void program_E_12_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/12/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/12/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/12/myscript.sh"
+	// stderr is redirected to stdout, and every number is replaced with N before it is written to "testSuite/E/12/outBAT.txt"
+	system("./mysh testSuite/E/12/myscript.sh 2>&1 | sed -E 's/[0-9]+(\\.[0-9]+)?/N/g' > testSuite/E/12/outBAT.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_12_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_12_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_12_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_12_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_12_BAT passed\n");
+}
+
+// Test Case E_13_BAT: --trace writes a span for every step of the shell and every child as trace-event JSON
+void program_E_13_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/13/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/13/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/13/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/13/outBAT.txt", and stderr is redirected to stdout
+	// then the name and category of every span in the trace are added to it once each, and the trace is removed
+	// MYSH_BATCH_SERIAL keeps the front end in the shell, so the spans are the same on any number of CPUs
+	system("MYSH_BATCH_SERIAL=1 ./mysh --trace=testSuite/E/13/trace.json testSuite/E/13/myscript.sh > testSuite/E/13/outBAT.txt 2>&1; "
+		"grep -o '\"name\":\"[^\"]*\",\"cat\":\"[^\"]*\"' testSuite/E/13/trace.json | LC_ALL=C sort -u >> testSuite/E/13/outBAT.txt; "
+		"rm -f testSuite/E/13/trace.json");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_13_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_13_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_13_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_13_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_13_BAT passed\n");
+}
+
+// Test Case E_14_BAT: stats command and MYSH_STATS
+void program_E_14_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/14/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/14/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/14/myscript.sh"
+	// stderr is redirected to stdout, and times, sizes and the numbers of system calls are replaced with N before it is written to "testSuite/E/14/outBAT.txt"
+	system("MYSH_STATS=1 MYSH_BATCH_SERIAL=1 ./mysh testSuite/E/14/myscript.sh 2>&1 | sed -E 's/[0-9]+\\.[0-9]+/N/g; s/[0-9]+KB/NKB/g; /(stat|open|read) calls/s/[0-9]+/N/' > testSuite/E/14/outBAT.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_14_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_14_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_14_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_14_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_14_BAT passed\n");
+}
+
+// Test Case E_15_BAT: --profile line profiler
+void program_E_15_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/15/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/15/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/15/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/15/outBAT.txt", and the profile on stderr to "testSuite/E/15/profile.txt"
+	// then the times are replaced with N, and the line that took the most time, every line in the order of their numbers,
+	// and the stacks that waited for a program without their times are added to it. the profile and the stacks are removed
+	system("./mysh --profile=testSuite/E/15/stacks.txt testSuite/E/15/myscript.sh > testSuite/E/15/outBAT.txt 2> testSuite/E/15/profile.txt; "
+		"sed -n 3p testSuite/E/15/profile.txt | sed -E 's/[0-9]+\\.[0-9]+%?s?/N/g' >> testSuite/E/15/outBAT.txt; "
+		"sed -E 's/[0-9]+\\.[0-9]+%?s?/N/g' testSuite/E/15/profile.txt | LC_ALL=C sort -k2,2n >> testSuite/E/15/outBAT.txt; "
+		"grep ';wait ' testSuite/E/15/stacks.txt | sed -E 's/ [0-9]+$//' | LC_ALL=C sort >> testSuite/E/15/outBAT.txt; "
+		"rm -f testSuite/E/15/profile.txt testSuite/E/15/stacks.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_15_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_15_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_15_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_15_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_15_BAT passed\n");
+}
+
+// Test Case E_16_BAT: --report JSONL execution log
+void program_E_16_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/16/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/16/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/16/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/16/outBAT.txt", and stderr is redirected to stdout
+	// then the log is added to it with its times, pids and sizes replaced with N, and the log and the file that the script wrote are removed
+	system("./mysh --report=testSuite/E/16/report.jsonl testSuite/E/16/myscript.sh > testSuite/E/16/outBAT.txt 2>&1; "
+		"sed -E 's/\"(start|end|user|sys)\":[0-9.]+/\"\\1\":N/g; s/\"(pid|maxrss)\":[0-9]+/\"\\1\":N/g' testSuite/E/16/report.jsonl >> testSuite/E/16/outBAT.txt; "
+		"rm -f testSuite/E/16/report.jsonl testSuite/E/16/written.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_16_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_16_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_16_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_16_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_16_BAT passed\n");
+}
+
+// Test Case E_17_BAT: monitor command
+void program_E_17_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/17/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/17/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/17/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/17/outBAT.txt", and stderr to "testSuite/E/17/monitor.txt"
+	// then the stage, state, pipe and program of the first sample are added to it with the numbers replaced with N,
+	// followed by the rest of stderr without the later samples, and "testSuite/E/17/monitor.txt" is removed
+	system("./mysh testSuite/E/17/myscript.sh > testSuite/E/17/outBAT.txt 2> testSuite/E/17/monitor.txt; "
+		"sed -n '1,4p' testSuite/E/17/monitor.txt | awk '{print $1, $3, $4, $9, $10, $12}' | sed -E 's/[0-9]+(\\.[0-9]+)?/N/g' >> testSuite/E/17/outBAT.txt; "
+		"sed -n '5,$p' testSuite/E/17/monitor.txt | grep -v -E '^monitor: ( |[0-9])' >> testSuite/E/17/outBAT.txt; "
+		"rm -f testSuite/E/17/monitor.txt");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_17_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_17_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_17_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_17_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_17_BAT passed\n");
+}
+
+// Test Case E_18_BAT: self-profile
+void program_E_18_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/18/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/18/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with the option "--self-profile=testSuite/E/18/self.stacks" and argument "testSuite/E/18/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/18/outBAT.txt", and stderr to stdout
+	// followed by the number of lines of the stacks file that are not a stack and a count, and whether the loop was sampled
+	system("./mysh --self-profile=testSuite/E/18/self.stacks testSuite/E/18/myscript.sh > testSuite/E/18/outBAT.txt 2>&1; "
+		"grep -c -v -E '^[^ ]+ [0-9]+$' testSuite/E/18/self.stacks >> testSuite/E/18/outBAT.txt; "
+		"grep -q ';runLoop;' testSuite/E/18/self.stacks && echo 'runLoop sampled' >> testSuite/E/18/outBAT.txt; "
+		"rm -f testSuite/E/18/self.stacks");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_18_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_18_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_18_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_18_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_18_BAT passed\n");
+}
+
+// Test Case E_19_BAT: the front-end thread forced on with MYSH_BATCH_THREADED
+// head reads a line of the script, so the prepared lines are discarded
+void program_E_19_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/19/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/19/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/19/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/19/outBAT.txt"
+	// stderr is redirected to stdout
+	// MYSH_BATCH_THREADED starts the front-end thread even on a single CPU
+	system("MYSH_BATCH_THREADED=1 ./mysh testSuite/E/19/myscript.sh > testSuite/E/19/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_19_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_19_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_19_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_19_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_19_BAT passed\n");
+}
+
+// Test Case E_20_BAT: a large argument list that is run in chunks
+// ulimit -s 512 makes ARG_MAX 128KB, so a few thousand arguments are split
+void program_E_20_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/20/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/20/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/20/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/20/outBAT.txt"
+	// stderr is redirected to stdout
+	// a stack limit of 512KB makes ARG_MAX 128KB
+	system("ulimit -s 512; ./mysh testSuite/E/20/myscript.sh > testSuite/E/20/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_20_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_20_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_20_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_20_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_20_BAT passed\n");
+}
+
+// Test Case E_21_BAT: symbolic links matched by a pattern, looked up with io_uring and with the fstatat() fallback
+void program_E_21_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/21/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/21/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/21/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/21/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/21/myscript.sh > testSuite/E/21/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_21_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_21_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_21_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_21_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_21_BAT passed\n");
+}
+
+// Test Case E_22_BAT: the matches of a wildcard are sorted in the byte order that qsort() with strcmp() gave
+// with MYSH_GLOB_NOSORT set they are the same names in the order the walker found them
+void program_E_22_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/22/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/22/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/22/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/22/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/22/myscript.sh > testSuite/E/22/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_22_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_22_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_22_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_22_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_22_BAT passed\n");
+}
+
+// Test Case E_23_BAT: a brace expression with more than 1000000 words is rejected, and so are ranges whose product wraps 64 bits
+void program_E_23_BAT() {
+	// open the out.txt file in read only mode and exp.txt file in read only mode
+	// out.txt will contain the output of the argument passed into mysh
+	// exp.txt will contain the expected output of the argument passed into mysh
+	int fdO = open("testSuite/E/23/outBAT.txt", O_RDONLY);
+	int fdE = open("testSuite/E/23/expBAT.txt", O_RDONLY);
+	if (fdO == -1 || fdE == -1) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	// mysh is called with argument "testSuite/E/23/myscript.sh"
+	// the stdout of the argument is redirected to "testSuite/E/23/outBAT.txt"
+	// stderr is redirected to stdout
+	system("./mysh testSuite/E/23/myscript.sh > testSuite/E/23/outBAT.txt 2>&1");
+	char *lineO = NULL;
+	char *lineE = NULL;
+	while (true) {
+		lineO = readOutput(fdO);
+		lineE = readOutput(fdE);
+		// if the output file (lineO) and expected output (lineE) are both NULL, then break out of the loop 
+		// because they are both empty, thus are equal to each other.
+		if (lineO == NULL && lineE == NULL) {
+			break;
+		}
+		// if only one of the files is NULL, then the files are not equal to each other, thus Test Case E_23_BAT failed.
+		// Or if both files are not NULL, but the contents of the output file does not equal the contents of the 
+		// expected file, then Test Case E_23_BAT failed
+		if (((lineO == NULL) ^ (lineE == NULL)) || (strcmp(lineO, lineE) != 0)) {
+			close(fdO);
+			close(fdE);
+			printf("Test Case E_23_BAT failed\n");
+			lineO = Free(lineO);
+			lineE = Free(lineE); 
+			return;
+		}
+		lineO = Free(lineO);
+		lineE = Free(lineE); 
+	}
+	// if the contents of the output and expected file are equal to each other, then Test Case E_23_BAT passed.
+	close(fdO);
+	close(fdE);
+	lineO = Free(lineO);
+	lineE = Free(lineE); 
+	printf("Test Case E_23_BAT passed\n");
+}
+
 // Test Case F_1_BAT: In batch mode:
 // A process has exactly one STDIN and STDOUT. This can be inherited from the parent (mysh) or explicitly changed to a pipe 
 // or opened file using dup2(). 
@@ -2010,6 +3119,7 @@ int main() {
 	program_B_1();
 	program_B_2();
 	program_B_3();
+	program_B_4();
 
 	program_C_1();
 	program_C_2();
@@ -2038,6 +3148,28 @@ int main() {
 
 	program_E_1_BAT();
 	program_E_1_INT();
+	program_E_2_BAT();
+	program_E_3_BAT();
+	program_E_4_BAT();
+	program_E_5_BAT();
+	program_E_6_BAT();
+	program_E_7_BAT();
+	program_E_8_BAT();
+	program_E_9_BAT();
+	program_E_10_BAT();
+	program_E_11_BAT();
+	program_E_12_BAT();
+	program_E_13_BAT();
+	program_E_14_BAT();
+	program_E_15_BAT();
+	program_E_16_BAT();
+	program_E_17_BAT();
+	program_E_18_BAT();
+	program_E_19_BAT();
+	program_E_20_BAT();
+	program_E_21_BAT();
+	program_E_22_BAT();
+	program_E_23_BAT();
 
 	program_F_1_BAT();
 	program_F_1_INT();
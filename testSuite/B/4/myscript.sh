@@ -0,0 +1,4 @@
+echo before
+dd bs=1 count=13 status=none
+echo skipped
+echo after
@@ -0,0 +1,7 @@
+echo before
+head -n 1
+echo this line is read by head and not run
+echo after
+head -c 5
+echo partial line
+echo last
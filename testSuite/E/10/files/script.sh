@@ -0,0 +1,5 @@
+echo compiled line $1
+greet() { echo hello $1; }
+greet compiled
+for n in 1 2; do echo number $n; done
+ls testSuite/E/10/files | grep script
@@ -0,0 +1,11 @@
+source testSuite/E/10/files/script.sh
+./mysh --compile testSuite/E/10/files/script.sh
+ls testSuite/E/10/files
+. testSuite/E/10/files/script.sh
+./mysh testSuite/E/10/files/script.sh
+rm testSuite/E/10/files/script.myshc
+./mysh --compile testSuite/E/10/files/input.sh
+./mysh testSuite/E/10/files/input.sh
+rm testSuite/E/10/files/input.myshc
+source testSuite/E/10/files/missing.sh
+source
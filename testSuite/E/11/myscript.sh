@@ -0,0 +1,8 @@
+time echo timed pipeline | wc -w
+timed() { time echo timed in a function; }
+timed
+time timed
+time nosuchprogram
+time
+time cd testSuite
+ls E/11/myscript.sh
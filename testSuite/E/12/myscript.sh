@@ -0,0 +1,7 @@
+bench -n 5 -w 1 echo benched | wc -l
+bench -j -n 3 -w 0 echo "a\"b" > /dev/null
+bench -n 2 nosuchprogram
+bench -n x echo bad
+bench -n 2305843009213693953 -w 0 echo x
+bench -n 1 -w 99999999999999999999 echo x
+bench
@@ -0,0 +1,5 @@
+echo traced | wc -c
+traced() { echo in a function; }
+traced
+cat <* testSuite/E/13/doc.txt
+cd testSuite
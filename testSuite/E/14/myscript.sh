@@ -0,0 +1,7 @@
+echo counted | wc -l
+ls nomatch*.none
+stats -r > /dev/null
+echo after reset
+stats
+stats -x
+MYSH_STATS=1
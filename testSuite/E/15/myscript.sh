@@ -0,0 +1,12 @@
+echo profiled | wc -c
+loop() {
+	echo in loop
+}
+
+for i in 1 2 3; do
+	loop
+done
+source testSuite/E/15/sourced.sh
+head -1
+this line is read by head
+sleep 0.3
@@ -0,0 +1 @@
+echo sourced | cat
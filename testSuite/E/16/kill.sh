@@ -0,0 +1 @@
+kill -9 $$
@@ -0,0 +1,6 @@
+echo logged | wc -c > testSuite/E/16/written.txt
+cat < testSuite/E/16/written.txt
+logged() { echo in a function; nosuchprogram; }
+logged
+sh testSuite/E/16/kill.sh
+cd /nonexistent
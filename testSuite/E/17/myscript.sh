@@ -0,0 +1,4 @@
+monitor -i 0.3 cat /dev/zero | sleep 1
+monitor -i 0 echo bad interval
+monitor
+monitor echo done before the first sample
@@ -0,0 +1,5 @@
+for i in {1..20000}
+do
+	x=$i
+done
+echo $x
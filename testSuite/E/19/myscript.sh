@@ -0,0 +1,8 @@
+echo start
+head -n 1
+echo this line is read by head and not run
+x=1
+echo x is $x
+echo one | tr a-z A-Z
+cat < testSuite/E/19/doc.txt | head -n 1
+echo end
@@ -0,0 +1,6 @@
+echo testSuite/E/2/tree/**/*.log
+echo testSuite/E/2/tree/logs/**
+echo testSuite/E/2/tree/*/*/*/*.txt
+echo testSuite/E/2/tree/**/*.none
+echo testSuite/E/2/tree/**/*/**/*.log
+wc -l <* testSuite/E/2/tree/**/*/**/*.log
@@ -0,0 +1,17 @@
+mkdir -p testSuite/E/20/files
+MYSH_SPLIT_JOBS=4
+touch testSuite/E/20/files/file{1..6000}
+ls testSuite/E/20/files | wc -l
+md5sum testSuite/E/20/files/file* > testSuite/E/20/files/sums.txt
+tail -n 1 testSuite/E/20/files/sums.txt
+rm testSuite/E/20/files/sums.txt
+ls testSuite/E/20/files/file*
+rm testSuite/E/20/files/file*
+ls testSuite/E/20/files | wc -l
+MYSH_SPLIT_JOBS=1
+MYSH_SPLIT_ARGS=1
+printf %s\n {1..40000} > testSuite/E/20/files/numbers.txt
+wc -l < testSuite/E/20/files/numbers.txt
+tail -n 1 testSuite/E/20/files/numbers.txt
+rm testSuite/E/20/files/numbers.txt
+rmdir testSuite/E/20/files
@@ -0,0 +1,5 @@
+echo testSuite/E/21/links/*.txt
+echo testSuite/E/21/links/**/*.txt
+MYSH_GLOB_SYNC_STAT=1
+echo testSuite/E/21/links/*.txt
+echo testSuite/E/21/links/**/*.txt
@@ -0,0 +1,16 @@
+mkdir testSuite/E/22/files
+touch testSuite/E/22/files/name{1..40}.txt testSuite/E/22/files/Name{1..40}.txt
+touch testSuite/E/22/files/_under.txt testSuite/E/22/files/Zeta.txt testSuite/E/22/files/zeta.txt testSuite/E/22/files/10.txt testSuite/E/22/files/9.txt testSuite/E/22/files/été.txt
+touch testSuite/E/22/files/.hidden.txt testSuite/E/22/files/.Hidden.txt testSuite/E/22/files/.10.txt
+printf %s\n testSuite/E/22/files/*.txt > testSuite/E/22/files/sorted
+cat testSuite/E/22/files/sorted
+echo testSuite/E/22/files/.*.txt
+LC_ALL=C sort testSuite/E/22/files/sorted > testSuite/E/22/files/expected
+cmp testSuite/E/22/files/sorted testSuite/E/22/files/expected
+echo $?
+MYSH_GLOB_NOSORT=1
+printf %s\n testSuite/E/22/files/*.txt > testSuite/E/22/files/unsorted
+LC_ALL=C sort testSuite/E/22/files/unsorted > testSuite/E/22/files/resorted
+cmp testSuite/E/22/files/resorted testSuite/E/22/files/expected
+echo $?
+rm -r testSuite/E/22/files
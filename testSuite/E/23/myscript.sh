@@ -0,0 +1,9 @@
+echo {1..1000001}
+echo $?
+cd {0..4294967296}{0..4294967296}
+echo $?
+echo x | cat {0..4294967296}{0..4294967296}
+echo $?
+echo {0..4294967296}{0..4294967296} {1..3}
+echo $?
+echo {1..3}{a,b}
@@ -0,0 +1,4 @@
+wc -l <* testSuite/E/2/tree/**/*.log
+cat <* testSuite/E/2/tree/logs/** | sort
+cat <* testSuite/E/2/tree/**/*.none
+echo done
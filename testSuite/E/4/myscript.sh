@@ -0,0 +1,7 @@
+echo testSuite/E/4/files/a?.h
+echo testSuite/E/4/files/[ab]1.h
+echo testSuite/E/4/files/[!a]*.h
+echo testSuite/E/4/files/a*b*c*.txt
+echo testSuite/E/4/files/[[:digit:]]*
+echo testSuite/E/4/files/?
+echo testSuite/E/4/*/a[0-9].?
@@ -0,0 +1,8 @@
+echo file{A,B,C}.txt
+echo shard-{0..4}.dat shard-{08..11}.dat
+echo {a..e} {10..1..3}
+echo {x,y}{1,2} v{1,2{a,b}}
+echo {} {single} {1..} {..5}
+echo a{-9223372036854775808..9223372036854775807}b {9223372036854775806..9223372036854775807} {1..5..-9223372036854775808}
+cat testSuite/E/5/part{1..3}.txt
+cat testSuite/E/5/part{1..3}.tx*
@@ -0,0 +1,17 @@
+GREETING=hello
+echo $GREETING ${GREETING}world $UNDEFINED end $ a$
+export MYSH_TEST_VAR=exported
+env | grep MYSH_TEST
+LOCAL_ONLY=1
+env | grep LOCAL_ONLY
+echo $?
+PREFIX_VAR=prefixed env | grep PREFIX_VAR
+env | grep PREFIX_VAR
+echo $? $LOCAL_ONLY
+export LOCAL_ONLY
+env | grep LOCAL_ONLY
+export 1bad
+A=x B=$A$A
+echo $B
+P=ls
+$P testSuite/E/6
@@ -0,0 +1,21 @@
+cd testSuite/E/7/files/link
+ls
+cd ..
+ls
+pwd
+pushd real
+pushd deep
+dirs
+pushd
+popd
+popd
+popd
+cd real/deep
+mv ../../real ../../moved
+pwd
+mv ../../moved ../../real
+pwd
+cd ../..
+echo $PWD $OLDPWD
+cd -
+pwd extra
@@ -0,0 +1,34 @@
+greet() { echo hello $1; echo $# arguments: $@; }
+greet world
+greet a b c
+list() {
+	echo listing $1
+	ls $1
+	greet from list
+}
+list testSuite/E/8
+later() { helper $@; }
+helper() { echo helper got $1 and $2; }
+later x y
+numbers() { echo $1 $3; }
+numbers {1..5}
+lines() { wc -l; }
+lines < testSuite/E/8/myscript.sh
+forever() { forever; }
+forever
+echo $?
+alias ll=ls -d
+ll testSuite/E/8 testSuite/E/7
+alias
+unalias ll
+ll testSuite
+base() { basename /tmp/file; }
+base
+basename() { echo basename is a function now; }
+base
+greet x | head -n 1
+echo $?
+again() { source testSuite/E/8/redefine.sh; echo after $1; }
+again first
+again second
+f8
@@ -0,0 +1,9 @@
+again() { echo again was redefined; }
+f1() { echo 1; }
+f2() { echo 2; }
+f3() { echo 3; }
+f4() { echo 4; }
+f5() { echo 5; }
+f6() { echo 6; }
+f7() { echo 7; }
+f8() { echo 8; }
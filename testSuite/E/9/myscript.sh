@@ -0,0 +1,19 @@
+for f in testSuite/E/4/files/a?.h; do echo file $f; cat $f; done
+echo after the loop f is $f
+for i in {1..3} x; do echo number $i; done
+for w in red green
+do
+echo colour $w
+echo again $w
+done
+for w in one two; do
+echo word $w
+done
+count() { echo counted $1; }
+for n in 1 2; do count $n; done
+for i in {1..10000}; do echo $i > /dev/null; done
+echo last $i
+for i in 1 2 3; do i=x$i; echo set $i; done
+echo after the loop i is $i
+for x in; do echo never; done
+for x in a b; do for y in c; do echo nested; done; done